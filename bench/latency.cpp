@@ -0,0 +1,322 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// bench/latency.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+
+#include <state.h>
+
+#include <XPLM/XPLMDataAccess.h>
+#include <XPLM/XPLMPlugin.h>
+#include <XPLM/XPLMProcessing.h>
+
+#include <hidapi.h>
+#include <yaml.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs the plugin against the simulated X-Plane of the stub headers, flips an
+// annunciator DataRef on a random schedule, and measures how long the master
+// warning LED takes to follow in the reports sent to the fake quadrant.
+//
+// Frames run back to back, so sim time is the frame time plus the wall time
+// spent since the frame started; after every frame the harness waits a little
+// so background threads get the rest of the frame, as they would in X-Plane.
+
+#if defined(HCBRAVO_ASYNC_HID)
+static const char * hid_path = "async";
+#else
+static const char * hid_path = "sync";
+#endif
+
+// LED refresh configurations to compare, as in the profile refresh label
+struct refresh_mode {
+    const char * name;
+    const char * frames;
+    const char * seconds;
+    const char * max;
+};
+
+static const refresh_mode modes[] = {
+    { "every-frame", "1", nullptr, "0" },
+    { "back-off", "1", nullptr, "0.1" },
+    { "back-off-0.5s", "1", nullptr, "0.5" },
+    { "every-0.1s", nullptr, "0.1", "0" },
+};
+
+struct options {
+    double fps = 60.0;
+    size_t flips = 1000;
+    double min_gap = 0.02;
+    double max_gap = 0.5;
+    std::chrono::microseconds settle{ 500 };
+    unsigned seed = 1;
+    const char * mode = nullptr;
+};
+
+static const char * aircraft_name = "Cessna Skyhawk (G1000)";
+static const char * aircraft_icao = "C172";
+static const char * volts_key = "sim/cockpit2/electrical/bus_volts";
+static const char * flip_key = "sim/cockpit2/annunciators/master_warning";
+static const led_id flip_led = LED_ANC_MSTR_WARN;
+
+// Feature reports seen by the fake quadrant, stamped with sim time
+class report_log {
+public:
+    struct report {
+        double time;
+        bool led;
+        uint8_t banks[LED_NR_BANKS];
+    };
+
+protected:
+    std::mutex mutex_;
+    double frame_time_;
+    std::chrono::steady_clock::time_point frame_start_;
+    std::vector<report> reports_;
+
+public:
+    report_log() :
+        frame_time_(0.0),
+        frame_start_(std::chrono::steady_clock::now())
+    {}
+
+    void
+    frame(double time) {
+        std::lock_guard lock(this->mutex_);
+        this->frame_time_ = time;
+        this->frame_start_ = std::chrono::steady_clock::now();
+    }
+
+    void
+    add(const unsigned char * data, size_t size) {
+        if(size < 1 + LED_NR_BANKS) return;
+        std::lock_guard lock(this->mutex_);
+        report r;
+        r.time = this->frame_time_ +
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - this->frame_start_).count();
+        ::memcpy(r.banks, data + 1, LED_NR_BANKS);
+        r.led = (r.banks[std::get<0>(flip_led)] & (uint8_t(1) << std::get<1>(flip_led))) != 0;
+        this->reports_.emplace_back(r);
+    }
+
+    std::vector<report>
+    take() {
+        std::lock_guard lock(this->mutex_);
+        return std::move(this->reports_);
+    }
+};
+
+static
+void
+set_int(const char * key, int value)
+{
+    for(auto data_ref : xplm_find_all(key)) data_ref->value.i = value;
+}
+
+static
+void
+set_float(const char * key, float value)
+{
+    for(auto data_ref : xplm_find_all(key)) data_ref->value.f = value;
+}
+
+static
+void
+set_bytes(const char * key, const char * value)
+{
+    for(auto data_ref : xplm_find_all(key)) data_ref->bytes = value;
+}
+
+// Lays out the plugin as X-Plane would, with a copy of the C172 profile using the mode
+static
+void
+install(const std::filesystem::path & root, const refresh_mode & mode)
+{
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "hcbravo" / "lin_x64");
+    std::filesystem::create_directories(root / "hcbravo" / "conf");
+    xplm_plugin_path() = (root / "hcbravo" / "lin_x64" / "hcbravo.xpl").string();
+
+    auto node = YAML::LoadFile((std::filesystem::path(HCBRAVO_CONF_DIR) / "c172.yaml").string());
+    YAML::Node refresh;
+    if(mode.frames != nullptr) refresh["frames"] = mode.frames;
+    if(mode.seconds != nullptr) refresh["seconds"] = mode.seconds;
+    refresh["max"] = mode.max;
+    node["refresh"] = refresh;
+
+    YAML::Emitter output;
+    output << node;
+    std::ofstream(root / "hcbravo" / "conf" / "c172.yaml") << output.c_str() << std::endl;
+}
+
+static inline
+double
+percentile(const std::vector<double> & sorted, double q)
+{
+    if(sorted.empty()) return 0.0;
+    auto rank = static_cast<size_t>(std::ceil(q * sorted.size()));
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+static
+bool
+run(const refresh_mode & mode, const options & opts)
+{
+    auto root = std::filesystem::temp_directory_path() / "hcbravo-latency";
+    install(root, mode);
+
+    auto & sim = xplm_sim::instance();
+    auto & device = hid_stub_device();
+    report_log log;
+    device.on_feature_report = [&log](const unsigned char * data, size_t size) { log.add(data, size); };
+    const double frame = 1.0 / opts.fps;
+    auto run_frame = [&]() {
+        log.frame(sim.now() + frame);
+        sim.run_frame(frame);
+        std::this_thread::sleep_for(opts.settle);
+    };
+
+    auto st = state::init();
+    if(st.has_value() == false) {
+        std::fprintf(stderr, "%s: failed to start the plugin\n", mode.name);
+        return false;
+    }
+    auto & plugin = st.value();
+    set_bytes("sim/aircraft/view/acf_ui_name", aircraft_name);
+    set_bytes("sim/aircraft/view/acf_ICAO", aircraft_icao);
+
+    // Profiles load in the background, and the aircraft is bound once they are in
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while(plugin->active_plane().has_value() == false) {
+        if(std::chrono::steady_clock::now() > deadline) {
+            std::fprintf(stderr, "%s: the C172 profile was not loaded\n", mode.name);
+            return false;
+        }
+        run_frame();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    set_float(volts_key, 24.0f);
+    set_int(flip_key, 0);
+    for(int n = 0; n < 60; ++n) run_frame();
+    log.take();
+
+    struct flip {
+        double time;
+        bool led;
+    };
+    std::vector<flip> flips;
+    std::mt19937 random(opts.seed);
+    std::uniform_real_distribution<double> gap(opts.min_gap, opts.max_gap);
+    double next = sim.now() + gap(random);
+    bool value = false;
+    while(flips.size() < opts.flips) {
+        // DataRefs change while the sim runs, i.e. between two plugin frames
+        while(flips.size() < opts.flips and next <= sim.now() + frame) {
+            value = !value;
+            set_int(flip_key, value ? 1 : 0);
+            flips.emplace_back(flip{ next, value });
+            next += gap(random);
+        }
+        run_frame();
+    }
+    for(double end = sim.now() + 1.0; sim.now() < end; ) run_frame();
+    auto reports = log.take();
+    plugin.reset();
+    device.on_feature_report = nullptr;
+    std::filesystem::remove_all(root);
+
+    // A flip is reported by the first report showing it, unless the next flip came first
+    std::vector<double> latencies;
+    size_t coalesced = 0;
+    size_t r = 0;
+    for(size_t f = 0; f < flips.size(); ++f) {
+        double limit = f + 1 < flips.size() ? flips[f + 1].time : sim.now();
+        while(r < reports.size() and reports[r].time < flips[f].time) ++r;
+        while(r < reports.size() and reports[r].time < limit and reports[r].led != flips[f].led) ++r;
+        if(r == reports.size() or reports[r].time >= limit) {
+            ++coalesced;
+            continue;
+        }
+        latencies.emplace_back(reports[r].time - flips[f].time);
+    }
+
+    size_t redundant = 0;
+    for(size_t n = 1; n < reports.size(); ++n) {
+        if(::memcmp(reports[n].banks, reports[n - 1].banks, LED_NR_BANKS) == 0) ++redundant;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    std::printf("%-6s %-14s %8zu %8zu %10zu %9.2f %9.2f %9.2f %8zu %10zu\n",
+        hid_path, mode.name, flips.size(), latencies.size(), coalesced,
+        1e3 * percentile(latencies, 0.50), 1e3 * percentile(latencies, 0.99),
+        1e3 * (latencies.empty() ? 0.0 : latencies.back()), reports.size(), redundant);
+    return true;
+}
+
+static
+void
+usage(const char * name)
+{
+    std::fprintf(stderr,
+        "Usage: %s [--mode <name>] [--flips <count>] [--fps <frames per second>]\n"
+        "          [--gap <min seconds> <max seconds>] [--settle <microseconds>] [--seed <seed>]\n"
+        "Modes:", name);
+    for(const auto & mode : modes) std::fprintf(stderr, " %s", mode.name);
+    std::fprintf(stderr, "\n");
+}
+
+int
+main(int argc, char * argv[])
+{
+    options opts;
+    for(int n = 1; n < argc; ++n) {
+        std::string arg = argv[n];
+        bool has_value = n + 1 < argc;
+        if(arg == "--mode" and has_value) opts.mode = argv[++n];
+        else if(arg == "--flips" and has_value) opts.flips = std::strtoul(argv[++n], nullptr, 10);
+        else if(arg == "--fps" and has_value) opts.fps = std::strtod(argv[++n], nullptr);
+        else if(arg == "--gap" and n + 2 < argc) {
+            opts.min_gap = std::strtod(argv[++n], nullptr);
+            opts.max_gap = std::strtod(argv[++n], nullptr);
+        }
+        else if(arg == "--settle" and has_value) opts.settle = std::chrono::microseconds(std::strtol(argv[++n], nullptr, 10));
+        else if(arg == "--seed" and has_value) opts.seed = static_cast<unsigned>(std::strtoul(argv[++n], nullptr, 10));
+        else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(opts.fps <= 0.0 or opts.min_gap <= 0.0 or opts.max_gap < opts.min_gap) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::printf("%-6s %-14s %8s %8s %10s %9s %9s %9s %8s %10s\n",
+        "hid", "mode", "flips", "reported", "coalesced", "p50 ms", "p99 ms", "max ms", "reports", "redundant");
+    bool found = false;
+    for(const auto & mode : modes) {
+        if(opts.mode != nullptr and std::strcmp(opts.mode, mode.name) != 0) continue;
+        found = true;
+        if(run(mode, opts) == false) return EXIT_FAILURE;
+    }
+    if(found == false) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
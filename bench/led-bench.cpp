@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// bench/led-bench.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+
+#include <benchmark/benchmark.h>
+
+#include <led.h>
+#include <predicate.h>
+
+#include <XPLM/XPLMDataAccess.h>
+
+#include <hidapi.h>
+
+#include <iterator>
+#include <string>
+#include <vector>
+
+// How the predicates of a synthetic profile reach their DataRefs
+enum class layout : int64_t {
+    scalar = 0,     // One scalar DataRef per predicate
+    indexed = 1,    // Elements of eight-element array DataRefs
+    mixed = 2       // Every other predicate is indexed
+};
+
+static const led_id outputs[] = {
+    LED_AP_HDG, LED_AP_NAV, LED_AP_APR, LED_AP_REV, LED_AP_ALT, LED_AP_VS, LED_AP_IAS, LED_AP,
+    LED_ANC_MSTR_WARN, LED_ANC_ENG_FIRE, LED_ANC_OIL, LED_ANC_FUEL, LED_ANC_ANTI_ICE,
+    LED_ANC_STARTER, LED_ANC_APU, LED_ANC_MSTR_CTN, LED_ANC_VACUUM, LED_ANC_HYD,
+    LED_ANC_AUX_FUEL, LED_ANC_PRK_BRK, LED_ANC_VOLTS, LED_ANC_DOOR
+};
+
+static const size_t array_size = 8;
+
+// LED predicates of a made-up aircraft, with DataRefs that half the predicates match
+class synthetic_profile {
+protected:
+    std::vector<XPLMDataRef> data_refs_;
+    predicate_table table_;
+    XPLMDataRef first_;
+    std::optional<size_t> first_index_;
+
+    XPLMDataRef
+    find(const std::string & key, XPLMDataTypeID type) {
+        auto data_ref = XPLMFindDataRef(key.c_str());
+        data_ref->type = type;
+        this->data_refs_.emplace_back(data_ref);
+        return data_ref;
+    }
+
+public:
+    // Predicates are Bool, Int and Float in turn, and every group holds keys of them
+    synthetic_profile(size_t predicates, layout layout, size_t keys) :
+        first_(nullptr)
+    {
+        auto power = this->find("bench/power", xplmType_Int);
+        power->value.i = 1;
+        this->table_.add(predicate_table::power_group, power, std::nullopt, false);
+
+        predicate_table::group_type group = predicate_table::power_group;
+        XPLMDataRef ints = nullptr;
+        XPLMDataRef floats = nullptr;
+        for(size_t n = 0; n < predicates; ++n) {
+            if(n % keys == 0) {
+                // Groups past the last LED are evaluated but drive no LED
+                group = this->table_.add_group();
+                if(group <= std::size(outputs)) this->table_.add_output(group, outputs[group - 1]);
+            }
+
+            bool indexed = layout == layout::indexed or (layout == layout::mixed and n % 2 == 1);
+            std::optional<size_t> index = std::nullopt;
+            XPLMDataRef data_ref;
+            auto kind = n % 3;
+            if(indexed) {
+                if(n % array_size == 0 or ints == nullptr) {
+                    ints = this->find("bench/ints/" + std::to_string(n), xplmType_IntArray);
+                    floats = this->find("bench/floats/" + std::to_string(n), xplmType_FloatArray);
+                    ints->ints.assign(array_size, 0);
+                    floats->floats.assign(array_size, 0.0f);
+                }
+                index = n % array_size;
+                data_ref = kind == 2 ? floats : ints;
+            }
+            else {
+                data_ref = this->find("bench/scalar/" + std::to_string(n), kind == 2 ? xplmType_Float : xplmType_Int);
+            }
+
+            if(n == 0) {
+                this->first_ = data_ref;
+                this->first_index_ = index;
+            }
+
+            bool set = n % 2 == 0;
+            switch(kind) {
+                case 0:
+                    if(index) data_ref->ints[index.value()] = set ? 1 : 0;
+                    else data_ref->value.i = set ? 1 : 0;
+                    this->table_.add(group, data_ref, index, false);
+                    break;
+                case 1:
+                    if(index) data_ref->ints[index.value()] = set ? 2 : 5;
+                    else data_ref->value.i = set ? 2 : 5;
+                    this->table_.add(group, data_ref, index, false, std::vector<int>{ 1, 2, 3 });
+                    break;
+                default:
+                    if(index) data_ref->floats[index.value()] = set ? 0.5f : 2.0f;
+                    else data_ref->value.f = set ? 0.5f : 2.0f;
+                    this->table_.add(group, data_ref, index, false, std::vector<float>{ 0.25f, 0.5f });
+                    break;
+            }
+        }
+    }
+
+    inline
+    const predicate_table &
+    table() const noexcept { return this->table_; }
+
+    // Flips the first predicate, a Bool, which changes the mask unless
+    // another key of its group is set
+    inline
+    void
+    toggle() noexcept {
+        if(this->first_ == nullptr) return;
+        if(this->first_index_) this->first_->ints[this->first_index_.value()] ^= 1;
+        else this->first_->value.i ^= 1;
+    }
+};
+
+static void
+predicate_args(benchmark::internal::Benchmark * bench)
+{
+    bench->ArgNames({ "predicates", "layout", "keys" });
+    for(int64_t predicates : { 10, 100, 1000 }) {
+        for(int64_t layout : { 0, 1, 2 }) {
+            for(int64_t keys : { 1, 8 }) bench->Args({ predicates, layout, keys });
+        }
+    }
+}
+
+// Mask evaluation on its own, as done on every flight loop tick
+static void
+evaluate(benchmark::State & state)
+{
+    synthetic_profile profile(state.range(0), static_cast<layout>(state.range(1)), state.range(2));
+    led_mask mask;
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(profile.table().evaluate(mask));
+        benchmark::ClobberMemory();
+    }
+    state.counters["reads"] = profile.table().reads();
+    state.counters["groups"] = profile.table().groups();
+}
+BENCHMARK(evaluate)->Apply(predicate_args);
+
+// led_state::update with a mask that changes on every tick or never does
+static void
+update(benchmark::State & state)
+{
+    hid_device hid;
+    hid_lock lock;
+    led_state leds;
+    leds.attach(&hid, lock);
+    if(state.range(1) != 0) leds.start_writer();
+
+    bool changes = state.range(0) != 0;
+    led_mask masks[2];
+    masks[1].set(std::get<0>(LED_AP), std::get<1>(LED_AP), true);
+    size_t tick = 0;
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(leds.update(masks[changes ? tick++ & 1 : 1]));
+    }
+    leds.stop_writer();
+    state.counters["reports"] = benchmark::Counter(
+        static_cast<double>(hid.feature_reports.load()), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(update)->ArgNames({ "changes", "async" })->Args({ 0, 0 })->Args({ 1, 0 })->Args({ 0, 1 })->Args({ 1, 1 });
+
+// A whole flight loop tick: evaluation followed by the LED update
+static void
+tick(benchmark::State & state)
+{
+    synthetic_profile profile(state.range(0), static_cast<layout>(state.range(1)), state.range(2));
+    hid_device hid;
+    hid_lock lock;
+    led_state leds;
+    leds.attach(&hid, lock);
+
+    for(auto _ : state) {
+        profile.toggle();
+        led_mask mask;
+        if(profile.table().evaluate(mask)) benchmark::DoNotOptimize(leds.update(mask));
+    }
+    state.counters["reports"] = benchmark::Counter(
+        static_cast<double>(hid.feature_reports.load()), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(tick)->Apply(predicate_args);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,276 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// bench/load-bench.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+
+#include <benchmark/benchmark.h>
+
+#include <catalog.h>
+#include <profile.h>
+
+#include <yaml.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <malloc.h>
+#include <unistd.h>
+#endif
+
+// Directories of synthetic profiles, generated once per size and removed on exit
+class synthetic_conf {
+protected:
+    std::map<size_t, std::filesystem::path> directories_;
+
+    static
+    void
+    generate(const std::filesystem::path & directory, size_t count) {
+        auto base = YAML::LoadFile((std::filesystem::path(HCBRAVO_CONF_DIR) / "c172.yaml").string());
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        for(size_t n = 0; n < count; ++n) {
+            auto node = YAML::Clone(base);
+            auto id = std::to_string(n);
+            node["name"] = "Synthetic " + id;
+            node["aircrafts"] = std::vector<std::string>{ "Synthetic Aircraft " + id, "Synthetic Aircraft " + id + " + REP" };
+            node["models"] = std::vector<std::string>{ "S" + id };
+
+            YAML::Emitter output;
+            output << node;
+            std::string name = "profile-" + std::string(5 - std::min<size_t>(5, id.size()), '0') + id + ".yaml";
+            std::ofstream(directory / name) << output.c_str() << std::endl;
+        }
+    }
+
+public:
+    ~synthetic_conf() {
+        for(const auto & [count, directory] : this->directories_) {
+            std::error_code err;
+            std::filesystem::remove_all(directory, err);
+        }
+    }
+
+    static
+    synthetic_conf &
+    instance() {
+        static synthetic_conf conf;
+        return conf;
+    }
+
+    const std::filesystem::path &
+    directory(size_t count) {
+        auto it = this->directories_.find(count);
+        if(it != this->directories_.end()) return it->second;
+
+        auto directory = std::filesystem::temp_directory_path() / ("hcbravo-bench-" + std::to_string(count));
+        generate(directory, count);
+        return this->directories_.emplace(count, directory).first->second;
+    }
+};
+
+// Resident set size of the process, in KiB, or 0 where it is not available.
+// Free heap pages are handed back first, so the difference between two
+// readings is what was allocated and kept in between
+static inline
+double
+resident_kb() noexcept
+{
+#if defined(__linux__)
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+    size_t pages = 0, resident = 0;
+    std::ifstream statm("/proc/self/statm");
+    if(not (statm >> pages >> resident)) return 0.0;
+    return static_cast<double>(resident) * static_cast<double>(sysconf(_SC_PAGESIZE)) / 1024.0;
+#else
+    return 0.0;
+#endif
+}
+
+// Profile files of the directory, in the order catalog::load reads them
+static inline
+std::vector<std::filesystem::path>
+enumerate(const std::filesystem::path & directory)
+{
+    std::vector<std::filesystem::path> files;
+    for(const auto & file : std::filesystem::directory_iterator(directory)) {
+        if(file.path().extension() != ".yaml") continue;
+        files.emplace_back(file.path());
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+static inline
+void
+report(benchmark::State & state, size_t files)
+{
+    state.SetComplexityN(static_cast<int64_t>(files));
+    state.counters["per_file"] = benchmark::Counter(static_cast<double>(files),
+        benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+}
+
+static void
+profile_args(benchmark::internal::Benchmark * bench)
+{
+    bench->ArgName("files");
+    for(int64_t files : { 1, 10, 100, 1000, 5000 }) bench->Arg(files);
+    bench->Unit(benchmark::kMillisecond)->Complexity(benchmark::oN);
+}
+
+static void
+enumeration(benchmark::State & state)
+{
+    const auto & directory = synthetic_conf::instance().directory(state.range(0));
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(enumerate(directory));
+    }
+    report(state, state.range(0));
+}
+BENCHMARK(enumeration)->Apply(profile_args);
+
+// YAML parse alone, as done for the header of every file missing from the index
+static void
+parse(benchmark::State & state)
+{
+    auto files = enumerate(synthetic_conf::instance().directory(state.range(0)));
+    for(auto _ : state) {
+        for(const auto & file : files) benchmark::DoNotOptimize(YAML::LoadFile(file.string()));
+    }
+    report(state, files.size());
+}
+BENCHMARK(parse)->Apply(profile_args);
+
+// profile::from_yaml: YAML parse plus building the profile, without looking up DataRefs
+static void
+build(benchmark::State & state)
+{
+    auto files = enumerate(synthetic_conf::instance().directory(state.range(0)));
+    for(auto _ : state) {
+        for(const auto & file : files) benchmark::DoNotOptimize(profile::from_yaml(file.string()));
+    }
+    report(state, files.size());
+}
+BENCHMARK(build)->Apply(profile_args);
+
+// Compiling the aircraft and ICAO rules of the catalog from parsed headers
+static void
+insertion(benchmark::State & state)
+{
+    std::vector<profile_header> headers;
+    for(auto & file : enumerate(synthetic_conf::instance().directory(state.range(0)))) {
+        headers.emplace_back(profile_header::build(YAML::LoadFile(file.string())).value());
+    }
+
+    for(auto _ : state) {
+        std::vector<match_index::rule> aircrafts;
+        std::vector<match_index::rule> models;
+        for(uint32_t owner = 0; owner < headers.size(); ++owner) {
+            const auto & header = headers[owner];
+            for(const auto & aircraft : header.aircrafts()) {
+                aircrafts.emplace_back(match_index::parse(aircraft, header.priority(), owner));
+            }
+            for(const auto & model : header.models()) {
+                models.emplace_back(match_index::parse(model, header.priority(), owner));
+            }
+        }
+        benchmark::DoNotOptimize(match_index::build(std::move(aircrafts)));
+        benchmark::DoNotOptimize(match_index::build(std::move(models)));
+    }
+    report(state, headers.size());
+}
+BENCHMARK(insertion)->Apply(profile_args);
+
+// Resolving an aircraft name against the compiled rules, which should not
+// depend on how many profiles there are
+static void
+lookup(benchmark::State & state)
+{
+    auto ret = catalog::load(synthetic_conf::instance().directory(state.range(0)));
+    const auto & cat = ret.value();
+    const auto & names = cat.entries().back()->header().aircrafts();
+    size_t n = 0;
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(cat.match_aircraft(names[n++ % names.size()]));
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(lookup)->ArgName("files")->Arg(1)->Arg(100)->Arg(5000)->Complexity(benchmark::o1);
+
+// catalog::load with and without an up-to-date index, i.e. first start and every later one
+static void
+catalog_load(benchmark::State & state)
+{
+    const auto & directory = synthetic_conf::instance().directory(state.range(0));
+    bool indexed = state.range(1) != 0;
+    for(auto _ : state) {
+        if(indexed == false) {
+            state.PauseTiming();
+            std::filesystem::remove(directory / catalog::index_name);
+            state.ResumeTiming();
+        }
+        benchmark::DoNotOptimize(catalog::load(directory));
+    }
+    report(state, state.range(0));
+
+    // Memory held by one loaded catalog of this size
+    auto before = resident_kb();
+    auto ret = catalog::load(directory);
+    state.counters["rss_kb"] = std::max(0.0, resident_kb() - before);
+}
+BENCHMARK(catalog_load)->ArgNames({ "files", "indexed" })->ArgsProduct({
+    { 1, 10, 100, 1000, 5000 }, { 0, 1 }
+})->Unit(benchmark::kMillisecond);
+
+// catalog::parse of a freshly loaded catalog, which builds every profile on
+// all cores but one, against the serial build above. Startup never does this,
+// as profiles are built when an aircraft needs them; watching the directory
+// does it for the files that changed
+static void
+catalog_parse(benchmark::State & state)
+{
+    const auto & directory = synthetic_conf::instance().directory(state.range(0));
+    for(auto _ : state) {
+        state.PauseTiming();
+        auto ret = catalog::load(directory);
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(ret.value().parse());
+    }
+    report(state, state.range(0));
+
+    // Memory held by one catalog of this size with every profile built
+    auto before = resident_kb();
+    auto ret = catalog::load(directory);
+    ret.value().parse();
+    state.counters["rss_kb"] = std::max(0.0, resident_kb() - before);
+}
+BENCHMARK(catalog_parse)->Apply(profile_args)->UseRealTime();
+
+// DataRef lookup and predicate compilation of freshly built profiles. Profiles
+// share their handles, so past the first run no key reaches X-Plane
+static void
+resolve(benchmark::State & state)
+{
+    auto files = enumerate(synthetic_conf::instance().directory(state.range(0)));
+    for(auto _ : state) {
+        state.PauseTiming();
+        std::vector<profile::ptr_type> profiles;
+        for(const auto & file : files) profiles.emplace_back(profile::from_yaml(file.string()).value());
+        state.ResumeTiming();
+
+        for(auto & profile : profiles) benchmark::DoNotOptimize(profile->resolve());
+    }
+    report(state, files.size());
+}
+BENCHMARK(resolve)->Apply(profile_args);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,452 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/catalog.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#include "catalog.h"
+#include "logger.h"
+#include "profile-image.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
+
+std::expected<profile::ptr_type, int>
+profile_entry::load() noexcept
+{
+    std::lock_guard lock(this->mutex_);
+    if(this->profile_) return this->profile_.value();
+    if(this->failed_) return std::unexpected(0);
+
+    // Precompiled images are preferred while they are up to date
+    std::expected<profile::ptr_type, int> ret = std::unexpected(0);
+    if(profile_image::is_fresh(this->path_)) {
+        ret = profile_image::load(profile_image::path_for(this->path_));
+        if(ret.has_value() == false) log_warn() << "Falling back to " << this->path_;
+    }
+    if(ret.has_value() == false) ret = profile::from_yaml(this->path_.string());
+    if(ret.has_value() == false) {
+        this->failed_ = true;
+        return ret;
+    }
+    this->profile_.emplace(ret.value());
+    return ret;
+}
+
+bool
+profile_entry::is_current() noexcept
+{
+    std::lock_guard lock(this->mutex_);
+    return !this->profile_ or this->profile_.value()->is_current();
+}
+
+bool
+profile_entry::is_parsed() noexcept
+{
+    std::lock_guard lock(this->mutex_);
+    return this->profile_ or this->failed_;
+}
+
+// Index file format, one record per line and fields separated by tabs:
+//   hcbravo-index <version>
+//   F <file name> <mtime> <size> <priority> <profile name>
+//   A <aircraft>
+//   M <model>
+// Aircraft and model records belong to the preceding file record.
+
+static inline
+bool
+is_indexable(const std::string & value) noexcept
+{
+    return value.find_first_of("\t\r\n") == std::string::npos;
+}
+
+catalog::map_type
+catalog::read_index(const std::filesystem::path & directory) noexcept
+{
+    map_type ret;
+    std::ifstream input(directory / index_name);
+    if(!input) return ret;
+
+    std::string line;
+    std::getline(input, line);
+    if(line != "hcbravo-index\t" + std::to_string(index_version)) {
+        logger() << "Ignoring outdated profile index";
+        return ret;
+    }
+
+    std::string file;
+    int64_t mtime = 0;
+    uintmax_t size = 0;
+    int32_t priority = 0;
+    std::string name;
+    std::vector<std::string> aircrafts;
+    std::vector<std::string> models;
+
+    auto flush = [&]() {
+        if(file.empty()) return;
+        auto path = directory / file;
+        ret.emplace(file, std::make_shared<profile_entry>(std::move(path), mtime, size,
+            profile_header(std::move(name), std::move(aircrafts), std::move(models), priority)));
+        file.clear();
+        name.clear();
+        aircrafts.clear();
+        models.clear();
+    };
+
+    while(std::getline(input, line)) {
+        if(line.size() < 2 or line[1] != '\t') continue;
+        auto value = line.substr(2);
+        switch(line[0]) {
+            case 'F': {
+                flush();
+                std::istringstream fields(value);
+                std::string mtime_str;
+                std::string size_str;
+                std::string priority_str;
+                std::getline(fields, file, '\t');
+                std::getline(fields, mtime_str, '\t');
+                std::getline(fields, size_str, '\t');
+                std::getline(fields, priority_str, '\t');
+                std::getline(fields, name);
+                mtime = std::strtoll(mtime_str.c_str(), nullptr, 10);
+                size = std::strtoull(size_str.c_str(), nullptr, 10);
+                priority = static_cast<int32_t>(std::strtol(priority_str.c_str(), nullptr, 10));
+                break;
+            }
+            case 'A':
+                aircrafts.emplace_back(std::move(value));
+                break;
+            case 'M':
+                models.emplace_back(std::move(value));
+                break;
+            default:
+                break;
+        }
+    }
+    flush();
+    return ret;
+}
+
+bool
+catalog::write_index() const noexcept
+{
+    auto path = this->directory_ / index_name;
+    auto tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream output(tmp, std::ios::trunc);
+        if(!output) return false;
+        output << "hcbravo-index\t" << index_version << "\n";
+        for(const auto & entry : this->entries_) {
+            const auto & header = entry->header();
+            auto file = entry->path().filename().string();
+            bool indexable = is_indexable(file) and is_indexable(header.name());
+            for(const auto & aircraft : header.aircrafts()) indexable = indexable and is_indexable(aircraft);
+            for(const auto & model : header.models()) indexable = indexable and is_indexable(model);
+            // Files we cannot represent are simply parsed on every load
+            if(indexable == false) continue;
+
+            output << "F\t" << file << "\t" << entry->mtime() << "\t" << entry->size() << "\t" << header.priority()
+                   << "\t" << header.name() << "\n";
+            for(const auto & aircraft : header.aircrafts()) output << "A\t" << aircraft << "\n";
+            for(const auto & model : header.models()) output << "M\t" << model << "\n";
+        }
+        if(!output) return false;
+    }
+
+    std::error_code err;
+    std::filesystem::rename(tmp, path, err);
+    return !err;
+}
+
+void
+catalog::compile() noexcept
+{
+    std::vector<match_index::rule> aircrafts;
+    std::vector<match_index::rule> models;
+    for(uint32_t owner = 0; owner < this->entries_.size(); ++owner) {
+        const auto & header = this->entries_[owner]->header();
+        for(const auto & aircraft : header.aircrafts()) {
+            aircrafts.emplace_back(match_index::parse(aircraft, header.priority(), owner));
+        }
+        for(const auto & model : header.models()) {
+            models.emplace_back(match_index::parse(model, header.priority(), owner));
+        }
+    }
+    this->aircrafts_ = match_index::build(std::move(aircrafts));
+    this->models_ = match_index::build(std::move(models));
+
+    // Names claimed by several profiles are the usual copy and paste mistake
+    auto report = [this](const match_index & index) {
+        for(const auto & rule : index.rules()) {
+            if(rule.kind_ != match_index::kind::exact) continue;
+            const auto * winner = index.find(rule.text_);
+            if(winner == &rule) continue;
+            log_warn() << "Not using '" << this->entries_[rule.owner_]->header().name() << "' for '" << rule.text_
+                       << "' because '" << this->entries_[winner->owner_]->header().name() << "' takes precedence";
+        }
+    };
+    report(this->aircrafts_);
+    report(this->models_);
+    logger() << "Compiled " << this->aircrafts_.size() << " aircraft and " << this->models_.size() << " model rule(s)";
+}
+
+// Calls the function for every index below count from a pool of threads.
+// Parsing is pure CPU work, so the pool takes every core but the one the sim
+// thread keeps busy
+template<typename F>
+static
+void
+parallel_for(size_t count, F && function) noexcept
+{
+    auto cores = std::max<size_t>(std::thread::hardware_concurrency(), 2);
+    auto workers = std::min(count, cores - 1);
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for(auto n = next.fetch_add(1, std::memory_order_relaxed); n < count;
+                n = next.fetch_add(1, std::memory_order_relaxed)) {
+            function(n);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(size_t n = 1; n < workers; ++n) {
+        try {
+            threads.emplace_back([&work]() {
+                trace::name_thread("Profile Parser");
+                work();
+            });
+        }
+        catch(const std::system_error & e) {
+            // The calling thread alone still gets through every index
+            log_warn() << "Parsing profiles with " << n << " thread(s): " << e.what();
+            break;
+        }
+    }
+    work();
+    for(auto & thread : threads) thread.join();
+}
+
+static inline
+std::expected<profile_header, int>
+read_header(const std::filesystem::path & path) noexcept
+{
+    try {
+        return profile_header::build(YAML::LoadFile(path.string()));
+    }
+    catch(const YAML::Exception & e) {
+        log_error() << "Failed to parse " << path << ": " << e.what();
+        return std::unexpected(0);
+    }
+}
+
+std::expected<catalog, int>
+catalog::load(const std::filesystem::path & directory, const catalog * previous) noexcept
+{
+    logger() << "Reading Configurations from " << directory;
+    std::error_code err;
+    std::vector<std::filesystem::path> files;
+    for(const auto & file : std::filesystem::directory_iterator(directory, err)) {
+        if(file.path().extension() != ".yaml") continue;
+        files.emplace_back(file.path());
+    }
+    if(err) {
+        log_error() << "Failed to read " << directory << ": " << err.message();
+        return std::unexpected(0);
+    }
+    // Profiles earlier in name order take precedence
+    std::sort(files.begin(), files.end());
+
+    map_type reusable;
+    if(previous != nullptr and previous->directory_ == directory) {
+        for(const auto & entry : previous->entries_) {
+            reusable.emplace(entry->path().filename().string(), entry);
+        }
+    }
+    auto index = read_index(directory);
+    bool dirty = index.size() != files.size();
+
+    catalog ret;
+    ret.directory_ = directory;
+    // Slots keep the name order while headers missing from the index are
+    // read in parallel
+    std::vector<profile_entry::ptr_type> entries(files.size());
+    std::vector<std::tuple<size_t, int64_t, uintmax_t>> pending;
+    for(size_t slot = 0; slot < files.size(); ++slot) {
+        const auto & path = files[slot];
+        auto mtime = static_cast<int64_t>(std::filesystem::last_write_time(path, err).time_since_epoch().count());
+        uintmax_t size = 0;
+        if(!err) size = std::filesystem::file_size(path, err);
+        if(err) {
+            log_error() << "Failed to read " << path << ": " << err.message();
+            continue;
+        }
+
+        auto file = path.filename().string();
+        auto is_current = [&](const map_type & map) -> std::optional<profile_entry::ptr_type> {
+            auto it = map.find(file);
+            if(it == map.end() or it->second->mtime() != mtime or it->second->size() != size) return std::nullopt;
+            return it->second;
+        };
+
+        // Profiles extending a file that changed are parsed again
+        auto entry = is_current(reusable);
+        if(entry and entry.value()->is_current()) {
+            dirty = dirty or !is_current(index);
+            entries[slot] = std::move(entry.value());
+            continue;
+        }
+        if((entry = is_current(index))) {
+            entries[slot] = std::move(entry.value());
+            continue;
+        }
+        dirty = true;
+        pending.emplace_back(slot, mtime, size);
+    }
+
+    parallel_for(pending.size(), [&](size_t n) {
+        auto [slot, mtime, size] = pending[n];
+        auto & path = files[slot];
+        log_debug() << "Reading " << path;
+        auto header = read_header(path);
+        if(header.has_value() == false) return;
+        entries[slot] = std::make_shared<profile_entry>(std::move(path), mtime, size, std::move(header.value()));
+    });
+
+    for(auto & entry : entries) {
+        if(entry) ret.entries_.emplace_back(std::move(entry));
+    }
+    ret.compile();
+
+    logger() << "Found " << ret.entries_.size() << " profile(s), " << pending.size() << " of them not in the index";
+    if(dirty and ret.write_index() == false) {
+        log_error() << "Failed to write the profile index in " << directory;
+    }
+    return ret;
+}
+
+size_t
+catalog::patch(const std::vector<std::string> & files) noexcept
+{
+    size_t changed = 0;
+    for(const auto & file : files) {
+        auto path = this->directory_ / file;
+        std::error_code err;
+        bool exists = std::filesystem::is_regular_file(path, err);
+        int64_t mtime = 0;
+        uintmax_t size = 0;
+        if(exists) {
+            mtime = static_cast<int64_t>(std::filesystem::last_write_time(path, err).time_since_epoch().count());
+            if(!err) size = std::filesystem::file_size(path, err);
+            exists = !err;
+        }
+
+        auto it = std::find_if(this->entries_.begin(), this->entries_.end(), [&](const auto & entry) {
+            return entry->path().filename() == file;
+        });
+        if(it != this->entries_.end()) {
+            // Editors often report several events for a single save
+            if(exists and (*it)->mtime() == mtime and (*it)->size() == size) continue;
+            logger() << "Dropping '" << (*it)->header().name() << "' from " << (*it)->path();
+            this->entries_.erase(it);
+        }
+        ++changed;
+        if(exists == false) continue;
+
+        log_debug() << "Reading " << path;
+        auto header = read_header(path);
+        if(header.has_value() == false) continue;
+        auto entry = std::make_shared<profile_entry>(std::move(path), mtime, size, std::move(header.value()));
+        // Keep the name order, which decides which profile takes precedence
+        auto pos = std::upper_bound(this->entries_.begin(), this->entries_.end(), entry,
+            [](const auto & a, const auto & b) { return a->path() < b->path(); });
+        this->entries_.emplace(pos, std::move(entry));
+    }
+    if(changed == 0) return 0;
+
+    // Bases are shared, so profiles extending a changed file must be parsed
+    // again even though their own file did not change
+    for(auto & entry : this->entries_) {
+        if(entry->is_current()) continue;
+        logger() << "Reloading '" << entry->header().name() << "' from " << entry->path();
+        auto path = entry->path();
+        entry = std::make_shared<profile_entry>(std::move(path), entry->mtime(), entry->size(),
+            profile_header(entry->header()));
+    }
+
+    // Rules of unchanged profiles may now win or lose against the new ones
+    this->compile();
+
+    if(this->write_index() == false) {
+        log_error() << "Failed to write the profile index in " << this->directory_;
+    }
+    return changed;
+}
+
+size_t
+catalog::parse(const catalog * previous) const noexcept
+{
+    std::vector<profile_entry *> entries;
+    entries.reserve(this->entries_.size());
+    for(const auto & entry : this->entries_) entries.emplace_back(entry.get());
+    if(previous != nullptr) {
+        std::unordered_set<const profile_entry *> shared;
+        for(const auto & entry : previous->entries_) shared.emplace(entry.get());
+        std::erase_if(entries, [&shared](const auto * entry) { return shared.contains(entry); });
+    }
+
+    std::atomic<size_t> failed(0);
+    parallel_for(entries.size(), [&entries, &failed](size_t n) {
+        auto * entry = entries[n];
+        if(entry->load().has_value() == false) {
+            log_error() << "Failed to load profile '" << entry->header().name() << "' from " << entry->path();
+            failed.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    return failed.load(std::memory_order_relaxed);
+}
+
+std::optional<profile_match>
+catalog::match(const match_index & index, const std::string & name) const noexcept
+{
+    const auto * rule = index.find(name);
+    if(rule == nullptr) return std::nullopt;
+    return profile_match{ this->entries_[rule->owner_], *rule };
+}
+
+std::optional<profile_match>
+catalog::match_aircraft(const std::string & aircraft) const noexcept
+{
+    return this->match(this->aircrafts_, aircraft);
+}
+
+std::optional<profile_match>
+catalog::match_model(const std::string & model) const noexcept
+{
+    return this->match(this->models_, model);
+}
+
+std::optional<profile_entry::ptr_type>
+catalog::find_aircraft(const std::string & aircraft) const noexcept
+{
+    auto ret = this->match_aircraft(aircraft);
+    if(!ret) return std::nullopt;
+    return std::move(ret->entry_);
+}
+
+std::optional<profile_entry::ptr_type>
+catalog::find_model(const std::string & model) const noexcept
+{
+    auto ret = this->match_model(model);
+    if(!ret) return std::nullopt;
+    return std::move(ret->entry_);
+}
@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/catalog.h
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#ifndef CATALOG_H_
+#define CATALOG_H_
+
+#include "match-index.h"
+#include "profile.h"
+
+#include <expected>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <cstdint>
+
+// A profile file in the configuration directory. Only the header is known
+// up-front; the full profile is parsed the first time it is needed. Entries
+// are shared between catalogs, so loading is safe from any thread.
+class profile_entry {
+public:
+    using ptr_type = std::shared_ptr<profile_entry>;
+
+protected:
+    std::filesystem::path path_;
+    int64_t mtime_;
+    uintmax_t size_;
+    profile_header header_;
+
+    std::mutex mutex_;
+    std::optional<profile::ptr_type> profile_;
+    bool failed_;
+
+public:
+    inline
+    profile_entry(std::filesystem::path && path, int64_t mtime, uintmax_t size,
+            profile_header && header) noexcept :
+        path_(std::move(path)),
+        mtime_(mtime),
+        size_(size),
+        header_(std::move(header)),
+        failed_(false)
+    {}
+
+    inline
+    const std::filesystem::path &
+    path() const noexcept { return this->path_; }
+
+    inline
+    int64_t
+    mtime() const noexcept { return this->mtime_; }
+
+    inline
+    uintmax_t
+    size() const noexcept { return this->size_; }
+
+    inline
+    const profile_header &
+    header() const noexcept { return this->header_; }
+
+    // Parses the profile the first time it is requested. Files that fail to
+    // parse are not retried
+    std::expected<profile::ptr_type, int>
+    load() noexcept;
+
+    // False once a file the parsed profile extends changes
+    bool
+    is_current() noexcept;
+
+    // Whether the profile was parsed, successfully or not
+    bool
+    is_parsed() noexcept;
+};
+
+// Profile chosen for an aircraft, and the rule that chose it
+struct profile_match {
+    profile_entry::ptr_type entry_;
+    match_index::rule rule_;
+};
+
+// Every profile found in the configuration directory, indexed by aircraft
+// name and ICAO model. The aircrafts and models of the profiles are rules,
+// compiled into one match_index for each whenever the catalog changes.
+//
+// The catalog keeps a persistent index file next to the profiles with the
+// header of each file and its modification time. Loading the catalog only
+// parses the headers of the files that are missing from the index or changed
+// since it was written, on a pool of threads.
+class catalog {
+public:
+    using map_type = std::unordered_map<std::string, profile_entry::ptr_type>;
+
+    static constexpr const char * index_name = ".hcbravo-index";
+    static const int index_version = 2;
+
+protected:
+    std::filesystem::path directory_;
+    // In name order, which breaks ties between rules
+    std::vector<profile_entry::ptr_type> entries_;
+    match_index aircrafts_;
+    match_index models_;
+
+    // Rebuilds the indexes from the entries
+    void
+    compile() noexcept;
+
+    std::optional<profile_match>
+    match(const match_index & index, const std::string & name) const noexcept;
+
+    static
+    map_type
+    read_index(const std::filesystem::path & directory) noexcept;
+
+    bool
+    write_index() const noexcept;
+
+public:
+    catalog() noexcept = default;
+
+    catalog(const catalog & other) = default;
+
+    catalog(catalog && other) noexcept = default;
+
+    catalog &
+    operator=(catalog && other) noexcept = default;
+
+    // Scans the directory. Entries of a previous catalog whose files did not
+    // change are reused, including any profile they already parsed
+    static
+    std::expected<catalog, int>
+    load(const std::filesystem::path & directory, const catalog * previous = nullptr) noexcept;
+
+    // Re-reads the given profile files, which were added, modified or removed
+    // since the catalog was loaded, and updates the entries that use them,
+    // including those extending them. Returns how many of the files actually
+    // changed
+    size_t
+    patch(const std::vector<std::string> & files) noexcept;
+
+    // Parses the profiles that are not shared with the previous catalog, or
+    // every profile without one, without resolving them. Returns how many
+    // failed to parse
+    size_t
+    parse(const catalog * previous = nullptr) const noexcept;
+
+    inline
+    const std::filesystem::path &
+    directory() const noexcept { return this->directory_; }
+
+    inline
+    const std::vector<profile_entry::ptr_type> &
+    entries() const noexcept { return this->entries_; }
+
+    std::optional<profile_match>
+    match_aircraft(const std::string & aircraft) const noexcept;
+
+    std::optional<profile_match>
+    match_model(const std::string & model) const noexcept;
+
+    std::optional<profile_entry::ptr_type>
+    find_aircraft(const std::string & aircraft) const noexcept;
+
+    std::optional<profile_entry::ptr_type>
+    find_model(const std::string & model) const noexcept;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/compile.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+// hcbravo-compile: turns a YAML profile into a precompiled profile image
+
+#include "profile.h"
+#include "profile-image.h"
+
+#include <filesystem>
+#include <iostream>
+
+int
+main(int argc, char * argv[])
+{
+    if(argc < 2 or argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " <profile.yaml> [<profile.hcbp>]" << std::endl;
+        return 1;
+    }
+
+    std::filesystem::path input(argv[1]);
+    auto output = argc == 3 ? std::filesystem::path(argv[2]) : profile_image::path_for(input);
+
+    auto prof = profile::from_yaml(input.string());
+    if(prof.has_value() == false) {
+        std::cerr << "Failed to read profile " << input << std::endl;
+        return 1;
+    }
+
+    if(profile_image::write(*prof.value(), output).has_value() == false) {
+        std::cerr << "Failed to write profile image " << output << std::endl;
+        return 1;
+    }
+    return 0;
+}
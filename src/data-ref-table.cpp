@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/data-ref-table.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#include "data-ref-table.h"
+#include "logger.h"
+
+data_ref_registry &
+data_ref_registry::instance() noexcept
+{
+    static data_ref_registry registry;
+    return registry;
+}
+
+data_ref_registry::id_type
+data_ref_registry::intern(const std::string & key) noexcept
+{
+    std::lock_guard lock(this->mutex_);
+    auto it = this->ids_.find(key);
+    if(it != this->ids_.end()) return it->second;
+
+    auto id = static_cast<id_type>(this->entries_.size());
+    const auto & ret = this->entries_.emplace_back(entry{ key, nullptr, false });
+    this->ids_.emplace(ret.key_, id);
+    return id;
+}
+
+XPLMDataRef
+data_ref_registry::find(id_type id, bool & array) noexcept
+{
+    std::lock_guard lock(this->mutex_);
+    auto & entry = this->entries_[id];
+    if(entry.handle_ == nullptr) {
+        ++this->lookups_;
+        entry.handle_ = XPLMFindDataRef(entry.key_.c_str());
+        if(entry.handle_ != nullptr) {
+            XPLMDataRefInfo_t info;
+            info.structSize = sizeof(info);
+            XPLMGetDataRefInfo(entry.handle_, &info);
+            entry.array_ = info.type == xplmType_IntArray or info.type == xplmType_FloatArray;
+        }
+    }
+    array = entry.array_;
+    return entry.handle_;
+}
+
+data_ref_table::key_type
+data_ref_table::intern(const std::string & key, bool indexed) noexcept
+{
+    auto global = this->registry_->intern(key);
+    auto ret = this->ids_.emplace(global, static_cast<key_type>(this->keys_.size()));
+    auto id = ret.first->second;
+    if(ret.second) {
+        this->keys_.emplace_back(global);
+        this->handles_.emplace_back(nullptr);
+        this->arrays_.emplace_back(0);
+        this->indexed_.emplace_back(0);
+        this->scalar_.emplace_back(0);
+    }
+    if(indexed) this->indexed_[id] = 1;
+    else this->scalar_[id] = 1;
+    return id;
+}
+
+size_t
+data_ref_table::resolve() noexcept
+{
+    size_t found = 0;
+    for(key_type id = 0; id < this->keys_.size(); ++id) {
+        if(this->handles_[id] != nullptr) continue;
+
+        bool array;
+        auto handle = this->registry_->find(this->keys_[id], array);
+        if(handle == nullptr) continue;
+
+        if(array) {
+            this->arrays_[id] = 1;
+            if(this->scalar_[id]) {
+                log_warn() << "Detected Array DataRef '" << this->key(id) << "', but no index was provided. Assuming index 0";
+            }
+        }
+        else if(this->indexed_[id]) {
+            log_warn() << "Detected Scalar DataRef '" << this->key(id) << "', but an index was provided. Ignoring provided index";
+        }
+        this->handles_[id] = handle;
+        ++found;
+    }
+    this->resolved_ += found;
+    return found;
+}
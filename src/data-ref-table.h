@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/data-ref-table.h
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#ifndef DATA_REF_TABLE_H_
+#define DATA_REF_TABLE_H_
+
+#include <XPLM/XPLMDataAccess.h>
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+// DataRef keys interned by every profile in the process.
+//
+// Profiles share most of their keys, so each key string is stored and looked
+// up in X-Plane once, no matter how many profiles use it. Keys are interned
+// from any thread, while lookups only run on the sim thread.
+class data_ref_registry {
+public:
+    using id_type = uint32_t;
+
+protected:
+    struct entry {
+        std::string key_;
+        XPLMDataRef handle_;
+        bool array_;
+    };
+
+    mutable std::mutex mutex_;
+    // Entries never move, so the map can refer to their keys
+    std::deque<entry> entries_;
+    std::unordered_map<std::string_view, id_type> ids_;
+    size_t lookups_;
+
+public:
+    inline
+    data_ref_registry() noexcept :
+        lookups_(0)
+    {}
+
+    static
+    data_ref_registry &
+    instance() noexcept;
+
+    id_type
+    intern(const std::string & key) noexcept;
+
+    // Looks the key up unless an earlier call found it, and returns the
+    // handle, or null if X-Plane does not know the key yet
+    XPLMDataRef
+    find(id_type id, bool & array) noexcept;
+
+    inline
+    const std::string &
+    key(id_type id) const noexcept {
+        std::lock_guard lock(this->mutex_);
+        return this->entries_[id].key_;
+    }
+
+    inline
+    size_t
+    size() const noexcept {
+        std::lock_guard lock(this->mutex_);
+        return this->entries_.size();
+    }
+
+    // Number of times X-Plane was asked for a DataRef
+    inline
+    size_t
+    lookups() const noexcept {
+        std::lock_guard lock(this->mutex_);
+        return this->lookups_;
+    }
+
+#if defined(HCBRAVO_PROFILE_TESTS)
+    // Forgets every handle found, so tables resolved afterwards get fresh ones
+    inline
+    void
+    reset() noexcept {
+        std::lock_guard lock(this->mutex_);
+        for(auto & entry : this->entries_) {
+            entry.handle_ = nullptr;
+            entry.array_ = false;
+        }
+    }
+#endif
+};
+
+// Interned DataRef keys of a profile.
+//
+// Parsing a profile only records the key strings; X-Plane is not asked for
+// any of them until resolve() runs, which happens when the profile is first
+// activated for an aircraft. By then, DataRefs owned by the aircraft plugins
+// exist, and profiles for aircraft that are never flown cost no lookups.
+// Keys are numbered per profile, and map onto the registry shared with every
+// other profile.
+class data_ref_table {
+public:
+    using key_type = uint32_t;
+
+protected:
+    data_ref_registry * registry_;
+    std::vector<data_ref_registry::id_type> keys_;
+    std::unordered_map<data_ref_registry::id_type, key_type> ids_;
+
+    // Per-key data, filled in by resolve()
+    std::vector<XPLMDataRef> handles_;
+    std::vector<uint8_t> arrays_;
+
+    // How the key is used by the profile, to validate indexes on resolution
+    std::vector<uint8_t> indexed_;
+    std::vector<uint8_t> scalar_;
+
+    size_t resolved_;
+
+public:
+    inline
+    data_ref_table(data_ref_registry & registry = data_ref_registry::instance()) noexcept :
+        registry_(&registry),
+        resolved_(0)
+    {}
+
+    data_ref_table(data_ref_table && other) noexcept = default;
+
+    data_ref_table &
+    operator=(data_ref_table && other) noexcept = default;
+
+    key_type
+    intern(const std::string & key, bool indexed) noexcept;
+
+    // Looks up every key not found yet. Returns the number of keys newly found
+    size_t
+    resolve() noexcept;
+
+    inline
+    bool
+    complete() const noexcept { return this->resolved_ == this->keys_.size(); }
+
+    inline
+    size_t
+    resolved() const noexcept { return this->resolved_; }
+
+    inline
+    size_t
+    size() const noexcept { return this->keys_.size(); }
+
+    inline
+    const std::string &
+    key(key_type id) const noexcept { return this->registry_->key(this->keys_[id]); }
+
+    inline
+    XPLMDataRef
+    handle(key_type id) const noexcept { return this->handles_[id]; }
+
+    inline
+    bool
+    is_array(key_type id) const noexcept { return this->arrays_[id] != 0; }
+};
+
+#endif
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/hid-lock.h
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#ifndef HID_LOCK_H_
+#define HID_LOCK_H_
+
+#include <atomic>
+#include <mutex>
+
+// Serializes the threads sharing the quadrant. hidapi does not promise that a
+// device can be read from one thread while another sends it a feature report,
+// so the input reader holds the lock around each read and the LED path around
+// each report.
+//
+// Writes go first: the reader steps aside while one is waiting, so a report
+// waits at most for the read already in progress.
+class hid_lock {
+protected:
+    std::mutex mutex_;
+    std::atomic<unsigned> writers_;
+
+public:
+    inline
+    hid_lock() noexcept :
+        writers_(0)
+    {}
+
+    inline
+    void
+    lock_read() noexcept {
+        for(auto writers = this->writers_.load(std::memory_order_acquire); writers != 0;
+                writers = this->writers_.load(std::memory_order_acquire)) {
+            this->writers_.wait(writers, std::memory_order_acquire);
+        }
+        this->mutex_.lock();
+    }
+
+    inline
+    void
+    unlock_read() noexcept { this->mutex_.unlock(); }
+
+    inline
+    void
+    lock_write() noexcept {
+        this->writers_.fetch_add(1, std::memory_order_relaxed);
+        this->mutex_.lock();
+    }
+
+    inline
+    void
+    unlock_write() noexcept {
+        this->mutex_.unlock();
+        if(this->writers_.fetch_sub(1, std::memory_order_release) == 1) this->writers_.notify_all();
+    }
+};
+
+#endif
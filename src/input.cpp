@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/input.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#include "input.h"
+
+#include <hidapi.h>
+
+#include <chrono>
+
+// How long a read waits for a report before checking whether it has to stop.
+// LED reports wait for the read in progress, so this bounds their latency
+static const int read_timeout_ms = 1;
+
+// How long to back off after a failed read
+static const int error_backoff_ms = 100;
+
+input_reader::input_reader() noexcept :
+    hid_(nullptr),
+    lock_(nullptr),
+    stop_(false),
+    errors_(0),
+    dropped_(0)
+{}
+
+input_reader::~input_reader() noexcept
+{
+    this->stop();
+}
+
+void
+input_reader::start(hid_device_ * hid, hid_lock & lock) noexcept
+{
+    if(this->is_running() or hid == nullptr) return;
+    this->hid_ = hid;
+    this->lock_ = &lock;
+    this->stop_.store(false, std::memory_order_relaxed);
+    this->reader_ = std::thread(&input_reader::reader, this);
+}
+
+void
+input_reader::stop() noexcept
+{
+    if(this->is_running() == false) return;
+    this->stop_.store(true, std::memory_order_relaxed);
+    this->reader_.join();
+}
+
+void
+input_reader::reader(input_reader * self) noexcept
+{
+    input_decoder decoder;
+    uint8_t report[64];
+
+    while(self->stop_.load(std::memory_order_relaxed) == false) {
+        self->lock_->lock_read();
+        int ret = hid_read_timeout(self->hid_, report, sizeof(report), read_timeout_ms);
+        self->lock_->unlock_read();
+        if(ret < 0) {
+            self->errors_.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::sleep_for(std::chrono::milliseconds(error_backoff_ms));
+            continue;
+        }
+        decoder.decode(report, static_cast<size_t>(ret), [self](const input_event & event) {
+            if(self->events_.push(event) == false) self->dropped_.fetch_add(1, std::memory_order_relaxed);
+        });
+    }
+}
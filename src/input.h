@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/input.h
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#ifndef INPUT_H_
+#define INPUT_H_
+
+#include <atomic>
+#include <thread>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "hid-lock.h"
+#include "knob.h"
+#include "spsc-queue.h"
+
+struct hid_device_;
+
+// Something the pilot did on the quadrant, as decoded from its input report
+struct input_event {
+    enum class kind : uint8_t {
+        select,     // The selector knob moved to value
+        inc,        // One encoder detent clockwise
+        dec,        // One encoder detent counter-clockwise
+        button      // Autopilot button value was pressed
+    };
+
+    kind kind_;
+    uint8_t value_;
+};
+
+// Turns input reports into events. Buttons are numbered as in the X-Plane
+// joystick configuration, e.g. 12 and 13 for the encoder.
+class input_decoder {
+public:
+    // Unnumbered input report: six 16-bit axes followed by the button bits
+    static const size_t axes_size = 6 * sizeof(uint16_t);
+    static const size_t buttons_size = 6;
+    static const size_t report_size = axes_size + buttons_size;
+
+    static const unsigned ap_first = 0;
+    static const unsigned ap_last = 7;
+    static const unsigned encoder_inc = 12;
+    static const unsigned encoder_dec = 13;
+    // IAS, CRS, HDG, VS and ALT, in this order
+    static const unsigned selector_first = 16;
+    static const unsigned selector_last = 20;
+
+protected:
+    uint64_t buttons_;
+    bool first_;
+
+public:
+    inline
+    input_decoder() noexcept :
+        buttons_(0),
+        first_(true)
+    {}
+
+    static inline
+    selector
+    selector_for(unsigned button) noexcept {
+        static const selector selectors[] = {
+            selector::ias, selector::crs, selector::hdg, selector::vs, selector::alt
+        };
+        return selectors[button - selector_first];
+    }
+
+    // Calls emit for every event in the report. Buttons only produce events
+    // when they are pressed; the encoder sends one press per detent
+    template<typename F>
+    inline
+    void
+    decode(const uint8_t * report, size_t size, F && emit) noexcept {
+        if(size < report_size) return;
+        uint64_t buttons = 0;
+        for(size_t n = 0; n < buttons_size; ++n) buttons |= uint64_t(report[axes_size + n]) << (8 * n);
+
+        // The selector has no press to wait for, so report where it starts
+        uint64_t pressed = buttons & ~this->buttons_;
+        if(this->first_) {
+            pressed = buttons;
+            this->first_ = false;
+        }
+        this->buttons_ = buttons;
+
+        for(unsigned n = selector_first; n <= selector_last; ++n) {
+            if(pressed & (uint64_t(1) << n)) emit(input_event{ input_event::kind::select, uint8_t(selector_for(n)) });
+        }
+        if(pressed & (uint64_t(1) << encoder_inc)) emit(input_event{ input_event::kind::inc, 0 });
+        if(pressed & (uint64_t(1) << encoder_dec)) emit(input_event{ input_event::kind::dec, 0 });
+        for(unsigned n = ap_first; n <= ap_last; ++n) {
+            if(pressed & (uint64_t(1) << n)) emit(input_event{ input_event::kind::button, uint8_t(n) });
+        }
+    }
+};
+
+// Reads input reports from the quadrant on a dedicated thread.
+//
+// Events go through a lock-free queue drained by the sim thread, so knob
+// turns take effect on the next frame instead of going through the X-Plane
+// joystick bindings. The thread never calls into X-Plane, and holds the
+// hid_lock shared with the LED path around every read.
+class input_reader {
+public:
+    using queue_type = spsc_queue<input_event, 256>;
+
+protected:
+    hid_device_ * hid_;
+    hid_lock * lock_;
+    std::atomic<bool> stop_;
+    std::atomic<size_t> errors_;
+    std::atomic<size_t> dropped_;
+    queue_type events_;
+    std::thread reader_;
+
+    static
+    void
+    reader(input_reader * self) noexcept;
+
+public:
+    input_reader() noexcept;
+
+    ~input_reader() noexcept;
+
+    void
+    start(hid_device_ * hid, hid_lock & lock) noexcept;
+
+    void
+    stop() noexcept;
+
+    inline
+    bool
+    is_running() const noexcept { return this->reader_.joinable(); }
+
+    inline
+    bool
+    pop(input_event & event) noexcept { return this->events_.pop(event); }
+
+    // Failed reads since the last call
+    inline
+    size_t
+    errors() noexcept { return this->errors_.exchange(0, std::memory_order_relaxed); }
+
+    // Events lost to a full queue since the last call
+    inline
+    size_t
+    dropped() noexcept { return this->dropped_.exchange(0, std::memory_order_relaxed); }
+};
+
+#endif
@@ -7,12 +7,15 @@
 
 
 #include "knob.h"
+#include "perf.h"
 #include "state.h"
 
 #include <XPLM/XPLMUtilities.h>
 
 #include <algorithm>
+#include <cmath>
 #include <expected>
+#include <iterator>
 
 #undef max
 
@@ -43,11 +46,47 @@ static const factor factors[] = {
     { 1.0f, 2.0f }      // IAS
 };
 
+static_assert(std::size(factors) == static_cast<size_t>(selector::count));
+static_assert(knob_config::count == static_cast<size_t>(selector::count));
+
+// Knobs turning faster than a detent every 100ms use the fast step
+static const float fast_rate = 10.0f;
+
+static inline
+acceleration_curve
+default_curve(const factor & factor) noexcept
+{
+    return acceleration_curve({ { 0.0f, factor.slow }, { fast_rate, factor.fast } });
+}
+
+// Used by profiles that do not configure a knob
+static const acceleration_curve default_curves[] = {
+    default_curve(factors[0]),
+    default_curve(factors[1]),
+    default_curve(factors[2]),
+    default_curve(factors[3]),
+    default_curve(factors[4])
+};
+
+// A knob command held longer than slew_delay slews its dial as if the knob
+// turned at a rate ramping from slew_min_rate to slew_max_rate detents per
+// second over slew_ramp seconds. Dials are written at most every slew_period
+// seconds, however often X-Plane repeats the command
+static const std::chrono::milliseconds slew_delay(400);
+static const float slew_min_rate = 4.0f;
+static const float slew_max_rate = 12.0f;
+static const float slew_ramp = 2.0f;
+static const float slew_period = 0.05f;
+// The first tick after the flight loop is scheduled reports the time since it last ran
+static const float slew_max_elapsed = 0.1f;
+
 
 int
 commands::ap_knob_select(XPLMCommandRef cmd, XPLMCommandPhase phase, void * ref) noexcept
 {
     commands * self = reinterpret_cast<commands *>(ref);
+    if(self->direct_) return 1;
+    perf_timer timer(perf_id::knob);
 
     if(cmd == self->sel_alt_) {
         self->active_ = selector::alt;
@@ -65,153 +104,265 @@ commands::ap_knob_select(XPLMCommandRef cmd, XPLMCommandPhase phase, void * ref)
         self->active_ = selector::ias;
     }
     else { return 1; }
+    self->state_.wake();
     return 0;
 }
 
 
 
 
-template<selector Sel, commands::dir Dir>
-static inline
-float
-get_update_value(bool fast) noexcept {
-    auto index = static_cast<size_t>(Sel);
-    float value = fast ? factors[index].fast : factors[index].slow;
-    return value * static_cast<int>(Dir);
+template<commands::dir Dir>
+inline
+int
+commands::ap_knob_update(void * ref) noexcept
+{
+    commands * self = reinterpret_cast<commands *>(ref);
+
+    if(self->active_ != self->rate_selector_ or self->rate_dir_ != Dir) self->rate_.reset();
+    self->rate_selector_ = self->active_;
+    self->rate_dir_ = Dir;
+
+    auto index = static_cast<size_t>(self->active_);
+    const auto & plane = self->state_.active_plane();
+    auto window = plane ? plane.value()->knobs().window() : knob_config().window();
+    auto rate = self->rate_.add(detent_rate::clock::now(), std::chrono::duration<float>(window));
+    self->pending_[index] += self->curve(index).step(rate) * static_cast<int>(Dir);
+
+    // Detents arriving within the same frame end up in a single write
+    if(self->dirty_ == false) {
+        self->dirty_ = true;
+        XPLMScheduleFlightLoop(self->flush_loop_, -1.0f, 1);
+    }
+    return 0;
 }
 
+const acceleration_curve &
+commands::curve(size_t knob) const noexcept
+{
+    const auto & plane = this->state_.active_plane();
+    if(plane and plane.value()->knobs().curve(knob)) return plane.value()->knobs().curve(knob).value();
+    return default_curves[knob];
+}
 
 template<commands::dir Dir>
-inline
 int
-commands::ap_knob_update(void * ref) noexcept
+commands::ap_knob_hold(XPLMCommandPhase phase) noexcept
+{
+    switch(phase) {
+        case xplm_CommandBegin:
+            this->held_ = Dir;
+            this->held_since_ = std::chrono::steady_clock::now();
+            this->slewing_ = false;
+            break;
+
+        case xplm_CommandContinue:
+            if(this->held_ != Dir or this->slewing_) break;
+            if(std::chrono::steady_clock::now() - this->held_since_ < slew_delay) break;
+            this->slewing_ = true;
+            this->slew_time_ = 0.0f;
+            this->slew_elapsed_ = 0.0f;
+            this->slew_residue_ = 0.0f;
+            XPLMScheduleFlightLoop(this->flush_loop_, -1.0f, 1);
+            break;
+
+        case xplm_CommandEnd:
+            // A short press is a single detent
+            if(this->held_ == Dir and this->slewing_) {
+                this->slewing_ = false;
+                break;
+            }
+            return ap_knob_update<Dir>(this);
+    }
+    return 0;
+}
+
+void
+commands::slew(float elapsed) noexcept
 {
-   commands * self = reinterpret_cast<commands *>(ref);
+    elapsed = std::min(elapsed, slew_max_elapsed);
+    this->slew_time_ += elapsed;
+    this->slew_elapsed_ += elapsed;
+    if(this->slew_elapsed_ < slew_period) return;
+
+    auto index = static_cast<size_t>(this->active_);
+    auto rate = slew_min_rate + (slew_max_rate - slew_min_rate) * std::min(1.0f, this->slew_time_ / slew_ramp);
+    auto step = this->curve(index).step(rate);
+    if(step <= 0.0f) return;
+    this->slew_residue_ += step * rate * this->slew_elapsed_;
+    this->slew_elapsed_ = 0.0f;
+
+    // Whole steps only, so rounded dials still move and values stay aligned
+    auto steps = std::floor(this->slew_residue_ / step);
+    if(steps < 1.0f) return;
+    this->slew_residue_ -= steps * step;
+    this->pending_[index] += steps * step * static_cast<int>(this->held_);
+    this->dirty_ = true;
+}
+
+void
+commands::flush() noexcept
+{
+    if(this->dirty_ == false) return;
+    perf_timer timer(perf_id::knob_flush);
+    this->dirty_ = false;
+    float pending[static_cast<size_t>(selector::count)];
+    std::copy(std::begin(this->pending_), std::end(this->pending_), std::begin(pending));
+    std::fill(std::begin(this->pending_), std::end(this->pending_), 0.0f);
 
     // No plane is slected
-    if(!self->state_.active_plane()) {
-        logger() << "AP Knob Changed but no plane is active";
-        return 0;
+    if(!this->state_.active_plane()) {
+        log_debug() << "AP Knob Changed but no plane is active";
+        return;
     }
-    auto plane = self->state_.active_plane().value(); 
+    auto plane = this->state_.active_plane().value(); 
 
     // The plane has no autopilot 
     if(!plane->autopilot()) {
-        logger() << "AP Knob Changed but plane has not AutoPilot";
-        return 0;
+        log_debug() << "AP Knob Changed but plane has not AutoPilot";
+        return;
     }
     // The plance has no autopilot dials
     if(!plane->autopilot().value().dials()) {
-        logger() << "AP Knob Changed but AutoPilot has not Dials";
-        return 0;
+        log_debug() << "AP Knob Changed but AutoPilot has not Dials";
+        return;
     }
 
     const auto & dials = plane->autopilot().value().dials().value();
+    auto delta = [&pending](selector sel) { return pending[static_cast<size_t>(sel)]; };
 
-    auto now = std::chrono::steady_clock::now();
-    auto elapsed = now - self->last_cmd_;
-    // We set 250ms as threshold for now
-    bool fast = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() < 100;
-    switch(self->active_) {
-        case selector::alt:
-            if(!dials.alt()) return 0;
-            dials.alt().value().set(
-                std::max(
-                    0.0f,
-                    dials.alt().value().get() + get_update_value<selector::alt, Dir>(fast)
-                )
-            );
-            break;
-
-        case selector::vs:
-            if(!dials.vs()) return 0;
-            dials.vs().value().set(
-                dials.vs().value().get() + get_update_value<selector::vs, Dir>(fast)
-            );
-            break;
-        case selector::hdg:
-            if(!dials.heading()) return 0;
-            dials.heading().value().set(
-                std::round(std::fmod(
-                    dials.heading().value().get() + get_update_value<selector::hdg, Dir>(fast),
-                    360.0f
-                ))
-            );
-            break;
-        case selector::crs:
-            if(!dials.course()) return 0;
-            dials.course().value().set(
-                std::round(std::fmod(
-                    dials.course().value().get() + get_update_value<selector::crs, Dir>(fast),
-                    360.0f
-                ))
-            );
-            break;
-        case selector::ias:
-            if(!dials.ias()) return 0;
-            dials.ias().value().set(
-                std::max(
+    if(delta(selector::alt) != 0.0f and dials.alt()) {
+        dials.alt().value().set(
+            std::max(
                 0.0f,
-                dials.ias().value().get() + 
-                    ((dials.ias().value().unit() == airspeed_unit::Knots) ?
-                        get_update_value<selector::ias, Dir>(fast) : 
-                        get_update_value<selector::ias, Dir>(fast) * 0.1f)
-                )
-            );
-            break;
+                dials.alt().value().get() + delta(selector::alt)
+            )
+        );
     }
-    
-    self->last_cmd_ = now;
-    return 0;
+    if(delta(selector::vs) != 0.0f and dials.vs()) {
+        dials.vs().value().set(
+            dials.vs().value().get() + delta(selector::vs)
+        );
+    }
+    if(delta(selector::hdg) != 0.0f and dials.heading()) {
+        dials.heading().value().set(
+            std::round(std::fmod(
+                dials.heading().value().get() + delta(selector::hdg),
+                360.0f
+            ))
+        );
+    }
+    if(delta(selector::crs) != 0.0f and dials.course()) {
+        dials.course().value().set(
+            std::round(std::fmod(
+                dials.course().value().get() + delta(selector::crs),
+                360.0f
+            ))
+        );
+    }
+    if(delta(selector::ias) != 0.0f and dials.ias()) {
+        dials.ias().value().set(
+            std::max(
+            0.0f,
+            dials.ias().value().get() + 
+                ((dials.ias().value().unit() == airspeed_unit::Knots) ?
+                    delta(selector::ias) : 
+                    delta(selector::ias) * 0.1f)
+            )
+        );
+    }
+
+    this->state_.wake();
+}
+
+float
+commands::flush_iteration(float call, float iter, int counter, void * ref) noexcept
+{
+    commands * self = reinterpret_cast<commands *>(ref);
+    if(self->slewing_) self->slew(call);
+    self->flush();
+    return self->slewing_ ? -1.0f : 0;
 }
 
 int
 commands::ap_knob_up(XPLMCommandRef cmd, XPLMCommandPhase phase, void * ref) noexcept
 {
-    if(phase != xplm_CommandEnd) return 0;
-    return ap_knob_update<dir::inc>(ref);
+    commands * self = reinterpret_cast<commands *>(ref);
+    if(self->direct_) return 1;
+    perf_timer timer(perf_id::knob);
+    return self->ap_knob_hold<dir::inc>(phase);
 }
  
 
 int
 commands::ap_knob_down(XPLMCommandRef cmd, XPLMCommandPhase phase, void * ref) noexcept
 {
-    if(phase != xplm_CommandEnd) return 0;
-    return ap_knob_update<dir::dec>(ref);
+    commands * self = reinterpret_cast<commands *>(ref);
+    if(self->direct_) return 1;
+    perf_timer timer(perf_id::knob);
+    return self->ap_knob_hold<dir::dec>(phase);
+}
+
+void
+commands::select(selector sel) noexcept
+{
+    perf_timer timer(perf_id::knob);
+    this->active_ = sel;
+    this->state_.wake();
+}
+
+void
+commands::turn(dir direction) noexcept
+{
+    perf_timer timer(perf_id::knob);
+    if(direction == dir::inc) ap_knob_update<dir::inc>(this);
+    else ap_knob_update<dir::dec>(this);
 }
 
 
 
 std::expected<commands::ptr_type, int>
-commands::init(const state & state) noexcept
+commands::init(state & state) noexcept
 {
     ptr_type ret(new commands(state));
     for(const auto & desc  : descriptors) {
         ret.get()->*desc.cmd = XPLMCreateCommand(desc.path, desc.desc);
         if(ret.get()->*desc.cmd == nullptr) {
-            logger() << "Failed to register Selection Command";
+            log_error() << "Failed to register Selection Command";
             return std::unexpected(0);
         }
         XPLMRegisterCommandHandler(ret.get()->*desc.cmd, ap_knob_select, 1, reinterpret_cast<void *>(ret.get()));
     }
     ret->inc_ = XPLMCreateCommand("HCBravo/Inc", "Autopilot Knob Up");
     if(ret->inc_ == nullptr) {
-        logger() << "Failed to register Inc Command";
+        log_error() << "Failed to register Inc Command";
         return std::unexpected(0);
     }
     ret->dec_ = XPLMCreateCommand("HCBravo/Dec", "Autopilot Knob Down");
     if(ret->dec_ == nullptr) {
-        logger() << "Failed to register Dec Command";
+        log_error() << "Failed to register Dec Command";
         return std::unexpected(0);
     }
 
     XPLMRegisterCommandHandler(ret->inc_, ap_knob_up, 1, reinterpret_cast<void *>(ret.get()));
     XPLMRegisterCommandHandler(ret->dec_, ap_knob_down, 1, reinterpret_cast<void *>(ret.get()));
+
+    XPLMCreateFlightLoop_t params = {
+        .structSize = sizeof(XPLMCreateFlightLoop_t),
+        .phase = xplm_FlightLoop_Phase_BeforeFlightModel,
+        .callbackFunc = flush_iteration,
+        .refcon = ret.get(),
+    };
+    ret->flush_loop_ = XPLMCreateFlightLoop(&params);
+    if(ret->flush_loop_ == nullptr) {
+        log_error() << "Failed to Create Knob Flight Loop";
+        return std::unexpected(0);
+    }
  
     return ret;
 }
 
 commands::~commands() noexcept {
+    if(this->flush_loop_ != nullptr) XPLMDestroyFlightLoop(this->flush_loop_);
     if(this->dec_ != nullptr) XPLMUnregisterCommandHandler(this->dec_, ap_knob_down, 1, this);
     if(this->inc_ != nullptr) XPLMUnregisterCommandHandler(this->dec_, ap_knob_up, 1, this);
 
@@ -9,10 +9,13 @@
 #ifndef COMMAND_H_
 #define COMMAND_H_
 
+#include <XPLM/XPLMProcessing.h>
 #include <XPLM/XPLMUtilities.h>
 
+#include <array>
 #include <chrono>
 #include <expected>
+#include <limits>
 #include <memory>
 
 enum class selector : size_t {
@@ -20,11 +23,59 @@ enum class selector : size_t {
     vs = 1,
     hdg = 2,
     crs = 3,
-    ias = 4
+    ias = 4,
+    count = 5
+};
+
+// Estimates how fast a knob turns from the time of its latest detents
+class detent_rate {
+public:
+    using clock = std::chrono::steady_clock;
+    static const size_t history = 8;
+
+protected:
+    std::array<clock::time_point, history> detents_;
+    size_t next_;
+    size_t size_;
+
+public:
+    inline
+    detent_rate() noexcept :
+        next_(0),
+        size_(0)
+    {}
+
+    inline
+    void
+    reset() noexcept { this->size_ = 0; }
+
+    // Records a detent and returns the rate, in detents per second, of the
+    // detents within the window. A single detent has no rate
+    inline
+    float
+    add(clock::time_point now, std::chrono::duration<float> window) noexcept {
+        this->detents_[this->next_] = now;
+        this->next_ = (this->next_ + 1) % history;
+        if(this->size_ < history) ++this->size_;
+
+        size_t count = 1;
+        auto oldest = now;
+        for(; count < this->size_; ++count) {
+            auto detent = this->detents_[(this->next_ + history - 1 - count) % history];
+            if(now - detent > window) break;
+            oldest = detent;
+        }
+        if(count < 2) return 0.0f;
+        auto elapsed = std::chrono::duration<float>(now - oldest).count();
+        if(elapsed <= 0.0f) return std::numeric_limits<float>::max();
+        return static_cast<float>(count - 1) / elapsed;
+    }
 };
 
 struct descriptor;
 
+class acceleration_curve;
+
 class state;
 
 class commands {
@@ -48,8 +99,23 @@ private:
     static int
     ap_knob_down(XPLMCommandRef cmd, XPLMCommandPhase phase, void * ref) noexcept;
 
+    template<dir Dir>
+    int
+    ap_knob_hold(XPLMCommandPhase phase) noexcept;
+
+    // Acceleration curve of a knob, from the active profile or the defaults
+    const acceleration_curve &
+    curve(size_t knob) const noexcept;
+
+    // Moves the dial of a held knob command by the time elapsed, in seconds
+    void
+    slew(float elapsed) noexcept;
 
-    const state & state_;
+    static float
+    flush_iteration(float last_call, float last_iter, int counter, void * ref) noexcept;
+
+
+    state & state_;
 
     XPLMCommandRef sel_alt_;
     XPLMCommandRef sel_vs_;
@@ -60,10 +126,28 @@ private:
     XPLMCommandRef dec_;
 
     selector active_;
-    std::chrono::steady_clock::time_point   last_cmd_;
+    bool direct_;
+
+    // Turning another knob, or the other way, starts a new estimate
+    detent_rate rate_;
+    selector rate_selector_;
+    dir rate_dir_;
+
+    // Knob command being held, slewing the dial once held long enough
+    dir held_;
+    std::chrono::steady_clock::time_point held_since_;
+    bool slewing_;
+    float slew_time_;
+    float slew_elapsed_;
+    float slew_residue_;
+
+    // Knob turns since the last flush, per selector, in dial units
+    float pending_[static_cast<size_t>(selector::count)];
+    bool dirty_;
+    XPLMFlightLoopID flush_loop_;
 
     inline
-    commands(const state & state) :
+    commands(state & state) :
         state_(state),
         sel_alt_(nullptr),
         sel_vs_(nullptr),
@@ -72,7 +156,17 @@ private:
         sel_ias_(nullptr),
         inc_(nullptr),
         dec_(nullptr),
-        last_cmd_(std::chrono::steady_clock::now())
+        direct_(false),
+        rate_selector_(selector::alt),
+        rate_dir_(dir::inc),
+        held_(dir::inc),
+        slewing_(false),
+        slew_time_(0.0f),
+        slew_elapsed_(0.0f),
+        slew_residue_(0.0f),
+        pending_{},
+        dirty_(false),
+        flush_loop_(nullptr)
     {}
 
 public:
@@ -80,11 +174,49 @@ public:
 
     static
     std::expected<ptr_type, int>
-    init(const state & state) noexcept;
+    init(state & state) noexcept;
 
     inline
     const selector &
     active() const { return active_; }
+
+    // While the quadrant is read directly, the knob commands are left to
+    // X-Plane so joystick bindings do not apply every turn twice
+    inline
+    void
+    set_direct(bool direct) noexcept { direct_ = direct; }
+
+    void
+    select(selector sel) noexcept;
+
+    void
+    turn(dir direction) noexcept;
+
+    // Writes the turns accumulated since the last call, once per dial
+    void
+    flush() noexcept;
+
+#if defined(HCBRAVO_KNOB_TESTS)
+    inline
+    float
+    pending(selector sel) const noexcept { return this->pending_[static_cast<size_t>(sel)]; }
+
+    inline
+    bool
+    is_slewing() const noexcept { return this->slewing_; }
+
+    // Runs the Inc or Dec command handler as X-Plane would
+    inline
+    int
+    press(dir direction, XPLMCommandPhase phase) noexcept {
+        if(direction == dir::inc) return ap_knob_up(this->inc_, phase, this);
+        return ap_knob_down(this->dec_, phase, this);
+    }
+
+    inline
+    void
+    advance(float elapsed) noexcept { this->slew(elapsed); }
+#endif
 };
 
 
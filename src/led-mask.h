@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/led-mask.h
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#ifndef LED_MASK_H_
+#define LED_MASK_H_
+
+#include <optional>
+#include <tuple>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+static const size_t LED_NR_BANKS = 4;
+static const size_t LED_NR_BITS = 8;
+using led_id = std::tuple<uint8_t, uint8_t>;
+
+class led_mask {
+    uint8_t banks_[LED_NR_BANKS];
+    friend class led_state;
+public:
+    inline
+    led_mask() noexcept {
+        ::memset(banks_, 0, sizeof(banks_));
+    }
+
+    inline
+    void update(const led_id & id, bool value) noexcept {
+        if(value == true) {
+            banks_[std::get<0>(id)] |= (1 << std::get<1>(id));
+        }
+    }
+
+    inline
+    void update(const led_id & id, const std::optional<bool> & value) noexcept {
+        if(value.has_value()) update(id, value.value());
+    }
+
+    // Branch-free variant of update() used by compiled profiles
+    inline
+    void set(uint8_t bank, uint8_t bit, bool value) noexcept {
+        banks_[bank] |= static_cast<uint8_t>(value) << bit;
+    }
+
+    inline
+    bool get(const led_id & id) const noexcept {
+        return (banks_[std::get<0>(id)] & (static_cast<uint8_t>(1) << std::get<1>(id))) != 0;
+    }
+};
+
+// Upper button bar LEDs
+static const led_id LED_AP_HDG = { 0, 0 };
+static const led_id LED_AP_NAV = { 0, 1 };
+static const led_id LED_AP_APR = { 0, 2 };
+static const led_id LED_AP_REV = { 0, 3 };
+static const led_id LED_AP_ALT = { 0, 4 };
+static const led_id LED_AP_VS =  { 0, 5 };
+static const led_id LED_AP_IAS = { 0, 6 };
+
+static const led_id LED_AP =     { 0, 7 };
+
+// Landing Gear LEDs
+static const led_id LED_LDG_L_GREEN = { 1, 0 };
+static const led_id LED_LDG_L_RED =   { 1, 1 };
+static const led_id LED_LDG_N_GREEN = { 1, 2 };
+static const led_id LED_LDG_N_RED =   { 1, 3 };
+static const led_id LED_LDG_R_GREEN = { 1, 4 };
+static const led_id LED_LDG_R_RED =   { 1, 5 };
+
+// Status LEDs
+static const led_id LED_ANC_MSTR_WARN = { 1, 6 };
+static const led_id LED_ANC_ENG_FIRE  = { 1, 7 };
+static const led_id LED_ANC_OIL       = { 2, 0 };
+static const led_id LED_ANC_FUEL      = { 2, 1 };
+static const led_id LED_ANC_ANTI_ICE  = { 2, 2 };
+static const led_id LED_ANC_STARTER   = { 2, 3 };
+static const led_id LED_ANC_APU       = { 2, 4 };
+static const led_id LED_ANC_MSTR_CTN  = { 2, 5 };
+static const led_id LED_ANC_VACUUM    = { 2, 6 };
+static const led_id LED_ANC_HYD       = { 2, 7 };
+static const led_id LED_ANC_AUX_FUEL  = { 3, 0 };
+static const led_id LED_ANC_PRK_BRK   = { 3, 1 };
+static const led_id LED_ANC_VOLTS     = { 3, 2 };
+static const led_id LED_ANC_DOOR      = { 3, 3 };
+
+#endif
\ No newline at end of file
@@ -9,12 +9,73 @@
 
 #include <cstring>
 
-led_state::led_state() noexcept 
+led_state::led_state() noexcept :
+    hid_(nullptr),
+    lock_(nullptr),
+    mailbox_(0),
+    errors_(0)
 {
     ::memset(reinterpret_cast<void *>(&u), 0, sizeof(u));
 }
 
-led_state::led_state(led_state && other) noexcept 
+led_state::led_state(led_state && other) noexcept :
+    hid_(other.hid_),
+    lock_(other.lock_),
+    mailbox_(0),
+    errors_(0)
 {
     ::memcpy(&u, &other.u, sizeof(u));
+}
+
+led_state::~led_state() noexcept
+{
+    this->stop_writer();
+}
+
+void
+led_state::start_writer() noexcept
+{
+    if(this->is_async()) return;
+    this->mailbox_.store(0);
+    this->writer_ = std::thread(&led_state::writer, this, this->u.state_);
+}
+
+void
+led_state::stop_writer() noexcept
+{
+    if(this->is_async() == false) return;
+    this->mailbox_.fetch_or(mailbox_stop, std::memory_order_release);
+    this->mailbox_.notify_one();
+    this->writer_.join();
+}
+
+void
+led_state::writer(led_state * self, hid_data initial) noexcept
+{
+    // The writer owns its own report buffer, so the flight loop never waits on it
+    union {
+        hid_data   state_;
+        buffer_type  buffer_;
+    } report;
+    report.state_ = initial;
+    trace::name_thread("LED Writer");
+
+    for(;;) {
+        self->mailbox_.wait(0, std::memory_order_acquire);
+        auto value = self->mailbox_.exchange(0, std::memory_order_acquire);
+
+        if(value & mailbox_pending) {
+            for(size_t n = 0; n < LED_NR_BANKS; ++n) {
+                report.state_.banks_[n] = static_cast<uint8_t>(value >> (8 * n));
+            }
+            perf_timer timer(perf_id::hid_write);
+            trace_scope scope("hid_send_feature_report");
+            self->lock_->lock_write();
+            if(hid_send_feature_report(self->hid_, report.buffer_, sizeof(hid_data)) < 0) {
+                self->errors_.fetch_add(1, std::memory_order_relaxed);
+            }
+            self->lock_->unlock_write();
+        }
+        if(value & mailbox_stop) break;
+    }
 }
\ No newline at end of file
@@ -8,9 +8,14 @@
 #ifndef LED_H_
 #define LED_H_
 
+#include "perf.h"
+#include "trace.h"
+
 #include <XPLM/XPLMUtilities.h>
 
+#include <atomic>
 #include <optional>
+#include <thread>
 #include <tuple>
 
 #include <cstdint>
@@ -18,34 +23,10 @@
 
 #include <hidapi.h>
 
+#include "hid-lock.h"
+#include "led-mask.h"
 #include "logger.h"
 
-static const size_t LED_NR_BANKS = 4;
-static const size_t LED_NR_BITS = 8;
-using led_id = std::tuple<uint8_t, uint8_t>;
-
-class led_mask {
-    uint8_t banks_[LED_NR_BANKS];
-    friend class led_state;
-public:
-    inline
-    led_mask() noexcept {
-        ::memset(banks_, 0, sizeof(banks_));
-    }
-
-    inline
-    void update(const led_id & id, bool value) noexcept {
-        if(value == true) {
-            banks_[std::get<0>(id)] |= (1 << std::get<1>(id));
-        }
-    }
-
-    inline
-    void update(const led_id & id, const std::optional<bool> & value) noexcept {
-        if(value.has_value()) update(id, value.value());
-    }
-};
-
 class led_state {
 protected:
     #pragma pack(push, 1)
@@ -63,12 +44,59 @@ protected:
         buffer_type  buffer_;
     } u;
     hid_device_ * hid_;
+    // Shared with the input reader, which uses the same device
+    hid_lock * lock_;
+
+    // Single-slot mailbox shared with the writer thread. It holds the latest
+    // bank mask plus the pending and stop flags; publishing a new mask simply
+    // overwrites any mask the writer has not sent yet
+    static const uint64_t mailbox_pending = uint64_t(1) << 32;
+    static const uint64_t mailbox_stop = uint64_t(1) << 33;
+    std::atomic<uint64_t> mailbox_;
+    std::atomic<size_t> errors_;
+    std::thread writer_;
+
+    // Starts from a copy of the report taken before the thread was spawned,
+    // so it never reads the one the flight loop updates
+    static
+    void
+    writer(led_state * self, hid_data initial) noexcept;
+
+    static inline
+    uint64_t
+    pack(const uint8_t (&banks)[LED_NR_BANKS]) noexcept {
+        uint64_t value = 0;
+        for(size_t n = 0; n < LED_NR_BANKS; ++n) value |= uint64_t(banks[n]) << (8 * n);
+        return value;
+    }
 
     friend class state;
 public:
     led_state() noexcept;
     led_state(led_state &&) noexcept;
 
+    ~led_state() noexcept;
+
+    // Device LED reports are sent to; none until the quadrant is opened
+    inline
+    void
+    attach(hid_device_ * hid, hid_lock & lock) noexcept {
+        this->hid_ = hid;
+        this->lock_ = &lock;
+    }
+
+    // Moves HID writes out of the flight loop into a dedicated thread
+    void
+    start_writer() noexcept;
+
+    // Sends any pending LED state and stops the writer thread
+    void
+    stop_writer() noexcept;
+
+    inline
+    bool
+    is_async() const noexcept { return this->writer_.joinable(); }
+
 #if !defined(NDEBUG)
     inline
     bool
@@ -77,60 +105,45 @@ public:
     }
 #endif
 
+    // Returns true if the LED state changed
     inline
-    void
+    bool
     update(const led_mask & mask) {
-        if(this->hid_ == nullptr) return;
+        if(this->hid_ == nullptr) return false;
 
         size_t n;
         for(n = 0; n < LED_NR_BANKS; ++n) {
             if(u.state_.banks_[n] != mask.banks_[n]) break;
         }
-        if(n == LED_NR_BANKS) return;
+        if(n == LED_NR_BANKS) {
+            perf::skipped();
+            return false;
+        }
         ::memcpy(u.state_.banks_, mask.banks_, sizeof(mask.banks_));
+        perf::sent();
+
+        if(this->is_async()) {
+            this->mailbox_.store(mailbox_pending | pack(mask.banks_), std::memory_order_release);
+            this->mailbox_.notify_one();
+
+            auto errors = this->errors_.exchange(0, std::memory_order_relaxed);
+            if(errors > 0) {
+                log_error() << "Failed to update LED state (" << errors << " time(s))";
+            }
+            return true;
+        }
+
+        perf_timer timer(perf_id::hid_write);
+        trace_scope scope("hid_send_feature_report");
+        this->lock_->lock_write();
         int ret = hid_send_feature_report(this->hid_, this->u.buffer_, sizeof(hid_data));
+        this->lock_->unlock_write();
         if(ret < 0) {
-            logger() << "Failed to update LED state";
+            log_error() << "Failed to update LED state";
         }
+        return true;
     }
 
 };
 
-// Upper button bar LEDs
-static const led_id LED_AP_HDG = { 0, 0 };
-static const led_id LED_AP_NAV = { 0, 1 };
-static const led_id LED_AP_APR = { 0, 2 };
-static const led_id LED_AP_REV = { 0, 3 };
-static const led_id LED_AP_ALT = { 0, 4 };
-static const led_id LED_AP_VS =  { 0, 5 };
-static const led_id LED_AP_IAS = { 0, 6 };
-
-static const led_id LED_AP =     { 0, 7 };
-
-// Landing Gear LEDs
-static const led_id LED_LDG_L_GREEN = { 1, 0 };
-static const led_id LED_LDG_L_RED =   { 1, 1 };
-static const led_id LED_LDG_N_GREEN = { 1, 2 };
-static const led_id LED_LDG_N_RED =   { 1, 3 };
-static const led_id LED_LDG_R_GREEN = { 1, 4 };
-static const led_id LED_LDG_R_RED =   { 1, 5 };
-
-// Status LEDs
-static const led_id LED_ANC_MSTR_WARN = { 1, 6 };
-static const led_id LED_ANC_ENG_FIRE  = { 1, 7 };
-static const led_id LED_ANC_OIL       = { 2, 0 };
-static const led_id LED_ANC_FUEL      = { 2, 1 };
-static const led_id LED_ANC_ANTI_ICE  = { 2, 2 };
-static const led_id LED_ANC_STARTER   = { 2, 3 };
-static const led_id LED_ANC_APU       = { 2, 4 };
-static const led_id LED_ANC_MSTR_CTN  = { 2, 5 };
-static const led_id LED_ANC_VACUUM    = { 2, 6 };
-static const led_id LED_ANC_HYD       = { 2, 7 };
-static const led_id LED_ANC_AUX_FUEL  = { 3, 0 };
-static const led_id LED_ANC_PRK_BRK   = { 3, 1 };
-static const led_id LED_ANC_VOLTS     = { 3, 2 };
-static const led_id LED_ANC_DOOR      = { 3, 3 };
-
-
-
 #endif
\ No newline at end of file
@@ -8,28 +8,370 @@
 #ifndef LOGGER_H_
 #define LOGGER_H_
 
+#include <XPLM/XPLMProcessing.h>
 #include <XPLM/XPLMUtilities.h>
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Messages below this level compile to nothing: 0 trace, 1 debug, 2 info, 3 warn, 4 error
+#if !defined(HCBRAVO_LOG_LEVEL)
+#define HCBRAVO_LOG_LEVEL 2
+#endif
+
+enum class log_level : int {
+    trace = 0,
+    debug = 1,
+    info = 2,
+    warn = 3,
+    error = 4
+};
+
+// Formatted messages, queued by any thread and written to X-Plane by the sim thread.
+//
+// Once started, X-Plane gets the queued messages in batches from a flight
+// loop, since XPLMDebugString may only be called from the sim thread. Until
+// then, and after stopping, messages are written as they are logged.
+class log_sink {
+public:
+    static constexpr size_t max_size = 512;
+    static constexpr size_t capacity = 256;
+
+    // Identical messages from a thread past the first rate_burst within
+    // rate_window are dropped, and counted in the next one let through
+    static constexpr uint32_t rate_burst = 5;
+    static constexpr std::chrono::seconds rate_window{ 1 };
+
+    // Seconds between writes to X-Plane
+    static constexpr float drain_interval = 0.25f;
 
-class logger {
 protected:
-    std::stringstream output_;
+    struct record {
+        uint32_t size_;
+        char text_[max_size];
+    };
+
+    // Bounded multi-producer queue; a cell holds the position it can be
+    // written at, or that position plus one once it holds a record
+    struct cell {
+        std::atomic<size_t> seq_;
+        record record_;
+    };
+
+    struct queue {
+        cell cells_[capacity];
+        std::atomic<size_t> enqueue_;
+        std::atomic<size_t> dequeue_;
+
+        queue() noexcept :
+            enqueue_(0),
+            dequeue_(0)
+        {
+            for(size_t n = 0; n < capacity; ++n) this->cells_[n].seq_.store(n, std::memory_order_relaxed);
+        }
+
+        bool
+        push(const char * text, size_t size) noexcept {
+            auto pos = this->enqueue_.load(std::memory_order_relaxed);
+            cell * c;
+            for(;;) {
+                c = &this->cells_[pos % capacity];
+                auto seq = c->seq_.load(std::memory_order_acquire);
+                auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if(diff == 0) {
+                    if(this->enqueue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                }
+                else if(diff < 0) return false;
+                else pos = this->enqueue_.load(std::memory_order_relaxed);
+            }
+            c->record_.size_ = static_cast<uint32_t>(size);
+            ::memcpy(c->record_.text_, text, size);
+            c->seq_.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        template<typename F>
+        bool
+        pop(F && f) noexcept {
+            auto pos = this->dequeue_.load(std::memory_order_relaxed);
+            cell * c;
+            for(;;) {
+                c = &this->cells_[pos % capacity];
+                auto seq = c->seq_.load(std::memory_order_acquire);
+                auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+                if(diff == 0) {
+                    if(this->dequeue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                }
+                else if(diff < 0) return false;
+                else pos = this->dequeue_.load(std::memory_order_relaxed);
+            }
+            f(c->record_.text_, c->record_.size_);
+            c->seq_.store(pos + capacity, std::memory_order_release);
+            return true;
+        }
+    };
+
+    struct repeat {
+        uint64_t hash_;
+        std::chrono::steady_clock::time_point start_;
+        uint32_t count_;
+        uint32_t suppressed_;
+    };
+
+    static inline queue queue_;
+    static inline std::atomic<bool> started_ = false;
+    static inline std::atomic<size_t> dropped_ = 0;
+    static inline XPLMFlightLoopID drain_loop_ = nullptr;
+
+    static inline thread_local repeat repeats_[8] = {};
+    static inline thread_local size_t next_repeat_ = 0;
+
+    static inline
+    uint64_t
+    hash(const char * text, size_t size) noexcept {
+        uint64_t ret = 0xcbf29ce484222325ull;
+        for(size_t n = 0; n < size; ++n) ret = (ret ^ static_cast<unsigned char>(text[n])) * 0x100000001b3ull;
+        return ret;
+    }
+
+    // Returns false if the message must be dropped; otherwise, suppressed
+    // holds how many copies of it were dropped before
+    static inline
+    bool
+    rate(const char * text, size_t size, uint32_t & suppressed) noexcept {
+        auto h = hash(text, size);
+        auto now = std::chrono::steady_clock::now();
+        suppressed = 0;
+        for(auto & r : repeats_) {
+            if(r.count_ == 0 or r.hash_ != h) continue;
+            if(now - r.start_ >= rate_window) {
+                suppressed = r.suppressed_;
+                r = repeat{ h, now, 1, 0 };
+                return true;
+            }
+            if(r.count_ < rate_burst) {
+                ++r.count_;
+                return true;
+            }
+            ++r.suppressed_;
+            return false;
+        }
+        repeats_[next_repeat_++ % std::size(repeats_)] = repeat{ h, now, 1, 0 };
+        return true;
+    }
+
+    static inline
+    void
+    write(const char * text, size_t size) noexcept {
+        if(started_.load(std::memory_order_acquire) == false) {
+            XPLMDebugString(text);
+            return;
+        }
+        if(queue_.push(text, size + 1) == false) dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static
+    float
+    drain_iteration(float, float, int, void *) noexcept {
+        flush();
+        return drain_interval;
+    }
 
 public:
+    // Starts batching messages; sim thread only
+    static inline
+    void
+    start() noexcept {
+        if(drain_loop_ != nullptr) return;
+        XPLMCreateFlightLoop_t params = {
+            .structSize = sizeof(XPLMCreateFlightLoop_t),
+            .phase = xplm_FlightLoop_Phase_AfterFlightModel,
+            .callbackFunc = drain_iteration,
+            .refcon = nullptr,
+        };
+        drain_loop_ = XPLMCreateFlightLoop(&params);
+        if(drain_loop_ == nullptr) return;
+        started_.store(true, std::memory_order_release);
+        XPLMScheduleFlightLoop(drain_loop_, drain_interval, 1);
+    }
+
+    // Writes the pending messages and goes back to writing them as they are
+    // logged; sim thread only, once no other thread logs
+    static inline
+    void
+    stop() noexcept {
+        if(drain_loop_ == nullptr) return;
+        XPLMDestroyFlightLoop(drain_loop_);
+        drain_loop_ = nullptr;
+        flush();
+        started_.store(false, std::memory_order_release);
+    }
+
+    // Writes the pending messages to X-Plane; sim thread only
+    static inline
+    void
+    flush() noexcept {
+        char batch[4 * max_size];
+        size_t size = 0;
+        auto append = [&batch, &size](const char * text, size_t length) {
+            // Records hold their terminating null character
+            if(size + length > sizeof(batch)) {
+                XPLMDebugString(batch);
+                size = 0;
+            }
+            ::memcpy(batch + size, text, length);
+            size += length - 1;
+        };
+        while(queue_.pop(append)) {}
+
+        auto dropped = dropped_.exchange(0, std::memory_order_relaxed);
+        if(dropped > 0) {
+            static const std::string_view prefix = "[HCBravo] WARN: Dropped ";
+            static const char suffix[] = " log message(s)\n";
+            char text[96];
+            auto end = std::copy(prefix.begin(), prefix.end(), text);
+            end = std::to_chars(end, text + sizeof(text), dropped).ptr;
+            end = std::copy(std::begin(suffix), std::end(suffix), end);
+            append(text, end - text);
+        }
+        if(size > 0) XPLMDebugString(batch);
+    }
+};
+
+// Formats a message into a fixed buffer on the stack of the logging thread,
+// and hands it to the sink when going out of scope.
+//
+// Loggers below HCBRAVO_LOG_LEVEL do nothing, though their arguments are
+// still evaluated. Messages longer than the buffer are truncated.
+template<log_level Level>
+class basic_logger : public log_sink {
+public:
+    static constexpr bool enabled = static_cast<int>(Level) >= HCBRAVO_LOG_LEVEL;
+
+protected:
+    // Room for the suppressed count, the new line and the null character
+    static constexpr size_t reserved = 48;
+
+    char text_[enabled ? max_size : 1];
+    size_t size_;
+
+    static constexpr
+    std::string_view
+    prefix() noexcept {
+        switch(Level) {
+            case log_level::trace: return "[HCBravo] TRACE: ";
+            case log_level::debug: return "[HCBravo] DEBUG: ";
+            case log_level::info: return "[HCBravo] : ";
+            case log_level::warn: return "[HCBravo] WARN: ";
+            case log_level::error: return "[HCBravo] ERROR: ";
+        }
+        return "[HCBravo] : ";
+    }
+
+    inline
+    void
+    append(std::string_view value) noexcept {
+        auto length = std::min(value.size(), max_size - reserved - this->size_);
+        ::memcpy(this->text_ + this->size_, value.data(), length);
+        this->size_ += length;
+    }
+
     template<typename T>
     inline
-    logger & operator<<(T const & buffer) noexcept {
-        output_ << buffer;
+    void
+    append_number(T value) noexcept {
+        char number[64];
+        std::to_chars_result ret;
+        if constexpr(std::is_floating_point_v<T>) {
+            ret = std::to_chars(number, number + sizeof(number), value, std::chars_format::general, 6);
+        }
+        else {
+            ret = std::to_chars(number, number + sizeof(number), value);
+        }
+        this->append(std::string_view(number, ret.ptr - number));
+    }
+
+public:
+    inline
+    basic_logger() noexcept :
+        size_(0)
+    {
+        if constexpr(enabled) this->append(prefix());
+    }
+
+    template<typename T>
+    inline
+    basic_logger & operator<<(T const & value) noexcept {
+        if constexpr(enabled == false) {
+            return *this;
+        }
+        else if constexpr(std::is_same_v<T, bool>) {
+            this->append(value ? "1" : "0");
+        }
+        else if constexpr(std::is_same_v<T, char>) {
+            this->append(std::string_view(&value, 1));
+        }
+        else if constexpr(std::is_integral_v<T> or std::is_floating_point_v<T>) {
+            this->append_number(value);
+        }
+        else if constexpr(std::is_convertible_v<T const &, std::string_view>) {
+            std::string_view view = value;
+            this->append(view);
+        }
+        else if constexpr(std::is_same_v<T, std::filesystem::path>) {
+            // Quoted, as when streamed
+            this->append("\"");
+            if constexpr(std::is_same_v<std::filesystem::path::value_type, char>) this->append(value.native());
+            else this->append(value.string());
+            this->append("\"");
+        }
+        else {
+            // Types without their own formatting, e.g. YAML nodes, go through
+            // a stream, which may allocate
+            static thread_local std::ostringstream stream;
+            stream.str(std::string());
+            stream << value;
+            this->append(stream.view());
+        }
         return *this;
     }
 
     inline
-    ~logger() noexcept {
-        output_ << std::endl;
-        std::string output = "[HCBravo] : " + output_.str();
-        XPLMDebugString(output.c_str());
+    ~basic_logger() noexcept {
+        if constexpr(enabled) {
+            uint32_t suppressed;
+            if(rate(this->text_, this->size_, suppressed) == false) return;
+            if(suppressed > 0) {
+                static const std::string_view repeated = " (and ";
+                ::memcpy(this->text_ + this->size_, repeated.data(), repeated.size());
+                this->size_ += repeated.size();
+                this->size_ = std::to_chars(this->text_ + this->size_, this->text_ + max_size, suppressed).ptr - this->text_;
+                static const std::string_view times = " more time(s))";
+                ::memcpy(this->text_ + this->size_, times.data(), times.size());
+                this->size_ += times.size();
+            }
+            this->text_[this->size_++] = '\n';
+            this->text_[this->size_] = '\0';
+            write(this->text_, this->size_);
+        }
     }
 };
 
-#endif
\ No newline at end of file
+using logger = basic_logger<log_level::info>;
+using log_trace = basic_logger<log_level::trace>;
+using log_debug = basic_logger<log_level::debug>;
+using log_warn = basic_logger<log_level::warn>;
+using log_error = basic_logger<log_level::error>;
+
+#endif
@@ -22,12 +22,16 @@
 #include "logger.h"
 #include "profile.h"
 #include "state.h"
+#include "trace.h"
 
 static std::optional<state::ptr_type> plugin_state;
 
 PLUGIN_API 
 int
 XPluginStart(char * name, char * sig, char * desc) {
+    trace::name_thread("X-Plane");
+    trace_scope scope("XPluginStart");
+    logger::start();
     strncpy(name, "HCBravo", 256);
     strncpy(sig, "hc.bravo", 256);
     strncpy(desc, "Plugin for HoneyComb Bravo Quadrant", 256);
@@ -36,12 +40,14 @@ XPluginStart(char * name, char * sig, char * desc) {
     XPLMEnableFeature("XPLM_USE_NATIVE_PATHS", 1);
     auto state = state::init();
     if(state.has_value() == false) {
-       logger() << "Failed to initialize Plugin";
+       log_error() << "Failed to initialize Plugin";
+       logger::stop();
        return 0;
     }
     plugin_state.emplace(std::move(state.value()));
 
     logger() << "HCBravo Initialized";
+    logger::flush();
     return 1;
 }
 
@@ -49,6 +55,7 @@ PLUGIN_API
 void
 XPluginStop(void) {
     plugin_state = std::nullopt;
+    logger::stop();
 }
 
 PLUGIN_API
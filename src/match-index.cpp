@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/match-index.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#include "logger.h"
+#include "match-index.h"
+
+#include <algorithm>
+#include <map>
+#include <numeric>
+
+uint64_t
+match_index::hash(std::string_view value, uint64_t seed) noexcept
+{
+    // FNV-1a, followed by the MurmurHash3 finalizer to spread nearby seeds
+    uint64_t ret = 0xcbf29ce484222325ull ^ (seed * 0x9e3779b97f4a7c15ull);
+    for(unsigned char c : value) {
+        ret ^= c;
+        ret *= 0x100000001b3ull;
+    }
+    ret ^= ret >> 33;
+    ret *= 0xff51afd7ed558ccdull;
+    ret ^= ret >> 33;
+    ret *= 0xc4ceb9fe1a85ec53ull;
+    ret ^= ret >> 33;
+    return ret;
+}
+
+match_index::rule
+match_index::parse(const std::string & text, int32_t priority, uint32_t owner) noexcept
+{
+    rule ret{ text, kind::exact, priority, owner };
+    auto meta = text.find_first_of("*?[");
+    if(text.size() >= 2 and text.front() == '/' and text.back() == '/') ret.kind_ = kind::regex;
+    else if(meta == std::string::npos) ret.kind_ = kind::exact;
+    else if(meta == text.size() - 1 and text.back() == '*') ret.kind_ = kind::prefix;
+    else ret.kind_ = kind::glob;
+    return ret;
+}
+
+const char *
+match_index::name(kind value) noexcept
+{
+    switch(value) {
+        case kind::exact: return "exact";
+        case kind::prefix: return "prefix";
+        case kind::glob: return "glob";
+        case kind::regex: return "regex";
+    }
+    return "unknown";
+}
+
+bool
+match_index::precedes(const rule & a, const rule & b) noexcept
+{
+    if(a.priority_ != b.priority_) return a.priority_ > b.priority_;
+    // Globs and regular expressions rank the same
+    auto rank = [](kind value) { return std::min<int>(static_cast<int>(value), static_cast<int>(kind::glob)); };
+    if(rank(a.kind_) != rank(b.kind_)) return rank(a.kind_) < rank(b.kind_);
+    if(a.kind_ == kind::prefix and a.text_.size() != b.text_.size()) return a.text_.size() > b.text_.size();
+    return a.owner_ < b.owner_;
+}
+
+void
+match_index::build_hash() noexcept
+{
+    // Names claimed by several rules keep the one taking precedence
+    std::map<std::string_view, uint32_t> names;
+    for(uint32_t id = 0; id < this->rules_.size(); ++id) {
+        const auto & rule = this->rules_[id];
+        if(rule.kind_ != kind::exact) continue;
+        auto ret = names.emplace(rule.text_, id);
+        if(ret.second == false and precedes(rule, this->rules_[ret.first->second])) ret.first->second = id;
+    }
+    if(names.empty()) return;
+
+    auto count = names.size();
+    std::vector<std::vector<uint32_t>> buckets(count);
+    for(const auto & [name, id] : names) buckets[hash(name, 0) % count].emplace_back(id);
+
+    // Large buckets are the hardest to place, so they go first while most
+    // slots are still free
+    std::vector<uint32_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    this->displacements_.assign(count, 0);
+    this->slots_.assign(count, none);
+    std::vector<uint64_t> taken;
+    for(auto bucket : order) {
+        const auto & ids = buckets[bucket];
+        if(ids.empty()) break;
+        // Names are distinct, so some displacement always places them all
+        for(uint32_t displacement = 1; ; ++displacement) {
+            taken.clear();
+            for(auto id : ids) {
+                auto slot = hash(this->rules_[id].text_, displacement) % count;
+                if(this->slots_[slot] != none or std::find(taken.begin(), taken.end(), slot) != taken.end()) break;
+                taken.emplace_back(slot);
+            }
+            if(taken.size() < ids.size()) continue;
+
+            for(size_t n = 0; n < ids.size(); ++n) this->slots_[taken[n]] = ids[n];
+            this->displacements_[bucket] = displacement;
+            break;
+        }
+    }
+}
+
+void
+match_index::build_trie() noexcept
+{
+    // Built with maps, then flattened so edges of a node are contiguous
+    std::vector<std::map<char, uint32_t>> children(1);
+    std::vector<uint32_t> rules(1, none);
+    for(uint32_t id = 0; id < this->rules_.size(); ++id) {
+        const auto & rule = this->rules_[id];
+        if(rule.kind_ != kind::prefix) continue;
+        uint32_t node = 0;
+        for(auto c : std::string_view(rule.text_).substr(0, rule.text_.size() - 1)) {
+            auto ret = children[node].emplace(c, static_cast<uint32_t>(children.size()));
+            if(ret.second) {
+                children.emplace_back();
+                rules.emplace_back(none);
+            }
+            node = ret.first->second;
+        }
+        if(rules[node] == none or precedes(rule, this->rules_[rules[node]])) rules[node] = id;
+    }
+    if(children.size() == 1 and rules.front() == none) return;
+
+    this->nodes_.reserve(children.size());
+    this->edges_.reserve(children.size() - 1);
+    for(size_t node = 0; node < children.size(); ++node) {
+        this->nodes_.emplace_back(trie_node{
+            static_cast<uint32_t>(this->edges_.size()), static_cast<uint32_t>(children[node].size()), rules[node]
+        });
+        for(const auto & [label, child] : children[node]) this->edges_.emplace_back(trie_edge{ label, child });
+    }
+}
+
+static
+std::string
+glob_to_regex(const std::string & glob) noexcept
+{
+    std::string ret;
+    for(size_t n = 0; n < glob.size(); ++n) {
+        auto c = glob[n];
+        switch(c) {
+            case '*': ret += ".*"; break;
+            case '?': ret += '.'; break;
+            case '[': {
+                auto end = glob.find(']', n + 1);
+                if(end == std::string::npos) {
+                    ret += "\\[";
+                    break;
+                }
+                ret += '[';
+                auto first = n + 1;
+                if(first < end and glob[first] == '!') {
+                    ret += '^';
+                    ++first;
+                }
+                for(auto i = first; i < end; ++i) {
+                    if(glob[i] == '\\' or glob[i] == '^' or glob[i] == '[') ret += '\\';
+                    ret += glob[i];
+                }
+                ret += ']';
+                n = end;
+                break;
+            }
+            default:
+                if(std::string_view("\\^$.|+()[]{}").find(c) != std::string_view::npos) ret += '\\';
+                ret += c;
+                break;
+        }
+    }
+    return ret;
+}
+
+void
+match_index::build_patterns() noexcept
+{
+    std::vector<uint32_t> ids;
+    for(uint32_t id = 0; id < this->rules_.size(); ++id) {
+        auto type = this->rules_[id].kind_;
+        if(type == kind::glob or type == kind::regex) ids.emplace_back(id);
+    }
+    std::stable_sort(ids.begin(), ids.end(), [this](uint32_t a, uint32_t b) {
+        return precedes(this->rules_[a], this->rules_[b]);
+    });
+
+    for(auto id : ids) {
+        const auto & rule = this->rules_[id];
+        auto expression = rule.kind_ == kind::regex ? rule.text_.substr(1, rule.text_.size() - 2) : glob_to_regex(rule.text_);
+        try {
+            this->patterns_.emplace_back(id, std::regex(expression, std::regex::ECMAScript | std::regex::optimize));
+        }
+        catch(const std::regex_error & e) {
+            log_warn() << "Ignoring invalid pattern '" << rule.text_ << "': " << e.what();
+        }
+    }
+}
+
+match_index
+match_index::build(std::vector<rule> && rules) noexcept
+{
+    match_index ret;
+    ret.rules_ = std::move(rules);
+    ret.build_hash();
+    ret.build_trie();
+    ret.build_patterns();
+    return ret;
+}
+
+const match_index::rule *
+match_index::find(std::string_view name) const noexcept
+{
+    const rule * ret = nullptr;
+    auto consider = [&ret](const rule & candidate) {
+        if(ret == nullptr or precedes(candidate, *ret)) ret = &candidate;
+    };
+
+    if(this->slots_.empty() == false) {
+        auto count = this->slots_.size();
+        auto displacement = this->displacements_[hash(name, 0) % count];
+        // Names that are not in the hash still land on some slot
+        const auto & candidate = this->rules_[this->slots_[hash(name, displacement) % count]];
+        if(candidate.text_ == name) consider(candidate);
+    }
+
+    if(this->nodes_.empty() == false) {
+        uint32_t node = 0;
+        for(size_t n = 0; ; ++n) {
+            const auto & current = this->nodes_[node];
+            if(current.rule_ != none) consider(this->rules_[current.rule_]);
+            if(n == name.size()) break;
+
+            auto first = this->edges_.begin() + current.first_;
+            auto last = first + current.count_;
+            auto edge = std::lower_bound(first, last, name[n], [](const trie_edge & edge, char label) {
+                return edge.label_ < label;
+            });
+            if(edge == last or edge->label_ != name[n]) break;
+            node = edge->node_;
+        }
+    }
+
+    // Patterns lose ties against names and prefixes, and are sorted, so the
+    // first one that matches is the best of them
+    for(const auto & [id, pattern] : this->patterns_) {
+        const auto & candidate = this->rules_[id];
+        if(ret != nullptr and ret->priority_ >= candidate.priority_) break;
+        if(std::regex_match(name.begin(), name.end(), pattern)) {
+            consider(candidate);
+            break;
+        }
+    }
+    return ret;
+}
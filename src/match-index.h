@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/match-index.h
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#ifndef MATCH_INDEX_H_
+#define MATCH_INDEX_H_
+
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+// Rules matching aircraft names or ICAO models, compiled into one index.
+//
+// Each entry of the aircrafts or models of a profile is a rule:
+//   Cessna 172SP          exact name
+//   Cessna 172*           prefix, i.e. a single trailing '*'
+//   Cessna 1?2 * (G1000)  glob, with '*', '?' and '[...]' anywhere
+//   /C1[5-8]\d/           ECMAScript regular expression matching the whole name
+//
+// Exact names are looked up in a minimal perfect hash and prefixes in a trie,
+// so the cost of a lookup depends on the length of the name rather than on
+// the number of rules. Globs and regular expressions are only tried while
+// they can still beat the best match found.
+//
+// The rule with the highest priority wins. Between rules of equal priority,
+// exact names beat prefixes, longer prefixes beat shorter ones, and prefixes
+// beat patterns. Any remaining tie goes to the lowest owner, i.e. the profile
+// file that comes first in name order.
+class match_index {
+public:
+    enum class kind : uint8_t {
+        exact,
+        prefix,
+        glob,
+        regex
+    };
+
+    struct rule {
+        // As written in the profile
+        std::string text_;
+        kind kind_;
+        int32_t priority_;
+        uint32_t owner_;
+    };
+
+protected:
+    static constexpr uint32_t none = UINT32_MAX;
+
+    struct trie_node {
+        uint32_t first_;
+        uint32_t count_;
+        uint32_t rule_;
+    };
+
+    struct trie_edge {
+        char label_;
+        uint32_t node_;
+    };
+
+    std::vector<rule> rules_;
+
+    // Minimal perfect hash of the exact names. Names are spread over buckets,
+    // and the displacement of each bucket seeds the hash that places its
+    // names in a slot no other name uses
+    std::vector<uint32_t> displacements_;
+    std::vector<uint32_t> slots_;
+
+    // Edges of a node are contiguous and sorted by label
+    std::vector<trie_node> nodes_;
+    std::vector<trie_edge> edges_;
+
+    // Globs and regular expressions, in precedence order
+    std::vector<std::pair<uint32_t, std::regex>> patterns_;
+
+    static
+    uint64_t
+    hash(std::string_view value, uint64_t seed) noexcept;
+
+    void
+    build_hash() noexcept;
+
+    void
+    build_trie() noexcept;
+
+    void
+    build_patterns() noexcept;
+
+public:
+    match_index() noexcept = default;
+
+    // Classifies a rule as written in a profile
+    static
+    rule
+    parse(const std::string & text, int32_t priority, uint32_t owner) noexcept;
+
+    // Patterns that are not valid regular expressions are dropped
+    static
+    match_index
+    build(std::vector<rule> && rules) noexcept;
+
+    static
+    const char *
+    name(kind value) noexcept;
+
+    // Whether the first rule takes precedence over the second one when both match
+    static
+    bool
+    precedes(const rule & a, const rule & b) noexcept;
+
+    // Best rule matching the name, if any
+    const rule *
+    find(std::string_view name) const noexcept;
+
+    inline
+    const std::vector<rule> &
+    rules() const noexcept { return this->rules_; }
+
+    inline
+    size_t
+    size() const noexcept { return this->rules_.size(); }
+};
+
+#endif
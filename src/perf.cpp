@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/perf.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#include "perf.h"
+
+#include <XPLM/XPLMDataAccess.h>
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+#include "logger.h"
+
+#if defined(HCBRAVO_PERF)
+
+// Every counter is published as:
+//   hcbravo/perf/<name>/min, avg, max    Rolling statistics, in microseconds
+//   hcbravo/perf/<name>/count            Samples since the counters were enabled
+//   hcbravo/perf/<name>/histogram        Samples per bucket, see perf_counter
+// plus hcbravo/perf/enabled, hcbravo/perf/led/sent and hcbravo/perf/led/skipped
+
+static std::vector<XPLMDataRef> published;
+
+enum class stat : uintptr_t { min, avg, max };
+
+// The refcon of a statistic packs the counter and the statistic
+static inline
+void *
+stat_ref(size_t id, stat which) noexcept
+{
+    return reinterpret_cast<void *>(id * 4 + static_cast<uintptr_t>(which));
+}
+
+static
+float
+read_stat(void * ref) noexcept
+{
+    auto value = reinterpret_cast<uintptr_t>(ref);
+    auto stats = perf::counter(static_cast<perf_id>(value / 4)).read();
+    switch(static_cast<stat>(value % 4)) {
+        case stat::min: return stats.min_;
+        case stat::avg: return stats.avg_;
+        case stat::max: return stats.max_;
+    }
+    return 0.0f;
+}
+
+static
+int
+read_count(void * ref) noexcept
+{
+    return static_cast<int>(perf::counter(static_cast<perf_id>(reinterpret_cast<uintptr_t>(ref))).count());
+}
+
+static
+int
+read_histogram(void * ref, int * values, int offset, int max) noexcept
+{
+    const int size = static_cast<int>(perf_counter::buckets);
+    if(values == nullptr) return size;
+    if(offset < 0 or offset >= size) return 0;
+
+    auto stats = perf::counter(static_cast<perf_id>(reinterpret_cast<uintptr_t>(ref))).read();
+    int count = std::min(max, size - offset);
+    for(int n = 0; n < count; ++n) values[n] = stats.histogram_[offset + n];
+    return count;
+}
+
+static
+int
+read_enabled(void *) noexcept
+{
+    return perf::enabled() ? 1 : 0;
+}
+
+static
+int
+read_sent(void *) noexcept
+{
+    return static_cast<int>(perf::sent_count());
+}
+
+static
+int
+read_skipped(void *) noexcept
+{
+    return static_cast<int>(perf::skipped_count());
+}
+
+static inline
+void
+publish_int(const std::string & name, XPLMGetDatai_f read, void * ref) noexcept
+{
+    published.emplace_back(XPLMRegisterDataAccessor(name.c_str(), xplmType_Int, 0,
+        read, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+        ref, nullptr));
+}
+
+static inline
+void
+publish_float(const std::string & name, XPLMGetDataf_f read, void * ref) noexcept
+{
+    published.emplace_back(XPLMRegisterDataAccessor(name.c_str(), xplmType_Float, 0,
+        nullptr, nullptr, read, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+        ref, nullptr));
+}
+
+void
+perf::publish() noexcept
+{
+    if(published.empty() == false) return;
+
+    logger() << "Publishing Performance Counters";
+    publish_int("hcbravo/perf/enabled", read_enabled, nullptr);
+    publish_int("hcbravo/perf/led/sent", read_sent, nullptr);
+    publish_int("hcbravo/perf/led/skipped", read_skipped, nullptr);
+    for(size_t id = 0; id < std::size(names); ++id) {
+        std::string prefix = std::string("hcbravo/perf/") + names[id] + "/";
+        auto ref = reinterpret_cast<void *>(id);
+        publish_float(prefix + "min", read_stat, stat_ref(id, stat::min));
+        publish_float(prefix + "avg", read_stat, stat_ref(id, stat::avg));
+        publish_float(prefix + "max", read_stat, stat_ref(id, stat::max));
+        publish_int(prefix + "count", read_count, ref);
+        published.emplace_back(XPLMRegisterDataAccessor((prefix + "histogram").c_str(), xplmType_IntArray, 0,
+            nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, read_histogram, nullptr, nullptr, nullptr,
+            nullptr, nullptr, ref, nullptr));
+    }
+}
+
+void
+perf::unpublish() noexcept
+{
+    for(auto data_ref : published) {
+        if(data_ref != nullptr) XPLMUnregisterDataAccessor(data_ref);
+    }
+    published.clear();
+}
+
+#endif
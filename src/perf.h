@@ -0,0 +1,217 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/perf.h
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#ifndef PERF_H_
+#define PERF_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <limits>
+
+#include <cstddef>
+#include <cstdint>
+
+// Rolling statistics of a hot-path measurement, in microseconds.
+//
+// Samples go into a ring holding the latest window of them, which any thread
+// may add to. Statistics are only computed from the ring when read, so adding
+// a sample costs two relaxed atomic operations.
+class perf_counter {
+public:
+    static constexpr size_t window = 256;
+    // Bucket 0 counts samples under 1us, bucket n those under 2^n us, and the
+    // last bucket everything slower
+    static constexpr size_t buckets = 16;
+
+    struct stats {
+        float min_;
+        float avg_;
+        float max_;
+        std::array<int, buckets> histogram_;
+    };
+
+protected:
+    std::array<std::atomic<float>, window> samples_;
+    std::atomic<uint64_t> count_;
+
+public:
+    inline
+    perf_counter() noexcept :
+        count_(0)
+    {}
+
+    inline
+    void
+    add(float value) noexcept {
+        auto n = this->count_.fetch_add(1, std::memory_order_relaxed);
+        this->samples_[n % window].store(value, std::memory_order_relaxed);
+    }
+
+    // Samples since the counter was last reset
+    inline
+    uint64_t
+    count() const noexcept { return this->count_.load(std::memory_order_relaxed); }
+
+    inline
+    void
+    reset() noexcept { this->count_.store(0, std::memory_order_relaxed); }
+
+    static inline
+    size_t
+    bucket(float value) noexcept {
+        size_t n = 0;
+        for(float limit = 1.0f; n < buckets - 1 and value >= limit; limit *= 2.0f) ++n;
+        return n;
+    }
+
+    inline
+    stats
+    read() const noexcept {
+        stats ret{ 0.0f, 0.0f, 0.0f, {} };
+        auto size = static_cast<size_t>(std::min<uint64_t>(this->count(), window));
+        if(size == 0) return ret;
+
+        ret.min_ = std::numeric_limits<float>::max();
+        double sum = 0.0;
+        for(size_t n = 0; n < size; ++n) {
+            auto value = this->samples_[n].load(std::memory_order_relaxed);
+            ret.min_ = std::min(ret.min_, value);
+            ret.max_ = std::max(ret.max_, value);
+            sum += value;
+            ++ret.histogram_[bucket(value)];
+        }
+        ret.avg_ = static_cast<float>(sum / size);
+        return ret;
+    }
+};
+
+enum class perf_id : size_t {
+    flight_loop = 0,    // state::flight_iteration
+    evaluate = 1,       // LED predicate evaluation
+    led_update = 2,     // led_state::update, as seen by the flight loop
+    hid_write = 3,      // Sending an LED report, on whichever thread sends it
+    knob = 4,           // Knob command handlers and HID knob events
+    knob_flush = 5,     // Writing the knob turns into the dials
+    reload = 6,         // Loading the profiles, in the background
+    rebind = 7,         // Binding the active aircraft to the loaded profiles
+    count = 8
+};
+
+// Process-wide performance counters, published as hcbravo/perf/* DataRefs.
+//
+// Built only with HCBRAVO_PERF; otherwise every probe compiles to nothing.
+// When built, probes cost a relaxed load until the counters are enabled.
+class perf {
+protected:
+#if defined(HCBRAVO_PERF)
+    static inline std::atomic<bool> enabled_ = false;
+    static inline perf_counter counters_[static_cast<size_t>(perf_id::count)];
+    static inline std::atomic<uint64_t> sent_ = 0;
+    static inline std::atomic<uint64_t> skipped_ = 0;
+#endif
+
+public:
+    static constexpr const char * names[] = {
+        "flight_loop", "evaluate", "led_update", "hid_write", "knob", "knob_flush", "reload", "rebind"
+    };
+
+#if defined(HCBRAVO_PERF)
+    static inline
+    bool
+    enabled() noexcept { return enabled_.load(std::memory_order_relaxed); }
+
+    // Enabling starts every counter over
+    static inline
+    void
+    enable(bool enable) noexcept {
+        if(enable) {
+            for(auto & counter : counters_) counter.reset();
+            sent_.store(0, std::memory_order_relaxed);
+            skipped_.store(0, std::memory_order_relaxed);
+        }
+        enabled_.store(enable, std::memory_order_relaxed);
+    }
+
+    static inline
+    perf_counter &
+    counter(perf_id id) noexcept { return counters_[static_cast<size_t>(id)]; }
+
+    // LED updates that sent a report, and those skipped because no LED changed
+    static inline
+    void
+    sent() noexcept { if(enabled()) sent_.fetch_add(1, std::memory_order_relaxed); }
+
+    static inline
+    void
+    skipped() noexcept { if(enabled()) skipped_.fetch_add(1, std::memory_order_relaxed); }
+
+    static inline
+    uint64_t
+    sent_count() noexcept { return sent_.load(std::memory_order_relaxed); }
+
+    static inline
+    uint64_t
+    skipped_count() noexcept { return skipped_.load(std::memory_order_relaxed); }
+
+    // Registers and removes the DataRefs; sim thread only
+    static
+    void
+    publish() noexcept;
+
+    static
+    void
+    unpublish() noexcept;
+#else
+    static constexpr
+    bool
+    enabled() noexcept { return false; }
+
+    static inline void enable(bool) noexcept {}
+    static inline void sent() noexcept {}
+    static inline void skipped() noexcept {}
+    static inline void publish() noexcept {}
+    static inline void unpublish() noexcept {}
+#endif
+};
+
+static_assert(std::size(perf::names) == static_cast<size_t>(perf_id::count));
+
+// Adds the time until it goes out of scope to a counter, while counters are enabled
+class perf_timer {
+#if defined(HCBRAVO_PERF)
+protected:
+    perf_counter * counter_;
+    std::chrono::steady_clock::time_point start_;
+
+public:
+    inline
+    explicit perf_timer(perf_id id) noexcept :
+        counter_(perf::enabled() ? &perf::counter(id) : nullptr)
+    {
+        if(this->counter_ != nullptr) this->start_ = std::chrono::steady_clock::now();
+    }
+
+    inline
+    ~perf_timer() noexcept {
+        if(this->counter_ == nullptr) return;
+        auto elapsed = std::chrono::steady_clock::now() - this->start_;
+        this->counter_->add(std::chrono::duration<float, std::micro>(elapsed).count());
+    }
+#else
+public:
+    inline
+    explicit perf_timer(perf_id) noexcept {}
+#endif
+
+    perf_timer(const perf_timer &) = delete;
+    perf_timer & operator=(const perf_timer &) = delete;
+};
+
+#endif
@@ -0,0 +1,245 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/predicate.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#include "logger.h"
+#include "predicate.h"
+#include "profile.h"
+
+#include <algorithm>
+
+predicate_table::predicate_table() noexcept :
+    power_end_(0),
+    power_fetches_(0)
+{
+    // The power gate is always the first group
+    this->add_group();
+}
+
+predicate_table::group_type
+predicate_table::add_group() noexcept
+{
+    this->seeds_.emplace_back(0);
+    this->results_.emplace_back(0);
+    return static_cast<group_type>(this->seeds_.size() - 1);
+}
+
+void
+predicate_table::add(group_type group, XPLMDataRef data_ref, tag type, std::optional<size_t> index,
+    bool invert, uint32_t offset, uint32_t count) noexcept
+{
+    if(data_ref == nullptr) {
+        // Missing Bool and Int DataRefs are never set, while missing Float DataRefs
+        // read as 0.0f, so we fold them into the initial value of the group
+        if(type == tag::real) {
+            this->seeds_[group] |= matches(0.0f, this->float_values_.data() + offset, count) != invert;
+        }
+        return;
+    }
+
+    auto element = index ? static_cast<int>(index.value()) : -1;
+    auto fetch = this->plan(data_ref, type, element);
+
+    // Power predicates must be added before any other predicate, so their reads
+    // are done first and an unpowered aircraft does not pay for the rest
+    if(group == power_group and this->power_end_ == this->data_refs_.size()) {
+        ++this->power_end_;
+        this->power_fetches_ = this->fetch_data_refs_.size();
+    }
+
+    this->data_refs_.emplace_back(data_ref);
+    this->tags_.emplace_back(type);
+    this->indexes_.emplace_back(element);
+    this->inverts_.emplace_back(invert);
+    this->values_offset_.emplace_back(offset);
+    this->values_count_.emplace_back(count);
+    this->groups_.emplace_back(group);
+    this->fetches_.emplace_back(fetch);
+}
+
+uint32_t
+predicate_table::plan(XPLMDataRef data_ref, tag type, int index) noexcept
+{
+    // Booleans and integers are both read as integers
+    auto is_real = type == tag::real;
+    uint32_t fetch = 0;
+    for(; fetch < this->fetch_data_refs_.size(); ++fetch) {
+        if(this->fetch_data_refs_[fetch] != data_ref) continue;
+        if((this->fetch_tags_[fetch] == tag::real) != is_real) continue;
+        if((this->fetch_first_[fetch] < 0) != (index < 0)) continue;
+        if(index < 0) break;
+
+        auto first = std::min(this->fetch_first_[fetch], index);
+        auto last = std::max(this->fetch_first_[fetch] + this->fetch_count_[fetch], index + 1);
+        if(last - first > max_fetch_span) continue;
+        this->fetch_first_[fetch] = first;
+        this->fetch_count_[fetch] = last - first;
+        break;
+    }
+    if(fetch == this->fetch_data_refs_.size()) {
+        this->fetch_data_refs_.emplace_back(data_ref);
+        this->fetch_tags_.emplace_back(type);
+        this->fetch_first_.emplace_back(index);
+        this->fetch_count_.emplace_back(1);
+        this->fetch_offset_.emplace_back(0);
+    }
+
+    // Ranges might have grown, so lay the scratch buffers out again
+    uint32_t int_size = 0;
+    uint32_t float_size = 0;
+    for(uint32_t n = 0; n < this->fetch_data_refs_.size(); ++n) {
+        auto & size = (this->fetch_tags_[n] == tag::real) ? float_size : int_size;
+        this->fetch_offset_[n] = size;
+        size += this->fetch_count_[n];
+    }
+    this->int_scratch_.resize(int_size);
+    this->float_scratch_.resize(float_size);
+
+    return fetch;
+}
+
+void
+predicate_table::fetch(size_t begin, size_t end) const noexcept
+{
+    for(size_t n = begin; n < end; ++n) {
+        const auto & data_ref = this->fetch_data_refs_[n];
+        const auto first = this->fetch_first_[n];
+        if(this->fetch_tags_[n] == tag::real) {
+            auto * out = this->float_scratch_.data() + this->fetch_offset_[n];
+            if(first < 0) *out = XPLMGetDataf(data_ref);
+            else XPLMGetDatavf(data_ref, out, first, this->fetch_count_[n]);
+        }
+        else {
+            auto * out = this->int_scratch_.data() + this->fetch_offset_[n];
+            if(first < 0) *out = XPLMGetDatai(data_ref);
+            else XPLMGetDatavi(data_ref, out, first, this->fetch_count_[n]);
+        }
+    }
+}
+
+void
+predicate_table::add(group_type group, XPLMDataRef data_ref, std::optional<size_t> index, bool invert) noexcept
+{
+    this->add(group, data_ref, tag::boolean, index, invert, 0, 0);
+}
+
+void
+predicate_table::add(group_type group, XPLMDataRef data_ref, std::optional<size_t> index, bool invert,
+    const std::vector<int> & values) noexcept
+{
+    auto offset = static_cast<uint32_t>(this->int_values_.size());
+    this->int_values_.insert(this->int_values_.end(), values.begin(), values.end());
+    this->add(group, data_ref, tag::integer, index, invert, offset, static_cast<uint32_t>(values.size()));
+}
+
+void
+predicate_table::add(group_type group, XPLMDataRef data_ref, std::optional<size_t> index, bool invert,
+    const std::vector<float> & values) noexcept
+{
+    auto offset = static_cast<uint32_t>(this->float_values_.size());
+    this->float_values_.insert(this->float_values_.end(), values.begin(), values.end());
+    this->add(group, data_ref, tag::real, index, invert, offset, static_cast<uint32_t>(values.size()));
+}
+
+void
+predicate_table::add_output(group_type group, const led_id & led, bool invert) noexcept
+{
+    this->output_groups_.emplace_back(group);
+    this->output_banks_.emplace_back(std::get<0>(led));
+    this->output_bits_.emplace_back(std::get<1>(led));
+    this->output_inverts_.emplace_back(invert);
+}
+
+bool
+predicate_table::evaluate(led_mask & mask) const noexcept
+{
+    auto & results = this->results_;
+    ::memcpy(results.data(), this->seeds_.data(), results.size());
+
+    this->fetch(0, this->power_fetches_);
+    size_t n = 0;
+    for(; n < this->power_end_; ++n) {
+        results[power_group] |= this->test(n);
+    }
+    if(results[power_group] == 0) return false;
+
+    this->fetch(this->power_fetches_, this->fetch_data_refs_.size());
+    for(; n < this->data_refs_.size(); ++n) {
+        results[this->groups_[n]] |= this->test(n);
+    }
+
+    for(size_t o = 0; o < this->output_groups_.size(); ++o) {
+        mask.set(this->output_banks_[o], this->output_bits_[o],
+            results[this->output_groups_[o]] != this->output_inverts_[o]);
+    }
+    return true;
+}
+
+static inline
+void
+compile_output(predicate_table & table, const std::optional<value_data_ref> & value, const led_id & led) noexcept
+{
+    if(!value) return;
+    auto group = table.add_group();
+    value.value().compile(table, group);
+    table.add_output(group, led);
+}
+
+predicate_table
+predicate_table::build(const profile & profile) noexcept
+{
+    predicate_table table;
+
+    const auto & system = profile.system();
+    system.volts_.compile(table, power_group);
+
+    if(profile.autopilot()) {
+        const auto & ap = profile.autopilot().value().mode();
+        compile_output(table, ap.hdg_, LED_AP_HDG);
+        compile_output(table, ap.nav_, LED_AP_NAV);
+        compile_output(table, ap.apr_, LED_AP_APR);
+        compile_output(table, ap.rev_, LED_AP_REV);
+        compile_output(table, ap.alt_, LED_AP_ALT);
+        compile_output(table, ap.vs_, LED_AP_VS);
+        compile_output(table, ap.ias_, LED_AP_IAS);
+
+        auto group = table.add_group();
+        ap.ap_.compile(table, group);
+        table.add_output(group, LED_AP);
+    }
+
+    if(system.gear_) {
+        auto group = table.add_group();
+        system.gear_.value().compile(table, group);
+        table.add_output(group, LED_LDG_L_GREEN);
+        table.add_output(group, LED_LDG_L_RED, true);
+        table.add_output(group, LED_LDG_N_GREEN);
+        table.add_output(group, LED_LDG_N_RED, true);
+        table.add_output(group, LED_LDG_R_GREEN);
+        table.add_output(group, LED_LDG_R_RED, true);
+    }
+
+    if(profile.annunciator()) {
+        const auto & ann = profile.annunciator().value();
+        compile_output(table, ann.master_warn_, LED_ANC_MSTR_WARN);
+        compile_output(table, ann.eng_fire_, LED_ANC_ENG_FIRE);
+        compile_output(table, ann.oil_low_, LED_ANC_OIL);
+        compile_output(table, ann.fuel_low_, LED_ANC_FUEL);
+        compile_output(table, ann.anti_ice_, LED_ANC_ANTI_ICE);
+        compile_output(table, ann.starter_, LED_ANC_STARTER);
+        compile_output(table, ann.apu_, LED_ANC_APU);
+        compile_output(table, ann.master_caution_, LED_ANC_MSTR_CTN);
+        compile_output(table, ann.vacuum_low_, LED_ANC_VACUUM);
+        compile_output(table, ann.hydro_low_, LED_ANC_HYD);
+        compile_output(table, ann.aux_fuel_, LED_ANC_AUX_FUEL);
+        compile_output(table, ann.parking_brake_, LED_ANC_PRK_BRK);
+        compile_output(table, ann.volt_low_, LED_ANC_VOLTS);
+        compile_output(table, ann.door_open_, LED_ANC_DOOR);
+    }
+
+    logger() << "Compiled " << table.size() << " predicate(s) into " << table.groups() << " group(s)";
+    return table;
+}
\ No newline at end of file
@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/predicate.h
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#ifndef PREDICATE_H_
+#define PREDICATE_H_
+
+#include "led-mask.h"
+
+#include <XPLM/XPLMDataAccess.h>
+
+#include <optional>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+class profile;
+
+// Flat, struct-of-arrays representation of every LED predicate in a profile.
+//
+// Predicates are grouped: a group is true when any of its predicates is set
+// (the same semantics as value_data_ref). Outputs map group results onto LED
+// bits. Group 0 is always the system power gate.
+class predicate_table {
+public:
+    using group_type = uint32_t;
+
+    enum class tag : uint8_t {
+        boolean,
+        integer,
+        real
+    };
+
+    static const group_type power_group = 0;
+
+protected:
+    // Per-predicate data
+    std::vector<XPLMDataRef> data_refs_;
+    std::vector<tag> tags_;
+    std::vector<int> indexes_;
+    std::vector<uint8_t> inverts_;
+    std::vector<uint32_t> values_offset_;
+    std::vector<uint32_t> values_count_;
+    std::vector<group_type> groups_;
+    std::vector<uint32_t> fetches_;
+
+    // Value sets referenced by integer and float predicates
+    std::vector<int> int_values_;
+    std::vector<float> float_values_;
+
+    // Read plan: every DataRef is fetched once per tick into the scratch
+    // buffers, shared by all its predicates. Arrays are fetched with a single
+    // ranged read, scalars are marked with a negative first element
+    std::vector<XPLMDataRef> fetch_data_refs_;
+    std::vector<tag> fetch_tags_;
+    std::vector<int> fetch_first_;
+    std::vector<int> fetch_count_;
+    std::vector<uint32_t> fetch_offset_;
+    mutable std::vector<int> int_scratch_;
+    mutable std::vector<float> float_scratch_;
+
+    // Per-group data
+    std::vector<uint8_t> seeds_;
+    mutable std::vector<uint8_t> results_;
+
+    // Per-output data
+    std::vector<group_type> output_groups_;
+    std::vector<uint8_t> output_banks_;
+    std::vector<uint8_t> output_bits_;
+    std::vector<uint8_t> output_inverts_;
+
+    // Number of predicates and reads belonging to the power group
+    size_t power_end_;
+    size_t power_fetches_;
+
+    // Largest range of array elements covered by a single read
+    static const int max_fetch_span = 64;
+
+    template<typename T>
+    static inline
+    bool
+    matches(T value, const T * values, uint32_t count) noexcept {
+        // If not specific values are specified, we compare against 0
+        bool found = count == 0 && value != T(0);
+        for(uint32_t n = 0; n < count; ++n) found |= values[n] == value;
+        return found;
+    }
+
+    template<typename T>
+    inline
+    T
+    read(size_t n, const std::vector<T> & scratch) const noexcept {
+        const auto fetch = this->fetches_[n];
+        return scratch[this->fetch_offset_[fetch] + (this->indexes_[n] - this->fetch_first_[fetch])];
+    }
+
+    inline
+    bool
+    test(size_t n) const noexcept {
+        bool set;
+        if(this->tags_[n] == tag::real) {
+            set = matches(this->read(n, this->float_scratch_),
+                this->float_values_.data() + this->values_offset_[n], this->values_count_[n]);
+        }
+        else {
+            set = matches(this->read(n, this->int_scratch_),
+                this->int_values_.data() + this->values_offset_[n], this->values_count_[n]);
+        }
+        return set != static_cast<bool>(this->inverts_[n]);
+    }
+
+    uint32_t
+    plan(XPLMDataRef data_ref, tag type, int index) noexcept;
+
+    void
+    fetch(size_t begin, size_t end) const noexcept;
+
+    void
+    add(group_type group, XPLMDataRef data_ref, tag type, std::optional<size_t> index,
+        bool invert, uint32_t offset, uint32_t count) noexcept;
+
+public:
+    predicate_table() noexcept;
+
+    predicate_table(predicate_table && other) noexcept = default;
+
+    predicate_table &
+    operator=(predicate_table && other) noexcept = default;
+
+    static
+    predicate_table
+    build(const profile & profile) noexcept;
+
+    group_type
+    add_group() noexcept;
+
+    void
+    add(group_type group, XPLMDataRef data_ref, std::optional<size_t> index, bool invert) noexcept;
+
+    void
+    add(group_type group, XPLMDataRef data_ref, std::optional<size_t> index, bool invert,
+        const std::vector<int> & values) noexcept;
+
+    void
+    add(group_type group, XPLMDataRef data_ref, std::optional<size_t> index, bool invert,
+        const std::vector<float> & values) noexcept;
+
+    void
+    add_output(group_type group, const led_id & led, bool invert = false) noexcept;
+
+    // Evaluates every predicate and writes the resulting LEDs into the mask.
+    // Returns false, leaving the mask untouched, when the power gate is not set.
+    bool
+    evaluate(led_mask & mask) const noexcept;
+
+    inline
+    size_t
+    size() const noexcept { return this->data_refs_.size(); }
+
+    inline
+    size_t
+    groups() const noexcept { return this->seeds_.size(); }
+
+    inline
+    size_t
+    reads() const noexcept { return this->fetch_data_refs_.size(); }
+};
+
+#endif
\ No newline at end of file
@@ -22,117 +22,125 @@ class data_ref;
 
 template<typename T>
 std::expected<T, int>
-base_data_ref::build(const YAML::Node & node) noexcept
+base_data_ref::build(const YAML::Node & node, data_ref_table & table) noexcept
 {
-    XPLMDataRef data_ref = nullptr;
+    std::string key;
     bool invert = false;
     std::optional<size_t> index = std::nullopt;
 
-    if(node.IsMap()) {
-        data_ref = XPLMFindDataRef(node["key"].as<std::string>().c_str());
-        if(node["invert"]) invert = node["invert"].as<bool>();
-        if(node["index"]) index = node["index"].as<size_t>();
-    }
-    else if(node.IsScalar()) {
-        data_ref = XPLMFindDataRef(node.as<std::string>().c_str());
+    try {
+        if(node.IsMap()) {
+            key = node["key"].as<std::string>();
+            if(node["invert"]) invert = node["invert"].as<bool>();
+            if(node["index"]) index = node["index"].as<size_t>();
+        }
+        else if(node.IsScalar()) {
+            key = node.as<std::string>();
+        }
+        else {
+            log_warn() << "Invalid DataRef node '" << node << "'";
+            return std::unexpected(0);
+        }
     }
-    else {
-        logger() << "Invalid DataRef node '" << node << "'";
+    catch(const YAML::Exception & e) {
+        log_warn() << "Invalid DataRef node '" << node << "'";
         return std::unexpected(0);
     }
 
-    XPLMDataRefInfo_t info;
-    info.structSize = sizeof(info);
-    XPLMGetDataRefInfo(data_ref, &info);
-    switch(info.type) {
-        case xplmType_IntArray:
-        case xplmType_FloatArray:
-            if(!index) {
-                logger() << "Detected Array DataRef '" << info.name << "', but no index was provided. Assuming index 0";
-                index = static_cast<size_t>(0);
-            }
-            break;
-        default:
-            if(index) {
-                logger() << "Detected Scalar DataRef '" << info.name << "', but an index was provided. Ignoring provided index";
-                index = std::nullopt;
-            }
-            break;
-    }
-
-    return T(std::move(data_ref), invert, index);
-
+    // Whether the index applies is decided when the table is resolved
+    auto id = table.intern(key, index.has_value());
+    return T(table, id, invert, index);
 }
 
 template<>
-class data_ref<bool> : public bool_data_ref {
+class data_ref<bool> : public base_data_ref {
 protected:
     inline
-    data_ref(XPLMDataRef && data_ref, bool invert,
+    data_ref(const data_ref_table & table, data_ref_table::key_type key, bool invert,
             std::optional<size_t> index) noexcept :
-        bool_data_ref(std::move(data_ref), invert, index)
+        base_data_ref(table, key, invert, index)
     {}
 
     friend class base_data_ref;
+    friend class profile_image;
 public:
     data_ref(data_ref && other) noexcept = default;
 
+    data_ref &
+    operator=(data_ref && other) noexcept = default;
+
     static inline
     std::expected<data_ref, int>
-    build(const YAML::Node & node) noexcept {
-        return base_data_ref::build<data_ref>(node);
+    build(const YAML::Node & node, data_ref_table & table) noexcept {
+        return base_data_ref::build<data_ref>(node, table);
     }
 
-    bool is_set() const noexcept final {
-        if(this->data_ref_ == nullptr) return false;
+    bool is_set() const noexcept {
+        auto handle = this->handle();
+        if(handle == nullptr) return false;
         int value = 0;
-        if(this->index_) {
-            XPLMGetDatavi(this->data_ref_, &value, this->index_.value(), 1);
+        auto index = this->index();
+        if(index) {
+            XPLMGetDatavi(handle, &value, index.value(), 1);
         }
-        else { 
-            value = XPLMGetDatai(this->data_ref_);
+        else {
+            value = XPLMGetDatai(handle);
         }
         return this->invert_ ? value == 0 : value != 0;
     }
+
+    void compile(predicate_table & table, predicate_table::group_type group) const noexcept {
+        table.add(group, this->handle(), this->index(), this->invert_);
+    }
 };
 
 template<>
-class data_ref<int> : public bool_data_ref {
+class data_ref<int> : public base_data_ref {
 protected:
     std::vector<int> values_;
 
     inline
-    data_ref(XPLMDataRef && data_ref, bool invert,
+    data_ref(const data_ref_table & table, data_ref_table::key_type key, bool invert,
             std::optional<size_t> index) noexcept :
-        bool_data_ref(std::move(data_ref), invert, index)
+        base_data_ref(table, key, invert, index)
     {}
 
     friend class base_data_ref;
+    friend class profile_image;
 public:
     data_ref(data_ref && other) noexcept = default;
 
+    data_ref &
+    operator=(data_ref && other) noexcept = default;
+
     static inline
     std::expected<data_ref, int>
-    build(const YAML::Node & node) noexcept {
-        auto ret = base_data_ref::build<data_ref>(node);
-        if(ret.has_value()) {
-            if(node.IsMap()) {
+    build(const YAML::Node & node, data_ref_table & table) noexcept {
+        auto ret = base_data_ref::build<data_ref>(node, table);
+        if(ret.has_value() and node.IsMap()) {
+            try {
                 for(const auto v : node["values"]) {
                     ret.value().values_.emplace_back(v.as<int>());
                 }
             }
+            catch(const YAML::Exception & e) {
+                log_warn() << "Invalid DataRef values '" << node["values"] << "'";
+                return std::unexpected(0);
+            }
         }
         return ret;
     }
 
-    bool is_set() const noexcept final {
-        if(this->data_ref_ == nullptr) return false;
+    bool is_set() const noexcept {
+        auto handle = this->handle();
+        if(handle == nullptr) return false;
         int value = 0;
-        if(this->index_) {
-            XPLMGetDatavi(this->data_ref_, &value, this->index_.value(), 1);
+        auto index = this->index();
+        if(index) {
+            XPLMGetDatavi(handle, &value, index.value(), 1);
         }
-        else { 
-            value = XPLMGetDatai(this->data_ref_);
+        else {
+            value = XPLMGetDatai(handle);
         }
         // If not specific values are specified, we compare against 0
         if(this->values_.empty()) {
@@ -144,34 +152,43 @@ public:
         }
         return this->invert_ ? true : false;
     }
+
+    void compile(predicate_table & table, predicate_table::group_type group) const noexcept {
+        table.add(group, this->handle(), this->index(), this->invert_, this->values_);
+    }
 };
 
 template<>
-class data_ref<float> : public bool_data_ref {
+class data_ref<float> : public base_data_ref {
 protected:
     std::vector<float> values_;
 
     inline
-    data_ref(XPLMDataRef && data_ref, bool invert,
+    data_ref(const data_ref_table & table, data_ref_table::key_type key, bool invert,
             std::optional<size_t> index) noexcept :
-        bool_data_ref(std::move(data_ref), invert, index)
+        base_data_ref(table, key, invert, index)
     {}
 
     friend class base_data_ref;
+    friend class profile_image;
 public:
     inline
     data_ref(data_ref && other) noexcept = default;
 
     static inline
     std::expected<data_ref, int>
-    build(const YAML::Node & node) noexcept {
-        auto ret = base_data_ref::build<data_ref>(node);
-        if(ret.has_value()) {
-            if(node.IsMap()) {
+    build(const YAML::Node & node, data_ref_table & table) noexcept {
+        auto ret = base_data_ref::build<data_ref>(node, table);
+        if(ret.has_value() and node.IsMap()) {
+            try {
                 for(const auto v : node["values"]) {
                     ret.value().values_.emplace_back(v.as<float>());
                 }
             }
+            catch(const YAML::Exception & e) {
+                log_warn() << "Invalid DataRef values '" << node["values"] << "'";
+                return std::unexpected(0);
+            }
         }
         return ret;
     }
@@ -180,10 +197,10 @@ public:
     operator=(data_ref && other) noexcept = default;
 
     inline
-    bool is_set() const noexcept final {
+    bool is_set() const noexcept {
         float value = this->get();
         if(this->values_.empty()) {
-            return this->invert_ ? this->get() == 0.0f : this->get() != 0.0f;
+            return this->invert_ ? value == 0.0f : value != 0.0f;
         }
         // When values are specified, we compare against the targets
         for(const auto & v : this->values_) {
@@ -192,28 +209,35 @@ public:
         return this->invert_ ? true : false;
     }
 
+    void compile(predicate_table & table, predicate_table::group_type group) const noexcept {
+        table.add(group, this->handle(), this->index(), this->invert_, this->values_);
+    }
+
     inline
     float get() const noexcept {
-        if(this->data_ref_ == nullptr) return 0.0f;
-        if(this->index_) {
+        auto handle = this->handle();
+        if(handle == nullptr) return 0.0f;
+        auto index = this->index();
+        if(index) {
             float ret;
-            XPLMGetDatavf(this->data_ref_, &ret,
-                this->index_.value(), 1);
+            XPLMGetDatavf(handle, &ret,
+                index.value(), 1);
             return ret;
         }
-        return XPLMGetDataf(this->data_ref_);
+        return XPLMGetDataf(handle);
     }
 
     inline
     void set(float value) const noexcept {
-        if(this->data_ref_ == nullptr) return;
-        if(this->index_) {
-            logger() << "Setting " << value << " @ " << this->index_.value();
-            XPLMSetDatavf(this->data_ref_, &value,
-                this->index_.value(), 1);
+        auto handle = this->handle();
+        if(handle == nullptr) return;
+        auto index = this->index();
+        if(index) {
+            XPLMSetDatavf(handle, &value,
+                index.value(), 1);
         }
         else {
-            XPLMSetDataf(this->data_ref_, value);
+            XPLMSetDataf(handle, value);
         }
     }
 };
@@ -0,0 +1,688 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/profile-image.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#include "logger.h"
+#include "profile-image.h"
+
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#if defined(IBM)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(std::endian::native == std::endian::little, "Profile images are little-endian");
+static_assert(sizeof(profile_image::image_header) % 4 == 0);
+static_assert(sizeof(profile_image::image_predicate) == 20);
+static_assert(sizeof(profile_image::image_slot) == 12);
+static_assert(sizeof(profile_image::image_dial) == 12);
+static_assert(sizeof(profile_image::image_curve) == 12);
+static_assert(sizeof(profile_image::image_stage) == 8);
+
+// Read-only mapping of a whole file
+class mapped_file {
+protected:
+    const uint8_t * data_;
+    size_t size_;
+#if defined(IBM)
+    HANDLE file_;
+    HANDLE mapping_;
+#endif
+
+public:
+    inline
+    mapped_file() noexcept :
+        data_(nullptr),
+        size_(0)
+#if defined(IBM)
+        , file_(INVALID_HANDLE_VALUE),
+        mapping_(nullptr)
+#endif
+    {}
+
+    mapped_file(const mapped_file &) = delete;
+
+    mapped_file &
+    operator=(const mapped_file &) = delete;
+
+    inline
+    ~mapped_file() noexcept {
+#if defined(IBM)
+        if(this->data_ != nullptr) UnmapViewOfFile(this->data_);
+        if(this->mapping_ != nullptr) CloseHandle(this->mapping_);
+        if(this->file_ != INVALID_HANDLE_VALUE) CloseHandle(this->file_);
+#else
+        if(this->data_ != nullptr) munmap(const_cast<uint8_t *>(this->data_), this->size_);
+#endif
+    }
+
+    bool
+    open(const std::filesystem::path & path) noexcept {
+#if defined(IBM)
+        this->file_ = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(this->file_ == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        if(GetFileSizeEx(this->file_, &size) == FALSE or size.QuadPart == 0) return false;
+        this->mapping_ = CreateFileMappingW(this->file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(this->mapping_ == nullptr) return false;
+        auto * data = MapViewOfFile(this->mapping_, FILE_MAP_READ, 0, 0, 0);
+        if(data == nullptr) return false;
+        this->size_ = static_cast<size_t>(size.QuadPart);
+        this->data_ = static_cast<const uint8_t *>(data);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) return false;
+        struct stat info;
+        if(fstat(fd, &info) != 0 or info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        auto * data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        // The mapping stays valid after the descriptor is closed
+        ::close(fd);
+        if(data == MAP_FAILED) return false;
+        this->size_ = static_cast<size_t>(info.st_size);
+        this->data_ = static_cast<const uint8_t *>(data);
+#endif
+        return true;
+    }
+
+    inline
+    const uint8_t *
+    data() const noexcept { return this->data_; }
+
+    inline
+    size_t
+    size() const noexcept { return this->size_; }
+};
+
+std::filesystem::path
+profile_image::path_for(const std::filesystem::path & yaml) noexcept
+{
+    auto ret = yaml;
+    ret.replace_extension(extension);
+    return ret;
+}
+
+bool
+profile_image::is_fresh(const std::filesystem::path & yaml) noexcept
+{
+    std::error_code err;
+    auto image_time = std::filesystem::last_write_time(path_for(yaml), err);
+    if(err) return false;
+    auto yaml_time = std::filesystem::last_write_time(yaml, err);
+    if(err) return false;
+    return image_time >= yaml_time;
+}
+
+class profile_image::writer {
+protected:
+    const data_ref_table & table_;
+    std::vector<std::string> strings_;
+    std::unordered_map<std::string, uint32_t> string_ids_;
+    std::vector<image_predicate> predicates_;
+    std::vector<uint32_t> values_;
+    std::vector<image_slot> slots_;
+    std::vector<image_dial> dials_;
+    std::vector<image_curve> curves_;
+    std::vector<image_stage> stages_;
+
+    template<typename T>
+    static inline
+    void
+    append(std::vector<uint8_t> & buffer, uint32_t & offset, const std::vector<T> & data) noexcept {
+        // Every section starts at a four byte boundary
+        buffer.resize((buffer.size() + 3) & ~size_t(3));
+        offset = static_cast<uint32_t>(buffer.size());
+        auto bytes = data.size() * sizeof(T);
+        buffer.resize(buffer.size() + bytes);
+        if(bytes > 0) std::memcpy(buffer.data() + offset, data.data(), bytes);
+    }
+
+    template<typename T>
+    uint32_t
+    values(image_predicate & record, const std::vector<T> & values) noexcept {
+        record.value_first = static_cast<uint32_t>(this->values_.size());
+        record.value_count = static_cast<uint32_t>(values.size());
+        for(const auto & value : values) this->values_.emplace_back(std::bit_cast<uint32_t>(value));
+        return record.value_count;
+    }
+
+public:
+    inline
+    writer(const data_ref_table & table) noexcept :
+        table_(table)
+    {}
+
+    uint32_t
+    string(const std::string & value) noexcept {
+        auto ret = this->string_ids_.emplace(value, static_cast<uint32_t>(this->strings_.size()));
+        if(ret.second) this->strings_.emplace_back(value);
+        return ret.first->second;
+    }
+
+    template<typename T>
+    uint32_t
+    predicate(const ::data_ref<T> & data_ref) noexcept {
+        image_predicate record{};
+        record.key = this->string(this->table_.key(data_ref.key_));
+        record.invert = data_ref.invert_ ? 1 : 0;
+        record.has_index = data_ref.index_ ? 1 : 0;
+        record.index = static_cast<uint32_t>(data_ref.index_.value_or(0));
+
+        if constexpr(std::is_same_v<T, int>) {
+            record.type = value_type::integer;
+            this->values(record, data_ref.values_);
+        }
+        else if constexpr(std::is_same_v<T, float>) {
+            record.type = value_type::real;
+            this->values(record, data_ref.values_);
+        }
+        else {
+            record.type = value_type::boolean;
+        }
+        this->predicates_.emplace_back(record);
+        return static_cast<uint32_t>(this->predicates_.size() - 1);
+    }
+
+    inline
+    uint32_t
+    predicate(const bool_data_ref & data_ref) noexcept {
+        return std::visit([this](const auto & data) { return this->predicate(data); }, data_ref.data_);
+    }
+
+    void
+    add_slot(slot id, const value_data_ref & value) noexcept {
+        image_slot record{};
+        record.id = id;
+        record.first = static_cast<uint32_t>(this->predicates_.size());
+        for(const auto & data : value.data_) this->predicate(data);
+        record.count = static_cast<uint32_t>(this->predicates_.size()) - record.first;
+        this->slots_.emplace_back(record);
+    }
+
+    inline
+    void
+    add_slot(slot id, const std::optional<value_data_ref> & value) noexcept {
+        if(value) this->add_slot(id, value.value());
+    }
+
+    void
+    add_dial(dial id, const float_data_ref & value, uint32_t is_mach = no_string) noexcept {
+        image_dial record{};
+        record.id = id;
+        record.is_mach = is_mach;
+        record.predicate = this->predicate(value);
+        this->dials_.emplace_back(record);
+    }
+
+    inline
+    void
+    add_dial(dial id, const std::optional<float_data_ref> & value) noexcept {
+        if(value) this->add_dial(id, value.value());
+    }
+
+    void
+    add_curve(size_t knob, const acceleration_curve & curve) noexcept {
+        image_curve record{};
+        record.knob = static_cast<uint16_t>(knob);
+        record.first = static_cast<uint32_t>(this->stages_.size());
+        for(const auto & stage : curve.stages_) this->stages_.emplace_back(image_stage{ stage.rate_, stage.step_ });
+        record.count = static_cast<uint32_t>(this->stages_.size()) - record.first;
+        this->curves_.emplace_back(record);
+    }
+
+    std::vector<uint8_t>
+    serialize(const image_header & base, const std::vector<uint32_t> & aircrafts,
+            const std::vector<uint32_t> & models) const noexcept {
+        std::vector<uint8_t> buffer(sizeof(image_header));
+        auto header = base;
+
+        std::vector<uint32_t> offsets;
+        std::vector<char> data;
+        for(const auto & str : this->strings_) {
+            offsets.emplace_back(static_cast<uint32_t>(data.size()));
+            data.insert(data.end(), str.begin(), str.end());
+            data.emplace_back('\0');
+        }
+        header.string_count = static_cast<uint32_t>(offsets.size());
+        append(buffer, header.string_offsets, offsets);
+        header.string_size = static_cast<uint32_t>(data.size());
+        append(buffer, header.string_data, data);
+        header.aircraft_count = static_cast<uint32_t>(aircrafts.size());
+        append(buffer, header.aircrafts, aircrafts);
+        header.model_count = static_cast<uint32_t>(models.size());
+        append(buffer, header.models, models);
+        header.predicate_count = static_cast<uint32_t>(this->predicates_.size());
+        append(buffer, header.predicates, this->predicates_);
+        header.value_count = static_cast<uint32_t>(this->values_.size());
+        append(buffer, header.values, this->values_);
+        header.slot_count = static_cast<uint32_t>(this->slots_.size());
+        append(buffer, header.slots, this->slots_);
+        header.dial_count = static_cast<uint32_t>(this->dials_.size());
+        append(buffer, header.dials, this->dials_);
+        header.curve_count = static_cast<uint32_t>(this->curves_.size());
+        append(buffer, header.curves, this->curves_);
+        header.stage_count = static_cast<uint32_t>(this->stages_.size());
+        append(buffer, header.stages, this->stages_);
+
+        header.size = static_cast<uint32_t>(buffer.size());
+        std::memcpy(buffer.data(), &header, sizeof(header));
+        return buffer;
+    }
+};
+
+std::expected<void, int>
+profile_image::write(const profile & profile, const std::filesystem::path & path) noexcept
+{
+    writer out(*profile.data_refs_);
+    image_header header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.name = out.string(profile.name());
+    header.base = profile.base_ ? out.string(profile.extends_) : no_string;
+    header.priority = profile.header_.priority();
+    std::vector<uint32_t> aircrafts;
+    for(const auto & aircraft : profile.aircrafts()) aircrafts.emplace_back(out.string(aircraft));
+    std::vector<uint32_t> models;
+    for(const auto & model : profile.models()) models.emplace_back(out.string(model));
+    if(profile.refresh_) {
+        header.flags |= has_refresh;
+        const auto & refresh = profile.refresh_.value();
+        header.refresh_interval = refresh.interval_;
+        header.refresh_max = refresh.max_;
+        header.refresh_unpowered = refresh.unpowered_;
+    }
+    if(profile.knobs_) {
+        header.flags |= has_knobs;
+        const auto & knobs = profile.knobs_.value();
+        header.knob_window = knobs.window_;
+        for(size_t n = 0; n < knob_config::count; ++n) {
+            if(knobs.curves_[n]) out.add_curve(n, knobs.curves_[n].value());
+        }
+    }
+
+    if(profile.system_) {
+        header.flags |= has_system;
+        const auto & system = profile.system_.value();
+        out.add_slot(slot::volts, system.volts_);
+        out.add_slot(slot::gear, system.gear_);
+    }
+
+    if(profile.autopilot_) {
+        header.flags |= has_autopilot;
+        const auto & ap = profile.autopilot_.value();
+        const auto & mode = ap.mode_;
+        out.add_slot(slot::ap_hdg, mode.hdg_);
+        out.add_slot(slot::ap_nav, mode.nav_);
+        out.add_slot(slot::ap_apr, mode.apr_);
+        out.add_slot(slot::ap_rev, mode.rev_);
+        out.add_slot(slot::ap_alt, mode.alt_);
+        out.add_slot(slot::ap_vs, mode.vs_);
+        out.add_slot(slot::ap_ias, mode.ias_);
+        out.add_slot(slot::ap, mode.ap_);
+
+        if(ap.dials_) {
+            header.flags |= has_dials;
+            const auto & dials = ap.dials_.value();
+            if(dials.ias_) {
+                const auto & ias = dials.ias_.value();
+                out.add_dial(dial::ias, ias.value_, out.string(profile.data_refs_->key(ias.is_mach_)));
+            }
+            out.add_dial(dial::crs, dials.course_);
+            out.add_dial(dial::hdg, dials.heading_);
+            out.add_dial(dial::vs, dials.vs_);
+            out.add_dial(dial::alt, dials.alt_);
+        }
+    }
+
+    if(profile.annunciator_) {
+        header.flags |= has_annunciator;
+        const auto & ann = profile.annunciator_.value();
+        out.add_slot(slot::master_warn, ann.master_warn_);
+        out.add_slot(slot::eng_fire, ann.eng_fire_);
+        out.add_slot(slot::oil_low, ann.oil_low_);
+        out.add_slot(slot::fuel_low, ann.fuel_low_);
+        out.add_slot(slot::anti_ice, ann.anti_ice_);
+        out.add_slot(slot::starter, ann.starter_);
+        out.add_slot(slot::apu, ann.apu_);
+        out.add_slot(slot::master_caution, ann.master_caution_);
+        out.add_slot(slot::vacuum_low, ann.vacuum_low_);
+        out.add_slot(slot::hydro_low, ann.hydro_low_);
+        out.add_slot(slot::aux_fuel, ann.aux_fuel_);
+        out.add_slot(slot::parking_brake, ann.parking_brake_);
+        out.add_slot(slot::volt_low, ann.volt_low_);
+        out.add_slot(slot::door_open, ann.door_open_);
+    }
+
+    auto buffer = out.serialize(header, aircrafts, models);
+
+    // Readers must never see a partially written image
+    auto tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream output(tmp, std::ios::binary | std::ios::trunc);
+        output.write(reinterpret_cast<const char *>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+        if(!output) {
+            log_error() << "Failed to write " << tmp;
+            return std::unexpected(0);
+        }
+    }
+    std::error_code err;
+    std::filesystem::rename(tmp, path, err);
+    if(err) {
+        log_error() << "Failed to write " << path << ": " << err.message();
+        return std::unexpected(0);
+    }
+    return {};
+}
+
+class profile_image::reader {
+protected:
+    const uint8_t * data_;
+    size_t size_;
+    image_header header_;
+    data_ref_table & table_;
+
+    template<typename T>
+    const T *
+    section(uint32_t offset, uint32_t count) const noexcept {
+        if(offset % alignof(T) != 0 or offset > this->size_) return nullptr;
+        if(count > (this->size_ - offset) / sizeof(T)) return nullptr;
+        return reinterpret_cast<const T *>(this->data_ + offset);
+    }
+
+public:
+    const uint32_t * string_offsets;
+    const char * string_data;
+    const uint32_t * aircrafts;
+    const uint32_t * models;
+    const image_predicate * predicates;
+    const uint32_t * values;
+    const image_slot * slots;
+    const image_dial * dials;
+    const image_curve * curves;
+    const image_stage * stages;
+
+    inline
+    reader(const uint8_t * data, size_t size, data_ref_table & table) noexcept :
+        data_(data),
+        size_(size),
+        header_{},
+        table_(table)
+    {}
+
+    inline
+    const image_header &
+    header() const noexcept { return this->header_; }
+
+    bool
+    validate() noexcept {
+        if(this->size_ < sizeof(image_header)) return false;
+        std::memcpy(&this->header_, this->data_, sizeof(image_header));
+        const auto & h = this->header_;
+        if(std::memcmp(h.magic, magic, sizeof(magic)) != 0) return false;
+        if(h.version != version) {
+            log_warn() << "Unsupported profile image version " << h.version;
+            return false;
+        }
+        if(h.size != this->size_) return false;
+
+        this->string_offsets = this->section<uint32_t>(h.string_offsets, h.string_count);
+        this->string_data = this->section<char>(h.string_data, h.string_size);
+        this->aircrafts = this->section<uint32_t>(h.aircrafts, h.aircraft_count);
+        this->models = this->section<uint32_t>(h.models, h.model_count);
+        this->predicates = this->section<image_predicate>(h.predicates, h.predicate_count);
+        this->values = this->section<uint32_t>(h.values, h.value_count);
+        this->slots = this->section<image_slot>(h.slots, h.slot_count);
+        this->dials = this->section<image_dial>(h.dials, h.dial_count);
+        this->curves = this->section<image_curve>(h.curves, h.curve_count);
+        this->stages = this->section<image_stage>(h.stages, h.stage_count);
+        if(this->string_offsets == nullptr or this->string_data == nullptr or this->aircrafts == nullptr
+            or this->models == nullptr or this->predicates == nullptr or this->values == nullptr
+            or this->slots == nullptr or this->dials == nullptr or this->curves == nullptr
+            or this->stages == nullptr) return false;
+
+        // Strings must be NUL-terminated inside the string data
+        if(h.string_size == 0 or this->string_data[h.string_size - 1] != '\0') return false;
+        for(uint32_t n = 0; n < h.string_count; ++n) {
+            if(this->string_offsets[n] >= h.string_size) return false;
+        }
+
+        for(uint32_t n = 0; n < h.predicate_count; ++n) {
+            const auto & p = this->predicates[n];
+            if(p.key >= h.string_count) return false;
+            if(p.type > value_type::real) return false;
+            if(p.value_first > h.value_count or p.value_count > h.value_count - p.value_first) return false;
+        }
+        for(uint32_t n = 0; n < h.slot_count; ++n) {
+            const auto & s = this->slots[n];
+            if(s.id >= slot::count) return false;
+            if(s.first > h.predicate_count or s.count > h.predicate_count - s.first) return false;
+        }
+        for(uint32_t n = 0; n < h.dial_count; ++n) {
+            const auto & d = this->dials[n];
+            if(d.id >= dial::count or d.predicate >= h.predicate_count) return false;
+            if(this->predicates[d.predicate].type != value_type::real) return false;
+            if(d.id == dial::ias and d.is_mach >= h.string_count) return false;
+        }
+        for(uint32_t n = 0; n < h.curve_count; ++n) {
+            const auto & c = this->curves[n];
+            if(c.knob >= knob_config::count) return false;
+            if(c.first > h.stage_count or c.count > h.stage_count - c.first) return false;
+        }
+        for(uint32_t n = 0; n < h.aircraft_count; ++n) {
+            if(this->aircrafts[n] >= h.string_count) return false;
+        }
+        for(uint32_t n = 0; n < h.model_count; ++n) {
+            if(this->models[n] >= h.string_count) return false;
+        }
+        if(h.base != no_string and h.base >= h.string_count) return false;
+        return h.name < h.string_count;
+    }
+
+    inline
+    const char *
+    string(uint32_t id) const noexcept {
+        return this->string_data + this->string_offsets[id];
+    }
+
+    template<typename T>
+    std::vector<T>
+    values_of(const image_predicate & record) const noexcept {
+        std::vector<T> ret;
+        ret.reserve(record.value_count);
+        for(uint32_t n = 0; n < record.value_count; ++n) {
+            ret.emplace_back(std::bit_cast<T>(this->values[record.value_first + n]));
+        }
+        return ret;
+    }
+
+    template<typename T>
+    ::data_ref<T>
+    make(const image_predicate & record) const noexcept {
+        auto index = record.has_index ? std::optional<size_t>(record.index) : std::nullopt;
+        auto key = this->table_.intern(this->string(record.key), index.has_value());
+        return ::data_ref<T>(this->table_, key, record.invert != 0, index);
+    }
+
+    bool_data_ref
+    predicate(const image_predicate & record) const noexcept {
+        switch(record.type) {
+            case value_type::integer: {
+                auto ret = this->make<int>(record);
+                ret.values_ = this->values_of<int>(record);
+                return bool_data_ref(std::move(ret));
+            }
+            case value_type::real: {
+                auto ret = this->make<float>(record);
+                ret.values_ = this->values_of<float>(record);
+                return bool_data_ref(std::move(ret));
+            }
+            default:
+                return bool_data_ref(this->make<bool>(record));
+        }
+    }
+
+    value_data_ref
+    value(const image_slot & record) const noexcept {
+        value_data_ref ret;
+        ret.data_.reserve(record.count);
+        for(uint32_t n = 0; n < record.count; ++n) {
+            ret.data_.emplace_back(this->predicate(this->predicates[record.first + n]));
+        }
+        return ret;
+    }
+
+    float_data_ref
+    dial(const image_dial & record) const noexcept {
+        const auto & p = this->predicates[record.predicate];
+        auto ret = this->make<float>(p);
+        ret.values_ = this->values_of<float>(p);
+        return ret;
+    }
+};
+
+std::expected<profile::ptr_type, int>
+profile_image::load(const std::filesystem::path & path) noexcept
+{
+    log_debug() << "Loading Profile Image " << path;
+    mapped_file file;
+    if(file.open(path) == false) {
+        log_error() << "Failed to map " << path;
+        return std::unexpected(0);
+    }
+
+    auto data_refs = std::make_unique<data_ref_table>();
+    reader in(file.data(), file.size(), *data_refs);
+    if(in.validate() == false) {
+        log_warn() << "Invalid profile image " << path;
+        return std::unexpected(0);
+    }
+    const auto & h = in.header();
+
+    std::vector<std::string> aircrafts;
+    for(uint32_t n = 0; n < h.aircraft_count; ++n) aircrafts.emplace_back(in.string(in.aircrafts[n]));
+    std::vector<std::string> models;
+    for(uint32_t n = 0; n < h.model_count; ++n) models.emplace_back(in.string(in.models[n]));
+    profile_header header(in.string(h.name), std::move(aircrafts), std::move(models), h.priority);
+
+    system_data_ref system;
+    autopilot_mode_data_ref mode;
+    annunciator_data_ref ann;
+    for(uint32_t n = 0; n < h.slot_count; ++n) {
+        const auto & record = in.slots[n];
+        auto value = in.value(record);
+        switch(record.id) {
+            case slot::volts: system.volts_ = std::move(value); break;
+            case slot::gear: system.gear_ = std::move(value); break;
+            case slot::ap_hdg: mode.hdg_ = std::move(value); break;
+            case slot::ap_nav: mode.nav_ = std::move(value); break;
+            case slot::ap_apr: mode.apr_ = std::move(value); break;
+            case slot::ap_rev: mode.rev_ = std::move(value); break;
+            case slot::ap_alt: mode.alt_ = std::move(value); break;
+            case slot::ap_vs: mode.vs_ = std::move(value); break;
+            case slot::ap_ias: mode.ias_ = std::move(value); break;
+            case slot::ap: mode.ap_ = std::move(value); break;
+            case slot::master_warn: ann.master_warn_ = std::move(value); break;
+            case slot::eng_fire: ann.eng_fire_ = std::move(value); break;
+            case slot::oil_low: ann.oil_low_ = std::move(value); break;
+            case slot::fuel_low: ann.fuel_low_ = std::move(value); break;
+            case slot::anti_ice: ann.anti_ice_ = std::move(value); break;
+            case slot::starter: ann.starter_ = std::move(value); break;
+            case slot::apu: ann.apu_ = std::move(value); break;
+            case slot::master_caution: ann.master_caution_ = std::move(value); break;
+            case slot::vacuum_low: ann.vacuum_low_ = std::move(value); break;
+            case slot::hydro_low: ann.hydro_low_ = std::move(value); break;
+            case slot::aux_fuel: ann.aux_fuel_ = std::move(value); break;
+            case slot::parking_brake: ann.parking_brake_ = std::move(value); break;
+            case slot::volt_low: ann.volt_low_ = std::move(value); break;
+            case slot::door_open: ann.door_open_ = std::move(value); break;
+            default: break;
+        }
+    }
+
+    std::optional<autopilot_data_ref> autopilot;
+    if(h.flags & has_autopilot) {
+        std::optional<autopilot_dial_data_ref> dials;
+        if(h.flags & has_dials) {
+            autopilot_dial_data_ref dial_refs;
+            for(uint32_t n = 0; n < h.dial_count; ++n) {
+                const auto & record = in.dials[n];
+                auto value = in.dial(record);
+                switch(record.id) {
+                    case dial::ias: {
+                        auto is_mach = data_refs->intern(in.string(record.is_mach), false);
+                        dial_refs.ias_ = airspeed_data_ref(*data_refs, is_mach, std::move(value));
+                        break;
+                    }
+                    case dial::crs: dial_refs.course_ = std::move(value); break;
+                    case dial::hdg: dial_refs.heading_ = std::move(value); break;
+                    case dial::vs: dial_refs.vs_ = std::move(value); break;
+                    case dial::alt: dial_refs.alt_ = std::move(value); break;
+                    default: break;
+                }
+            }
+            dials = std::move(dial_refs);
+        }
+        autopilot = autopilot_data_ref(std::move(mode), std::move(dials));
+    }
+
+    std::optional<annunciator_data_ref> annunciator;
+    if(h.flags & has_annunciator) annunciator = std::move(ann);
+
+    std::optional<refresh_config> refresh;
+    if(h.flags & has_refresh) {
+        refresh.emplace();
+        refresh->interval_ = h.refresh_interval;
+        refresh->max_ = h.refresh_max;
+        refresh->unpowered_ = h.refresh_unpowered;
+    }
+
+    std::optional<knob_config> knobs;
+    if(h.flags & has_knobs) {
+        knobs.emplace();
+        knobs->window_ = h.knob_window;
+        for(uint32_t n = 0; n < h.curve_count; ++n) {
+            const auto & record = in.curves[n];
+            std::vector<acceleration_stage> stages;
+            for(uint32_t i = 0; i < record.count; ++i) {
+                const auto & stage = in.stages[record.first + i];
+                stages.emplace_back(acceleration_stage{ stage.rate, stage.step });
+            }
+            knobs->curves_[record.knob] = acceleration_curve(std::move(stages));
+        }
+    }
+
+    logger() << "Found " << data_refs->size() << " DataRef(s)";
+    auto ret = profile_ptr(new profile(
+        std::move(header),
+        std::move(data_refs),
+        (h.flags & has_system) ? std::optional<system_data_ref>(std::move(system)) : std::nullopt,
+        std::move(autopilot),
+        std::move(annunciator),
+        std::move(refresh),
+        std::move(knobs)
+    ));
+    if(h.base != no_string and ret->extend(in.string(h.base), path.parent_path()) == false) {
+        return std::unexpected(0);
+    }
+    return ret;
+}
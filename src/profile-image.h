@@ -0,0 +1,203 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/profile-image.h
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#ifndef PROFILE_IMAGE_H_
+#define PROFILE_IMAGE_H_
+
+#include "profile.h"
+
+#include <expected>
+#include <filesystem>
+
+#include <cstdint>
+
+// Precompiled binary profiles (.hcbp).
+//
+// YAML remains the authoring format. hcbravo-compile turns each YAML profile
+// into an image that is mapped into memory and turned into a profile by
+// walking fixed-size records, without any tokenizing or per-scalar parsing.
+//
+// Layout, in host byte order (little-endian), with every section aligned to
+// four bytes and every offset counted from the start of the file:
+//
+//   header                                  see image_header
+//   uint32_t string_offsets[string_count]   offsets into the string data
+//   char string_data[string_size]           NUL-terminated strings
+//   uint32_t aircrafts[aircraft_count]      string ids
+//   uint32_t models[model_count]            string ids
+//   image_predicate predicates[predicate_count]
+//   uint32_t values[value_count]            int32_t or float bit patterns
+//   image_slot slots[slot_count]            predicates of each profile entry
+//   image_dial dials[dial_count]            autopilot dials
+//   image_curve curves[curve_count]         knob acceleration curves
+//   image_stage stages[stage_count]         stages of every curve
+//
+// Strings hold the profile name, aircrafts, models and every DataRef key,
+// each of them stored once. A slot assigns a contiguous range of predicates
+// to one entry of the profile (e.g. system/volts or annunciator/oil_low).
+// Images of profiles that extend another one only hold their own sections,
+// and the base is read from its YAML file when the image is loaded.
+class profile_image {
+public:
+    static constexpr char magic[4] = { 'H', 'C', 'B', 'P' };
+    static const uint32_t version = 4;
+
+    static constexpr const char * extension = ".hcbp";
+
+    enum flags : uint32_t {
+        has_autopilot = 1u << 0,
+        has_dials = 1u << 1,
+        has_annunciator = 1u << 2,
+        has_system = 1u << 3,
+        has_refresh = 1u << 4,
+        has_knobs = 1u << 5
+    };
+
+    enum class value_type : uint8_t {
+        boolean,
+        integer,
+        real
+    };
+
+    enum class slot : uint16_t {
+        volts,
+        gear,
+        ap_hdg,
+        ap_nav,
+        ap_apr,
+        ap_rev,
+        ap_alt,
+        ap_vs,
+        ap_ias,
+        ap,
+        master_warn,
+        eng_fire,
+        oil_low,
+        fuel_low,
+        anti_ice,
+        starter,
+        apu,
+        master_caution,
+        vacuum_low,
+        hydro_low,
+        aux_fuel,
+        parking_brake,
+        volt_low,
+        door_open,
+        count
+    };
+
+    enum class dial : uint16_t {
+        ias,
+        crs,
+        hdg,
+        vs,
+        alt,
+        count
+    };
+
+    static const uint32_t no_string = UINT32_MAX;
+
+protected:
+    class writer;
+    class reader;
+
+public:
+    struct image_header {
+        char magic[4];
+        uint32_t version;
+        uint32_t size;
+        uint32_t flags;
+        uint32_t name;
+        // Profile extended, relative to the directory of the image
+        uint32_t base;
+        int32_t priority;
+        uint32_t string_count;
+        uint32_t string_offsets;
+        uint32_t string_data;
+        uint32_t string_size;
+        uint32_t aircraft_count;
+        uint32_t aircrafts;
+        uint32_t model_count;
+        uint32_t models;
+        uint32_t predicate_count;
+        uint32_t predicates;
+        uint32_t value_count;
+        uint32_t values;
+        uint32_t slot_count;
+        uint32_t slots;
+        uint32_t dial_count;
+        uint32_t dials;
+        float refresh_interval;
+        float refresh_max;
+        float refresh_unpowered;
+        float knob_window;
+        uint32_t curve_count;
+        uint32_t curves;
+        uint32_t stage_count;
+        uint32_t stages;
+    };
+
+    struct image_predicate {
+        uint32_t key;
+        value_type type;
+        uint8_t invert;
+        uint8_t has_index;
+        uint8_t reserved;
+        uint32_t index;
+        uint32_t value_first;
+        uint32_t value_count;
+    };
+
+    struct image_slot {
+        slot id;
+        uint16_t reserved;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    struct image_dial {
+        dial id;
+        uint16_t reserved;
+        // Only used by the IAS dial
+        uint32_t is_mach;
+        uint32_t predicate;
+    };
+
+    struct image_curve {
+        // Index into knob_config::names
+        uint16_t knob;
+        uint16_t reserved;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    struct image_stage {
+        float rate;
+        float step;
+    };
+
+    // Path of the image for a YAML profile
+    static
+    std::filesystem::path
+    path_for(const std::filesystem::path & yaml) noexcept;
+
+    // Whether the image of a YAML profile exists and is not older than it
+    static
+    bool
+    is_fresh(const std::filesystem::path & yaml) noexcept;
+
+    static
+    std::expected<void, int>
+    write(const profile & profile, const std::filesystem::path & path) noexcept;
+
+    static
+    std::expected<profile::ptr_type, int>
+    load(const std::filesystem::path & path) noexcept;
+};
+
+#endif
@@ -7,55 +7,68 @@
 
 #include "logger.h"
 #include "profile.h"
+#include "trace.h"
 
 #include <XPLM/XPLMUtilities.h>
 
+#include <algorithm>
+#include <filesystem>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 
 static
-std::optional<bool_data_ref::ptr_type>
-make_bool_data_ref(const YAML::Node & node) noexcept
+std::optional<bool_data_ref>
+make_bool_data_ref(const YAML::Node & node, data_ref_table & table) noexcept
 {
     if(!node or !node["key"]) return std::nullopt;
+    if(node["type"] and node["type"].IsScalar() == false) {
+        log_warn() << "Invalid DataRef type '" << node["type"] << "'";
+        return std::nullopt;
+    }
     std::string node_type = node["type"] ? node["type"].as<std::string>() : "bool";
 
     if(node_type == "bool") {
-        auto data = data_ref<bool>::build(node);
+        auto data = data_ref<bool>::build(node, table);
         if(data.has_value() == false) return std::nullopt;
-        return bool_data_ref::ptr_type(new data_ref<bool>(std::move(data.value())));
+        return bool_data_ref(std::move(data.value()));
     }
     else if(node_type == "int") {
-        auto data = data_ref<int>::build(node);
+        auto data = data_ref<int>::build(node, table);
         if(data.has_value() == false) return std::nullopt;
-        return bool_data_ref::ptr_type(new data_ref<int>(std::move(data.value())));
+        return bool_data_ref(std::move(data.value()));
     }
     else if(node_type == "float") {
-        auto data = data_ref<float>::build(node);
+        auto data = data_ref<float>::build(node, table);
         if(data.has_value() == false) return std::nullopt;
-        return bool_data_ref::ptr_type(new data_ref<float>(std::move(data.value())));
+        return bool_data_ref(std::move(data.value()));
     }
     return std::nullopt;
 }
 
-value_data_ref::value_data_ref(const YAML::Node & node) noexcept {
+value_data_ref::value_data_ref(const YAML::Node & node, data_ref_table & table) noexcept {
     if(!node or node.IsSequence() == false) return;
+    data_.reserve(node.size());
     for(const auto & value : node) {
-        auto data = make_bool_data_ref(value);
+        auto data = make_bool_data_ref(value, table);
         if(data.has_value()) data_.emplace_back(std::move(data.value()));
     }
 }
 
 airspeed_data_ref::airspeed_data_ref(
-    XPLMDataRef && is_mach, data_ref<float> && value
+    const data_ref_table & table, data_ref_table::key_type is_mach, data_ref<float> && value
 ) noexcept :
-    is_mach_(std::move(is_mach)),
+    table_(&table),
+    is_mach_(is_mach),
     value_(std::move(value))
 {}
 
 std::expected<airspeed_data_ref, int>
-airspeed_data_ref::build(const YAML::Node & node) noexcept {
+airspeed_data_ref::build(const YAML::Node & node, data_ref_table & table) noexcept {
     if(!node.IsMap()) {
         logger() << "IAS node has invalid format";
         return std::unexpected(0);
@@ -69,32 +82,32 @@ airspeed_data_ref::build(const YAML::Node & node) noexcept {
         return std::unexpected(0);
     }
     
-    auto is_mach = XPLMFindDataRef(node["is_mach"].as<std::string>().c_str());
-    if(is_mach == nullptr) {
-        logger() << "Invalid IAS Mach node";
+    if(node["is_mach"].IsScalar() == false) {
+        log_warn() << "Invalid IAS Mach node";
         return std::unexpected(0);
     }
+    auto is_mach = table.intern(node["is_mach"].as<std::string>(), false);
 
-    auto value = data_ref<float>::build(node["value"]);
+    auto value = data_ref<float>::build(node["value"], table);
     if(!value.has_value()) {
-        logger() << "Invalid IAS Value node";
+        log_warn() << "Invalid IAS Value node";
         return std::unexpected(0);
     }
 
-    return airspeed_data_ref(std::move(is_mach), std::move(value.value())); 
+    return airspeed_data_ref(table, is_mach, std::move(value.value()));
 }
 
 template<typename T>
 static inline
 std::optional<data_ref<T>>
-build_optional_data_ref(const YAML::Node & node, const std::string & key) noexcept
+build_optional_data_ref(const YAML::Node & node, const std::string & key, data_ref_table & table) noexcept
 {
     logger() << "Checking for '" << key << "'";
     if(!node.IsMap() or !node[key]) {
-        logger() << "Key '" << key << "' not found in: " << node;
+        log_warn() << "Key '" << key << "' not found in: " << node;
         return std::nullopt;
     }
-    auto ret = data_ref<T>::build(node[key]);
+    auto ret = data_ref<T>::build(node[key], table);
     if(ret.has_value() == false) {
         logger() << "DataRef in '" << node << "' not found";
         return std::nullopt;
@@ -102,54 +115,55 @@ build_optional_data_ref(const YAML::Node & node, const std::string & key) noexce
     return std::optional(std::move(ret.value()));
 }
 
-autopilot_dial_data_ref::autopilot_dial_data_ref(std::optional<airspeed_data_ref> && ias, const YAML::Node & node) noexcept :
+autopilot_dial_data_ref::autopilot_dial_data_ref(std::optional<airspeed_data_ref> && ias, const YAML::Node & node,
+    data_ref_table & table) noexcept :
     ias_(std::move(ias)),
-    course_(build_optional_data_ref<float>(node, "crs")),
-    heading_(build_optional_data_ref<float>(node, "hdg")),
-    vs_(build_optional_data_ref<float>(node, "vs")),
-    alt_(build_optional_data_ref<float>(node, "alt"))
+    course_(build_optional_data_ref<float>(node, "crs", table)),
+    heading_(build_optional_data_ref<float>(node, "hdg", table)),
+    vs_(build_optional_data_ref<float>(node, "vs", table)),
+    alt_(build_optional_data_ref<float>(node, "alt", table))
 {}
 
 std::expected<autopilot_dial_data_ref, int>
-autopilot_dial_data_ref::build(const YAML::Node & node) noexcept
+autopilot_dial_data_ref::build(const YAML::Node & node, data_ref_table & table) noexcept
 {
     logger() << "Reading Autopilot Dials";
     if(node.IsMap() == false) {
-        logger() << "Invalid Autopilot Configuration";
+        log_warn() << "Invalid Autopilot Configuration";
         return std::unexpected(0);
     }
 
     logger() << "Checking if IAS Dial is defined";
     if(node["ias"]) {
-        auto ias = airspeed_data_ref::build(node["ias"]);
+        auto ias = airspeed_data_ref::build(node["ias"], table);
         if(ias.has_value() == false) {
-            logger() << "Invalid IAS Dial Configuration";
+            log_warn() << "Invalid IAS Dial Configuration";
             return std::unexpected(0);
         }
-        return autopilot_dial_data_ref(std::move(ias.value()), node);
+        return autopilot_dial_data_ref(std::move(ias.value()), node, table);
     }
-    return autopilot_dial_data_ref(std::nullopt, node);
+    return autopilot_dial_data_ref(std::nullopt, node, table);
 }
 
-autopilot_mode_data_ref::autopilot_mode_data_ref(const YAML::Node & node) noexcept :
-    hdg_(node["hdg"] ? std::optional(value_data_ref(node["hdg"])) : std::nullopt),
-    nav_(node["nav"] ? std::optional(value_data_ref(node["nav"])) : std::nullopt),
-    apr_(node["apr"] ? std::optional(value_data_ref(node["apr"])) : std::nullopt),
-    rev_(node["rev"] ? std::optional(value_data_ref(node["rev"])) : std::nullopt),
-    alt_(node["alt"] ? std::optional(value_data_ref(node["alt"])) : std::nullopt),
-    vs_ (node["vs"] ? std::optional(value_data_ref(node["vs"])) : std::nullopt),
-    ias_(node["ias"] ? std::optional(value_data_ref(node["ias"])) : std::nullopt),
-    ap_(node["ap"])
+autopilot_mode_data_ref::autopilot_mode_data_ref(const YAML::Node & node, data_ref_table & table) noexcept :
+    hdg_(node["hdg"] ? std::optional(value_data_ref(node["hdg"], table)) : std::nullopt),
+    nav_(node["nav"] ? std::optional(value_data_ref(node["nav"], table)) : std::nullopt),
+    apr_(node["apr"] ? std::optional(value_data_ref(node["apr"], table)) : std::nullopt),
+    rev_(node["rev"] ? std::optional(value_data_ref(node["rev"], table)) : std::nullopt),
+    alt_(node["alt"] ? std::optional(value_data_ref(node["alt"], table)) : std::nullopt),
+    vs_ (node["vs"] ? std::optional(value_data_ref(node["vs"], table)) : std::nullopt),
+    ias_(node["ias"] ? std::optional(value_data_ref(node["ias"], table)) : std::nullopt),
+    ap_(node["ap"], table)
 {}
 
 std::expected<autopilot_mode_data_ref, int>
-autopilot_mode_data_ref::build(const YAML::Node & node) noexcept
+autopilot_mode_data_ref::build(const YAML::Node & node, data_ref_table & table) noexcept
 {
     logger() << "Reading Autopilot Modes";
     // Only the AP annunciator is required
     if(!node["ap"]) return std::unexpected(1);
     
-    return autopilot_mode_data_ref(node);
+    return autopilot_mode_data_ref(node, table);
 }
 
 
@@ -162,22 +176,22 @@ autopilot_data_ref::autopilot_data_ref(
 {}
 
 std::expected<autopilot_data_ref, int>
-autopilot_data_ref::build(const YAML::Node & node) noexcept
+autopilot_data_ref::build(const YAML::Node & node, data_ref_table & table) noexcept
 {
     if(!node["modes"]) {
         logger() << "No modes defined for Autopilot";
         return std::unexpected(0);
     }
-    auto mode = autopilot_mode_data_ref::build(node["modes"]);
+    auto mode = autopilot_mode_data_ref::build(node["modes"], table);
     if(mode.has_value() == false) {
-        logger() << "Invalid Autopilot Modes Configuration";
+        log_warn() << "Invalid Autopilot Modes Configuration";
         return std::unexpected(0);
     }
 
     if(node["dials"]) {
-        auto dial = autopilot_dial_data_ref::build(node["dials"]);
+        auto dial = autopilot_dial_data_ref::build(node["dials"], table);
         if(dial.has_value() == false) {
-            logger() << "Invalid Autopilot Dials Configuration";
+            log_warn() << "Invalid Autopilot Dials Configuration";
             return std::unexpected(0);
         }
 
@@ -187,67 +201,192 @@ autopilot_data_ref::build(const YAML::Node & node) noexcept
     return autopilot_data_ref(std::move(mode.value()), std::nullopt);
 }
 
-system_data_ref::system_data_ref(const YAML::Node & node) noexcept :
-    volts_(node["volts"]),
-    gear_(node["gear"] ? std::optional(value_data_ref(node["gear"])) : std::nullopt)
+system_data_ref::system_data_ref(const YAML::Node & node, data_ref_table & table) noexcept :
+    volts_(node["volts"], table),
+    gear_(node["gear"] ? std::optional(value_data_ref(node["gear"], table)) : std::nullopt)
 {}
 
 std::expected<system_data_ref, int>
-system_data_ref::build(const YAML::Node & node) noexcept
+system_data_ref::build(const YAML::Node & node, data_ref_table & table) noexcept
 {
     // Only the AP annunciator is required
     if(!node["volts"]) return std::unexpected(1);
-    return system_data_ref(node);
+    return system_data_ref(node, table);
 }
 
 
 
-annunciator_data_ref::annunciator_data_ref(const YAML::Node & node) noexcept :
-    master_warn_(node["master_warn"] ? std::optional(value_data_ref(node["master_warn"])) : std::nullopt),
-    eng_fire_(node["eng_fire"] ? std::optional(value_data_ref(node["eng_fire"])) : std::nullopt),
-    oil_low_(node["oil_low"] ? std::optional(value_data_ref(node["oil_low"])) : std::nullopt),
-    fuel_low_(node["fuel_low"] ? std::optional(value_data_ref(node["fuel_low"])) : std::nullopt),
-    anti_ice_(node["anti_ice"] ? std::optional(value_data_ref(node["anti_ice"])) : std::nullopt),
-    starter_(node["starter"] ? std::optional(value_data_ref(node["starter"])) : std::nullopt),
-    apu_(node["apu"] ? std::optional(value_data_ref(node["apu"])) : std::nullopt),
-    master_caution_(node["master_caution"] ? std::optional(value_data_ref(node["master_caution"])) : std::nullopt),
-    vacuum_low_(node["vacuum_low"] ? std::optional(value_data_ref(node["vacuum_low"])) : std::nullopt),
-    hydro_low_(node["hydro_low"] ? std::optional(value_data_ref(node["hydro_low"])) : std::nullopt),
-    aux_fuel_(node["aux_fuel"] ? std::optional(value_data_ref(node["aux_fuel"])) : std::nullopt),
-    parking_brake_(node["parking_brake"] ? std::optional(value_data_ref(node["parking_brake"])) : std::nullopt),
-    volt_low_(node["volt_low"] ? std::optional(value_data_ref(node["volt_low"])) : std::nullopt),
-    door_open_(node["door_open"] ? std::optional(value_data_ref(node["door_open"])) : std::nullopt)
+annunciator_data_ref::annunciator_data_ref(const YAML::Node & node, data_ref_table & table) noexcept :
+    master_warn_(node["master_warn"] ? std::optional(value_data_ref(node["master_warn"], table)) : std::nullopt),
+    eng_fire_(node["eng_fire"] ? std::optional(value_data_ref(node["eng_fire"], table)) : std::nullopt),
+    oil_low_(node["oil_low"] ? std::optional(value_data_ref(node["oil_low"], table)) : std::nullopt),
+    fuel_low_(node["fuel_low"] ? std::optional(value_data_ref(node["fuel_low"], table)) : std::nullopt),
+    anti_ice_(node["anti_ice"] ? std::optional(value_data_ref(node["anti_ice"], table)) : std::nullopt),
+    starter_(node["starter"] ? std::optional(value_data_ref(node["starter"], table)) : std::nullopt),
+    apu_(node["apu"] ? std::optional(value_data_ref(node["apu"], table)) : std::nullopt),
+    master_caution_(node["master_caution"] ? std::optional(value_data_ref(node["master_caution"], table)) : std::nullopt),
+    vacuum_low_(node["vacuum_low"] ? std::optional(value_data_ref(node["vacuum_low"], table)) : std::nullopt),
+    hydro_low_(node["hydro_low"] ? std::optional(value_data_ref(node["hydro_low"], table)) : std::nullopt),
+    aux_fuel_(node["aux_fuel"] ? std::optional(value_data_ref(node["aux_fuel"], table)) : std::nullopt),
+    parking_brake_(node["parking_brake"] ? std::optional(value_data_ref(node["parking_brake"], table)) : std::nullopt),
+    volt_low_(node["volt_low"] ? std::optional(value_data_ref(node["volt_low"], table)) : std::nullopt),
+    door_open_(node["door_open"] ? std::optional(value_data_ref(node["door_open"], table)) : std::nullopt)
 {}
 
 std::expected<annunciator_data_ref, int>
-annunciator_data_ref::build(const YAML::Node & node) noexcept 
+annunciator_data_ref::build(const YAML::Node & node, data_ref_table & table) noexcept 
 {
     logger() << "Reading Annunciator";
-    return annunciator_data_ref(node);
+    return annunciator_data_ref(node, table);
+}
+
+
+std::expected<refresh_config, int>
+refresh_config::build(const YAML::Node & node) noexcept
+{
+    logger() << "Reading Refresh Configuration";
+    refresh_config ret;
+    if(node.IsMap() == false) {
+        log_warn() << "Invalid Refresh Configuration";
+        return std::unexpected(0);
+    }
+
+    if(node["frames"] and node["seconds"]) {
+        logger() << "Refresh interval cannot be given both in frames and seconds";
+        return std::unexpected(0);
+    }
+
+    try {
+        if(node["frames"]) {
+            auto frames = node["frames"].as<int>();
+            if(frames < 1) {
+                log_warn() << "Invalid Refresh interval of " << frames << " frame(s)";
+                return std::unexpected(0);
+            }
+            ret.interval_ = -static_cast<float>(frames);
+        }
+        else if(node["seconds"]) {
+            auto seconds = node["seconds"].as<float>();
+            if(seconds <= 0.0f) {
+                log_warn() << "Invalid Refresh interval of " << seconds << " second(s)";
+                return std::unexpected(0);
+            }
+            ret.interval_ = seconds;
+        }
+
+        if(node["max"]) ret.max_ = std::max(0.0f, node["max"].as<float>());
+        if(node["unpowered"]) ret.unpowered_ = std::max(0.0f, node["unpowered"].as<float>());
+    }
+    catch(const YAML::Exception & e) {
+        log_warn() << "Invalid Refresh Configuration '" << node << "'";
+        return std::unexpected(0);
+    }
+    return ret;
+}
+
+acceleration_curve::acceleration_curve(std::vector<acceleration_stage> && stages) noexcept :
+    stages_(std::move(stages))
+{
+    std::sort(this->stages_.begin(), this->stages_.end(),
+        [](const auto & a, const auto & b) { return a.rate_ < b.rate_; });
+}
+
+std::expected<acceleration_curve, int>
+acceleration_curve::build(const YAML::Node & node) noexcept
+{
+    if(node.IsSequence() == false or node.size() == 0) {
+        log_warn() << "Invalid Acceleration Curve";
+        return std::unexpected(0);
+    }
+
+    std::vector<acceleration_stage> stages;
+    for(const auto & stage : node) {
+        if(stage.IsMap() == false or !stage["rate"] or !stage["step"]) {
+            log_warn() << "Invalid Acceleration Stage '" << stage << "'";
+            return std::unexpected(0);
+        }
+        float rate, step;
+        try {
+            rate = stage["rate"].as<float>();
+            step = stage["step"].as<float>();
+        }
+        catch(const YAML::Exception & e) {
+            log_warn() << "Invalid Acceleration Stage '" << stage << "'";
+            return std::unexpected(0);
+        }
+        if(rate < 0.0f or step <= 0.0f) {
+            log_warn() << "Invalid Acceleration Stage of " << step << " at " << rate << " detent(s) per second";
+            return std::unexpected(0);
+        }
+        stages.emplace_back(acceleration_stage{ rate, step });
+    }
+    return acceleration_curve(std::move(stages));
 }
 
+std::expected<knob_config, int>
+knob_config::build(const YAML::Node & node) noexcept
+{
+    logger() << "Reading Knob Configuration";
+    knob_config ret;
+    if(node.IsMap() == false) {
+        log_warn() << "Invalid Knob Configuration";
+        return std::unexpected(0);
+    }
+
+    if(node["window"]) {
+        float window;
+        try {
+            window = node["window"].as<float>();
+        }
+        catch(const YAML::Exception & e) {
+            log_warn() << "Invalid Knob rate window '" << node["window"] << "'";
+            return std::unexpected(0);
+        }
+        if(window <= 0.0f) {
+            log_warn() << "Invalid Knob rate window of " << window << " second(s)";
+            return std::unexpected(0);
+        }
+        ret.window_ = window;
+    }
+
+    for(size_t n = 0; n < count; ++n) {
+        if(!node[names[n]]) continue;
+        auto curve = acceleration_curve::build(node[names[n]]);
+        if(curve.has_value() == false) {
+            log_warn() << "Invalid Acceleration Curve for '" << names[n] << "'";
+            return std::unexpected(0);
+        }
+        ret.curves_[n] = std::move(curve.value());
+    }
+    return ret;
+}
 
-profile::profile(std::string && name,
-    std::vector<std::string> && aircrafts, std::vector<std::string> && models, 
-    system_data_ref && system, std::optional<autopilot_data_ref> && autopilot,
-    std::optional<annunciator_data_ref> && annunciator
+profile::profile(profile_header && header, std::unique_ptr<data_ref_table> && data_refs,
+    std::optional<system_data_ref> && system, std::optional<autopilot_data_ref> && autopilot,
+    std::optional<annunciator_data_ref> && annunciator,
+    std::optional<refresh_config> && refresh, std::optional<knob_config> && knobs
 ) noexcept :
-    name_(std::move(name)),
-    aircrafts_(std::move(aircrafts)),
-    models_(std::move(models)),
+    header_(std::move(header)),
+    data_refs_(std::move(data_refs)),
     system_(std::move(system)),
     autopilot_(std::move(autopilot)),
-    annunciator_(std::move(annunciator))
+    annunciator_(std::move(annunciator)),
+    refresh_(std::move(refresh)),
+    knobs_(std::move(knobs)),
+    mtime_(0),
+    size_(0)
 {}
 
-std::expected<profile::ptr_type, int>
-profile::from_yaml(const std::string & path) noexcept {
-    logger() << "Loading YAML File " << path;
-    YAML::Node node = YAML::LoadFile(path);
+std::expected<profile_header, int>
+profile_header::build(const YAML::Node & node) noexcept {
     if(!node["name"]) {
         logger() << "Profile does not include a name";
         return std::unexpected(0);
     }
+    if(node["name"].IsScalar() == false) {
+        log_warn() << "Invalid Profile name '" << node["name"] << "'";
+        return std::unexpected(0);
+    }
     
     std::vector<std::string> aircrafts;
     if(!node["aircrafts"] or node["aircrafts"].IsSequence() == false) {
@@ -256,7 +395,7 @@ profile::from_yaml(const std::string & path) noexcept {
     else {
         for(const auto & aircraft : node["aircrafts"]) {
             if(aircraft.Type() != YAML::NodeType::Scalar) {
-                logger() << "Invalid Aircraft '" << node << "'";
+                log_warn() << "Invalid Aircraft '" << node << "'";
                 continue;
             }
             aircrafts.emplace_back(aircraft.as<std::string>());
@@ -270,7 +409,7 @@ profile::from_yaml(const std::string & path) noexcept {
     std::vector<std::string> models;
     for(const auto & model : node["models"]) {
         if(model.Type() != YAML::NodeType::Scalar) {
-            logger() << "Invalid Model '" << node << "'";
+            log_warn() << "Invalid Model '" << node << "'";
             continue;
         }
         models.emplace_back(model.as<std::string>());
@@ -280,39 +419,273 @@ profile::from_yaml(const std::string & path) noexcept {
         return std::unexpected(0);
     }
 
-    logger() << "Reading System Configuration";
-    if(!node["system"]) return std::unexpected(0);
-    auto system = system_data_ref::build(node["system"]);
-    if(system.has_value() == false) return std::unexpected(0);
+    int32_t priority = 0;
+    if(node["priority"]) {
+        try {
+            priority = node["priority"].as<int32_t>();
+        }
+        catch(const YAML::Exception & e) {
+            log_warn() << "Invalid Priority '" << node["priority"] << "'";
+            return std::unexpected(0);
+        }
+    }
+
+    return profile_header(node["name"].as<std::string>(), std::move(aircrafts), std::move(models), priority);
+}
+
+static inline
+bool
+file_version(const std::filesystem::path & path, int64_t & mtime, uintmax_t & size) noexcept
+{
+    std::error_code err;
+    mtime = static_cast<int64_t>(std::filesystem::last_write_time(path, err).time_since_epoch().count());
+    if(err) return false;
+    size = std::filesystem::file_size(path, err);
+    return !err;
+}
+
+// Files being read by this thread, to catch profiles that extend themselves
+static thread_local std::vector<std::filesystem::path> loading;
+
+std::expected<profile::ptr_type, int>
+profile::build(const std::filesystem::path & path, bool fragment) noexcept {
+    if(std::find(loading.begin(), loading.end(), path) != loading.end()) {
+        log_error() << "Profile " << path << " extends itself";
+        return std::unexpected(0);
+    }
+    log_debug() << "Loading YAML File " << path;
+    // Taken before reading, so a concurrent edit makes the profile look stale
+    int64_t mtime = 0;
+    uintmax_t size = 0;
+    file_version(path, mtime, size);
+    // The file might have changed since its header was indexed
+    YAML::Node node;
+    try {
+        node = YAML::LoadFile(path.string());
+    }
+    catch(const YAML::Exception & e) {
+        log_error() << "Failed to parse " << path << ": " << e.what();
+        return std::unexpected(0);
+    }
+
+    std::expected<profile_header, int> header = std::unexpected(0);
+    fragment = fragment and !node["models"];
+    if(fragment) {
+        auto name = node["name"] and node["name"].IsScalar() ? node["name"].as<std::string>() : path.stem().string();
+        header = profile_header(std::move(name), {}, {});
+    }
+    else {
+        header = profile_header::build(node);
+    }
+    if(header.has_value() == false) return std::unexpected(0);
+
+    // DataRefs are only looked up once the profile is activated
+    auto data_refs = std::make_unique<data_ref_table>();
+
+    std::optional<system_data_ref> system;
+    if(node["system"]) {
+        logger() << "Reading System Configuration";
+        auto system_ret = system_data_ref::build(node["system"], *data_refs);
+        if(system_ret.has_value() == false) return std::unexpected(0);
+        system = std::move(system_ret.value());
+    }
 
-    logger() << "Reading Autopilot Configuration";
     std::optional<autopilot_data_ref> autopilot;
     if(node["autopilot"]) {
-        auto ap_ret = autopilot_data_ref::build(node["autopilot"]);
+        logger() << "Reading Autopilot Configuration";
+        auto ap_ret = autopilot_data_ref::build(node["autopilot"], *data_refs);
         if(ap_ret.has_value() == false) {
-            logger() << "Invalid Autopilot Configuration";
+            log_warn() << "Invalid Autopilot Configuration";
             return std::unexpected(0);
         }
         autopilot = std::move(ap_ret.value());
     }
 
-    logger() << "Reading Annunciator Configuration";
     std::optional<annunciator_data_ref> annunciator;
     if(node["annunciator"]) {
-        auto ann_ret = annunciator_data_ref::build(node["annunciator"]);
+        logger() << "Reading Annunciator Configuration";
+        auto ann_ret = annunciator_data_ref::build(node["annunciator"], *data_refs);
         if(ann_ret.has_value() == false) {
-            logger() << "Invalid Annunciator Configuration";
+            log_warn() << "Invalid Annunciator Configuration";
             return std::unexpected(0);
         }
         annunciator = std::move(ann_ret.value());
     }
 
-    return profile_ptr(new profile(
-        std::move(node["name"].as<std::string>()),
-        std::move(aircrafts),
-        std::move(models),
-        std::move(system.value()),
+    std::optional<refresh_config> refresh;
+    if(node["refresh"]) {
+        auto refresh_ret = refresh_config::build(node["refresh"]);
+        if(refresh_ret.has_value() == false) {
+            log_warn() << "Invalid Refresh Configuration";
+            return std::unexpected(0);
+        }
+        refresh = std::move(refresh_ret.value());
+    }
+
+    std::optional<knob_config> knobs;
+    if(node["knobs"]) {
+        auto knobs_ret = knob_config::build(node["knobs"]);
+        if(knobs_ret.has_value() == false) {
+            log_warn() << "Invalid Knob Configuration";
+            return std::unexpected(0);
+        }
+        knobs = std::move(knobs_ret.value());
+    }
+
+    logger() << "Found " << data_refs->size() << " DataRef(s)";
+    auto ret = profile_ptr(new profile(
+        std::move(header.value()),
+        std::move(data_refs),
+        std::move(system),
         std::move(autopilot),
-        std::move(annunciator)
+        std::move(annunciator),
+        std::move(refresh),
+        std::move(knobs)
     ));
-}
\ No newline at end of file
+    ret->mtime_ = mtime;
+    ret->size_ = size;
+
+    if(node["extends"]) {
+        if(node["extends"].IsScalar() == false) {
+            log_error() << "Invalid base profile in " << path;
+            return std::unexpected(0);
+        }
+        loading.emplace_back(path);
+        bool extended = ret->extend(node["extends"].as<std::string>(), path.parent_path());
+        loading.pop_back();
+        if(extended == false) return std::unexpected(0);
+    }
+
+    // Fragments may leave the system to the profiles that use them
+    if(fragment == false and ret->system_ == std::nullopt) {
+        bool found = false;
+        for(auto base = ret->base_; base and !found; base = base->base_) found = base->system_.has_value();
+        if(found == false) {
+            logger() << "Profile " << path << " does not include a system configuration";
+            return std::unexpected(0);
+        }
+    }
+    return ret;
+}
+
+bool
+profile::extend(std::string && name, const std::filesystem::path & directory) noexcept
+{
+    auto path = (directory / name).lexically_normal();
+    logger() << "Extending '" << this->name() << "' with " << path;
+    auto base = shared(path);
+    if(base.has_value() == false) {
+        log_error() << "Failed to load base profile " << path << " of '" << this->name() << "'";
+        return false;
+    }
+    this->base_ = std::move(base.value());
+    this->extends_ = std::move(name);
+    this->base_path_ = std::move(path);
+    return true;
+}
+
+std::expected<profile::ptr_type, int>
+profile::from_yaml(const std::string & path) noexcept {
+    trace_scope scope("profile::from_yaml");
+    return build(path, false);
+}
+
+// Profiles read by profile::shared. Entries only hold weak references, so
+// bases no profile uses any more are released
+struct shared_profile {
+    int64_t mtime_;
+    uintmax_t size_;
+    std::weak_ptr<profile> profile_;
+};
+
+std::expected<profile::ptr_type, int>
+profile::shared(const std::filesystem::path & path) noexcept {
+    // Bases are few and only read once, so loading them one at a time is
+    // fine. The mutex is recursive because bases may extend other bases
+    static std::recursive_mutex mutex;
+    static std::unordered_map<std::string, shared_profile> profiles;
+
+    std::error_code err;
+    auto key = std::filesystem::absolute(path, err).lexically_normal();
+    if(err) key = path.lexically_normal();
+
+    std::lock_guard lock(mutex);
+    int64_t mtime = 0;
+    uintmax_t size = 0;
+    if(file_version(key, mtime, size) == false) {
+        log_error() << "Failed to read " << key;
+        return std::unexpected(0);
+    }
+    auto it = profiles.find(key.string());
+    if(it != profiles.end() and it->second.mtime_ == mtime and it->second.size_ == size) {
+        if(auto ret = it->second.profile_.lock()) {
+            if(ret->is_current()) return ret;
+        }
+    }
+
+    auto ret = build(key, true);
+    if(ret.has_value() == false) return ret;
+    profiles.insert_or_assign(key.string(), shared_profile{ ret.value()->mtime_, ret.value()->size_, ret.value() });
+    return ret;
+}
+
+size_t
+profile::resolve_data_refs() noexcept
+{
+    size_t found = this->base_ ? this->base_->resolve_data_refs() : 0;
+    if(this->data_refs_->complete()) return found;
+
+    logger() << "Resolving DataRefs for '" << this->name() << "'";
+    found += this->data_refs_->resolve();
+    if(this->data_refs_->complete() == false) {
+        for(data_ref_table::key_type id = 0; id < this->data_refs_->size(); ++id) {
+            if(this->data_refs_->handle(id) != nullptr) continue;
+            logger() << "DataRef '" << this->data_refs_->key(id) << "' not found";
+        }
+    }
+    return found;
+}
+
+size_t
+profile::resolved() const noexcept
+{
+    auto ret = this->data_refs_->resolved();
+    return this->base_ ? ret + this->base_->resolved() : ret;
+}
+
+bool
+profile::complete() const noexcept
+{
+    if(this->data_refs_->complete() == false) return false;
+    return this->base_ == nullptr or this->base_->complete();
+}
+
+bool
+profile::resolve() noexcept
+{
+    if(this->compiled_ and this->complete() and this->compiled_.value() == this->resolved()) return true;
+    this->resolve_data_refs();
+
+    // Predicates are compiled against resolved handles, so they are only
+    // rebuilt when new DataRefs show up. Bases are shared, so they might
+    // have been resolved through another profile
+    auto resolved = this->resolved();
+    if(this->compiled_ != resolved) {
+        logger() << "Compiling LED Predicates";
+        this->leds_ = predicate_table::build(*this);
+        this->compiled_ = resolved;
+    }
+    return this->complete();
+}
+
+bool
+profile::is_current() const noexcept
+{
+    for(auto base = this; base->base_; base = base->base_.get()) {
+        int64_t mtime = 0;
+        uintmax_t size = 0;
+        if(file_version(base->base_path_, mtime, size) == false) return false;
+        if(mtime != base->base_->mtime_ or size != base->base_->size_) return false;
+    }
+    return true;
+}
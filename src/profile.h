@@ -8,37 +8,60 @@
 #ifndef PROFILE_H_
 #define PROFILE_H_
 
+#include "data-ref-table.h"
 #include "logger.h"
+#include "predicate.h"
 
 #include <XPLM/XPLMDataAccess.h>
 #include <yaml.h>
 
+#include <array>
 #include <expected>
+#include <filesystem>
+#include <iterator>
 #include <memory>
 #include <optional>
 #include <string>
+#include <variant>
 #include <vector>
 
 class base_data_ref {
 protected:
-    XPLMDataRef data_ref_;
+    const data_ref_table * table_;
+    data_ref_table::key_type key_;
     bool invert_;
     std::optional<size_t> index_;
 
     inline
-    base_data_ref(XPLMDataRef && data_ref, bool invert,
+    base_data_ref(const data_ref_table & table, data_ref_table::key_type key, bool invert,
             std::optional<size_t> index) noexcept :
-        data_ref_(std::move(data_ref)),
+        table_(&table),
+        key_(key),
         invert_(invert),
         index_(index)
     {}
+
+    // Null until the table the DataRef belongs to is resolved
+    inline
+    XPLMDataRef
+    handle() const noexcept { return this->table_->handle(this->key_); }
+
+    // Array DataRefs default to the first element, and scalars ignore indexes
+    inline
+    std::optional<size_t>
+    index() const noexcept {
+        if(this->table_->is_array(this->key_) == false) return std::nullopt;
+        return this->index_.value_or(0);
+    }
+
+    friend class profile_image;
 public:
     using ptr_type =std::unique_ptr<base_data_ref>;
 
     template<typename T>
     static
     std::expected<T, int>
-    build(const YAML::Node & node) noexcept;
+    build(const YAML::Node & node, data_ref_table & table) noexcept;
 
     base_data_ref(base_data_ref && other) noexcept = default;
 
@@ -47,19 +70,36 @@ public:
 
 #if defined(HCBRAVO_PROFILE_TESTS)
     inline
-    const XPLMDataRef &
-    data_ref() const noexcept { return this->data_ref_; }
+    XPLMDataRef
+    data_ref() const noexcept { return this->handle(); }
 #endif
 };
 
-class bool_data_ref : public base_data_ref {
+template<typename T>
+class data_ref;
+
+class profile_image;
+
+#include "profile-data-ref-impl.h"
+
+using float_data_ref = data_ref<float>;
+
+// A Bool, Int or Float predicate, held by value so the predicates of a
+// value_data_ref are laid out next to each other and checked without
+// virtual calls
+class bool_data_ref {
 public:
-    using ptr_type =std::unique_ptr<bool_data_ref>;
+    using variant_type = std::variant<::data_ref<bool>, ::data_ref<int>, ::data_ref<float>>;
+
+protected:
+    variant_type data_;
 
+    friend class profile_image;
+public:
+    template<typename T>
     inline
-    bool_data_ref(XPLMDataRef && data_ref, bool invert,
-            std::optional<size_t> index) noexcept :
-        base_data_ref(std::move(data_ref), invert, index)
+    bool_data_ref(::data_ref<T> && data) noexcept :
+        data_(std::in_place_type<::data_ref<T>>, std::move(data))
     {}
 
     bool_data_ref(bool_data_ref && other) noexcept = default;
@@ -68,39 +108,56 @@ public:
     operator=(bool_data_ref && other) noexcept = default;
 
     inline
-    virtual
-    ~bool_data_ref() noexcept {}
-
-    virtual
     bool
-    is_set() const noexcept = 0;
-};
-
-template<typename T>
-class data_ref;
+    is_set() const noexcept {
+        return std::visit([](const auto & data) { return data.is_set(); }, this->data_);
+    }
 
-#include "profile-data-ref-impl.h"
+    inline
+    void
+    compile(predicate_table & table, predicate_table::group_type group) const noexcept {
+        std::visit([&table, group](const auto & data) { data.compile(table, group); }, this->data_);
+    }
 
-using float_data_ref = data_ref<float>;
+#if defined(HCBRAVO_PROFILE_TESTS)
+    inline
+    XPLMDataRef
+    data_ref() const noexcept {
+        return std::visit([](const base_data_ref & data) { return data.data_ref(); }, this->data_);
+    }
+#endif
+};
 
 class value_data_ref {
 protected:
-    std::vector<bool_data_ref::ptr_type> data_;
+    std::vector<bool_data_ref> data_;
+
+    friend class profile_image;
 public:
-    value_data_ref(const YAML::Node & node) noexcept;
+    value_data_ref() noexcept = default;
+
+    value_data_ref(const YAML::Node & node, data_ref_table & table) noexcept;
 
     inline 
     bool
     is_set() const noexcept {
         for(const auto & data : this->data_ ) {
-            if(data->is_set()) return true;
+            if(data.is_set()) return true;
         }
         return false;
     }
 
+    inline
+    void
+    compile(predicate_table & table, predicate_table::group_type group) const noexcept {
+        for(const auto & data : this->data_ ) {
+            data.compile(table, group);
+        }
+    }
+
 #if defined(HCBRAVO_PROFILE_TESTS)
     inline
-    const std::vector<bool_data_ref::ptr_type> &
+    const std::vector<bool_data_ref> &
     data() const noexcept { return this->data_; }
 #endif
 
@@ -113,10 +170,14 @@ enum class airspeed_unit {
 
 class airspeed_data_ref {
 protected:
-    XPLMDataRef is_mach_;
+    const data_ref_table * table_;
+    data_ref_table::key_type is_mach_;
     data_ref<float> value_;
 
-    airspeed_data_ref(XPLMDataRef && is_mach, data_ref<float> && value) noexcept;
+    airspeed_data_ref(const data_ref_table & table, data_ref_table::key_type is_mach,
+        data_ref<float> && value) noexcept;
+
+    friend class profile_image;
 public:
 
     airspeed_data_ref(airspeed_data_ref && other) noexcept = default;
@@ -126,12 +187,14 @@ public:
 
     static
     std::expected<airspeed_data_ref, int>
-    build(const YAML::Node &) noexcept;
+    build(const YAML::Node &, data_ref_table & table) noexcept;
 
     inline
     airspeed_unit
     unit() const noexcept {
-        return XPLMGetDatai(this->is_mach_) ? airspeed_unit::Mach : airspeed_unit::Knots;
+        auto is_mach = this->table_->handle(this->is_mach_);
+        if(is_mach == nullptr) return airspeed_unit::Knots;
+        return XPLMGetDatai(is_mach) ? airspeed_unit::Mach : airspeed_unit::Knots;
     }
 
     inline
@@ -145,8 +208,8 @@ public:
     }
 #if defined(HCBRAVO_PROFILE_TESTS)
     inline
-    XPLMDataRef &
-    unit_data_ref() noexcept { return this->is_mach_; }
+    XPLMDataRef
+    unit_data_ref() const noexcept { return this->table_->handle(this->is_mach_); }
 #endif
 };
 
@@ -157,7 +220,12 @@ class autopilot_dial_data_ref {
     std::optional<float_data_ref> vs_;
     std::optional<float_data_ref> alt_;
 
-    autopilot_dial_data_ref(std::optional<airspeed_data_ref> && ias, const YAML::Node & node) noexcept;
+    autopilot_dial_data_ref(std::optional<airspeed_data_ref> && ias, const YAML::Node & node,
+        data_ref_table & table) noexcept;
+
+    autopilot_dial_data_ref() noexcept = default;
+
+    friend class profile_image;
 public:
 
     autopilot_dial_data_ref(autopilot_dial_data_ref && other) noexcept = default;
@@ -167,7 +235,7 @@ public:
 
     static
     std::expected<autopilot_dial_data_ref, int>
-    build(const YAML::Node & node) noexcept;
+    build(const YAML::Node & node, data_ref_table & table) noexcept;
 
     inline
     const std::optional<airspeed_data_ref> &
@@ -216,13 +284,17 @@ class autopilot_mode_data_ref {
     std::optional<value_data_ref> ias_;
     value_data_ref ap_;
 
-    autopilot_mode_data_ref(const YAML::Node & node) noexcept;
+    autopilot_mode_data_ref(const YAML::Node & node, data_ref_table & table) noexcept;
+
+    autopilot_mode_data_ref() noexcept = default;
 
+    friend class predicate_table;
+    friend class profile_image;
 public:
 
     static
     std::expected<autopilot_mode_data_ref, int>
-    build(const YAML::Node & node) noexcept;
+    build(const YAML::Node & node, data_ref_table & table) noexcept;
 
     inline
     std::optional<bool>
@@ -313,6 +385,8 @@ protected:
 
     autopilot_data_ref(autopilot_mode_data_ref && mode,
                        std::optional<autopilot_dial_data_ref> && dial) noexcept;
+
+    friend class profile_image;
 public:
 
     autopilot_data_ref(autopilot_data_ref && other) noexcept = default;
@@ -323,7 +397,7 @@ public:
 
     static
     std::expected<autopilot_data_ref, int>
-    build(const YAML::Node & node) noexcept;
+    build(const YAML::Node & node, data_ref_table & table) noexcept;
 
     inline
     const autopilot_mode_data_ref &
@@ -338,13 +412,17 @@ class system_data_ref {
     value_data_ref volts_;
     std::optional<value_data_ref> gear_;
 
-    system_data_ref(const YAML::Node & node) noexcept;
+    system_data_ref(const YAML::Node & node, data_ref_table & table) noexcept;
 
+    system_data_ref() noexcept = default;
+
+    friend class predicate_table;
+    friend class profile_image;
 public:
 
     static
     std::expected<system_data_ref, int>
-    build(const YAML::Node & node) noexcept;
+    build(const YAML::Node & node, data_ref_table & table) noexcept;
 
     inline 
     bool 
@@ -383,12 +461,17 @@ class annunciator_data_ref {
     std::optional<value_data_ref> volt_low_;
     std::optional<value_data_ref> door_open_;
 
-    annunciator_data_ref(const YAML::Node & node) noexcept;
+    annunciator_data_ref(const YAML::Node & node, data_ref_table & table) noexcept;
+
+    annunciator_data_ref() noexcept = default;
+
+    friend class predicate_table;
+    friend class profile_image;
 public:
 
     static
     std::expected<annunciator_data_ref, int>
-    build(const YAML::Node & node) noexcept;
+    build(const YAML::Node & node, data_ref_table & table) noexcept;
 
     inline 
     const std::optional<bool>
@@ -535,49 +618,296 @@ public:
 };
 
 
-class profile {
+class refresh_config {
+protected:
+    // Follows the X-Plane flight loop convention: negative values are frames
+    // and positive values are seconds
+    float interval_;
+    float max_;
+    float unpowered_;
+
+    friend class profile_image;
 public:
-    using ptr_type = std::shared_ptr<profile>;
+    inline
+    refresh_config() noexcept :
+        interval_(-1.0f),
+        max_(0.1f),
+        unpowered_(0.5f)
+    {}
+
+    static
+    std::expected<refresh_config, int>
+    build(const YAML::Node & node) noexcept;
+
+    // Interval used right after the LEDs change
+    inline
+    float
+    interval() const noexcept { return this->interval_; }
+
+    // Longest interval, in seconds, while the LEDs remain stable. Zero disables back-off
+    inline
+    float
+    max() const noexcept { return this->max_; }
+
+    // Interval, in seconds, while the aircraft has no electrical power
+    inline
+    float
+    unpowered() const noexcept { return this->unpowered_; }
+};
+
+// Step of an autopilot knob once it turns at rate detents per second or faster
+struct acceleration_stage {
+    float rate_;
+    float step_;
+};
+
+// Multi-stage acceleration of an autopilot knob, with stages sorted by rate
+class acceleration_curve {
+protected:
+    std::vector<acceleration_stage> stages_;
+
+    friend class profile_image;
+public:
+    acceleration_curve() noexcept = default;
+
+    acceleration_curve(std::vector<acceleration_stage> && stages) noexcept;
+
+    static
+    std::expected<acceleration_curve, int>
+    build(const YAML::Node & node) noexcept;
+
+    inline
+    const std::vector<acceleration_stage> &
+    stages() const noexcept { return this->stages_; }
+
+    // Step of the fastest stage the rate reaches. Slower rates, such as the
+    // zero rate of a single detent, use the step of the first stage
+    inline
+    float
+    step(float rate) const noexcept {
+        if(this->stages_.empty()) return 0.0f;
+        float ret = this->stages_.front().step_;
+        for(const auto & stage : this->stages_) {
+            if(rate < stage.rate_) break;
+            ret = stage.step_;
+        }
+        return ret;
+    }
+};
+
+// Acceleration of the autopilot knobs. Knobs without a curve keep the
+// plugin defaults
+class knob_config {
+public:
+    // In the order of the selector positions
+    static constexpr const char * names[] = { "alt", "vs", "hdg", "crs", "ias" };
+    static constexpr size_t count = std::size(names);
+
+protected:
+    // Seconds of past detents used to estimate how fast a knob turns
+    float window_;
+    std::array<std::optional<acceleration_curve>, count> curves_;
+
+    friend class profile_image;
+public:
+    inline
+    knob_config() noexcept :
+        window_(0.25f)
+    {}
+
+    static
+    std::expected<knob_config, int>
+    build(const YAML::Node & node) noexcept;
+
+    inline
+    float
+    window() const noexcept { return this->window_; }
+
+    inline
+    const std::optional<acceleration_curve> &
+    curve(size_t knob) const noexcept { return this->curves_[knob]; }
+};
+
+// Name and matching rules of a profile, which can be read without building
+// any of its DataRefs
+class profile_header {
 protected:
     std::string name_;
     std::vector<std::string> aircrafts_;
     std::vector<std::string> models_;
-    system_data_ref system_;
+    // Rules of profiles with a higher priority win over those of other profiles
+    int32_t priority_;
+
+public:
+    inline
+    profile_header(std::string && name, std::vector<std::string> && aircrafts,
+            std::vector<std::string> && models, int32_t priority = 0) noexcept :
+        name_(std::move(name)),
+        aircrafts_(std::move(aircrafts)),
+        models_(std::move(models)),
+        priority_(priority)
+    {}
+
+    profile_header(const profile_header & other) = default;
+
+    profile_header(profile_header && other) noexcept = default;
+
+    profile_header &
+    operator=(profile_header && other) noexcept = default;
+
+    static
+    std::expected<profile_header, int>
+    build(const YAML::Node & node) noexcept;
+
+    inline
+    const std::string &
+    name() const { return this->name_; }
+
+    inline
+    const std::vector<std::string> &
+    aircrafts() const { return this->aircrafts_; }
+
+    inline
+    const std::vector<std::string> &
+    models() const { return this->models_; }
+
+    inline
+    int32_t
+    priority() const { return this->priority_; }
+};
+
+// An aircraft profile.
+//
+// A profile may extend another profile file, or a fragment that only holds
+// some sections, and then stores nothing but the sections it overrides. Bases
+// are loaded through shared(), so every profile extending the same file
+// shares one immutable copy of it, along with its resolved DataRefs.
+class profile {
+public:
+    using ptr_type = std::shared_ptr<profile>;
+protected:
+    profile_header header_;
+    std::unique_ptr<data_ref_table> data_refs_;
+    std::optional<system_data_ref> system_;
     std::optional<autopilot_data_ref> autopilot_;
     std::optional<annunciator_data_ref> annunciator_;
+    std::optional<refresh_config> refresh_;
+    std::optional<knob_config> knobs_;
+    predicate_table leds_;
+    // Resolved DataRefs the LED predicates were compiled with
+    std::optional<size_t> compiled_;
+
+    // Profile this one extends, as named in the file and as found on disk
+    ptr_type base_;
+    std::string extends_;
+    std::filesystem::path base_path_;
+
+    // Version of the file the profile was read from, when read by shared()
+    int64_t mtime_;
+    uintmax_t size_;
+
+    friend class profile_image;
+
+    profile(profile_header && header, std::unique_ptr<data_ref_table> && data_refs,
+            std::optional<system_data_ref> && system, std::optional<autopilot_data_ref> && autopilot,
+            std::optional<annunciator_data_ref> && annunciator,
+            std::optional<refresh_config> && refresh, std::optional<knob_config> && knobs) noexcept;
+
+    // Files without models are fragments, which are only used as bases and
+    // need not define every compulsory section
+    static
+    std::expected<ptr_type, int>
+    build(const std::filesystem::path & path, bool fragment) noexcept;
+
+    // Loads the base named in a profile read from the given directory
+    bool
+    extend(std::string && name, const std::filesystem::path & directory) noexcept;
+
+    size_t
+    resolve_data_refs() noexcept;
+
+    size_t
+    resolved() const noexcept;
+
+    bool
+    complete() const noexcept;
 
-    profile(std::string && name, std::vector<std::string> && aircrafts,
-            std::vector<std::string> && models,
-            system_data_ref && system, std::optional<autopilot_data_ref> && autopilot,
-            std::optional<annunciator_data_ref> && annunciator) noexcept;
 public:
     static
     std::expected<ptr_type, int>
     from_yaml(const std::string & path) noexcept;
 
+    // Reads a profile other profiles extend. Files without models are taken
+    // as fragments, and the profile already read from a file is returned as
+    // long as neither it nor its bases changed since. Safe to call from any
+    // thread
+    static
+    std::expected<ptr_type, int>
+    shared(const std::filesystem::path & path) noexcept;
+
+    // Looks up the DataRefs of the profile and compiles its LED predicates.
+    // Must run on the sim thread once the aircraft is loaded. DataRefs found
+    // are kept, so later calls only retry the ones still missing. Returns
+    // whether every DataRef was found
+    bool
+    resolve() noexcept;
+
+    // Whether none of the files the profile extends changed since it was read
+    bool
+    is_current() const noexcept;
+
+    inline
+    const profile_header &
+    header() const { return this->header_; }
+
     inline
     const std::string &
-    name() const { return this->name_; }
+    name() const { return this->header_.name(); }
 
     inline
     const std::vector<std::string> &
-    aircrafts() const { return this->aircrafts_; }
+    aircrafts() const { return this->header_.aircrafts(); }
 
     inline
     const std::vector<std::string> &
-    models() const { return this->models_; }
+    models() const { return this->header_.models(); }
+
+    inline
+    const ptr_type &
+    base() const { return this->base_; }
 
     inline 
     const system_data_ref &
-    system() const { return this->system_; }
+    system() const { return this->system_ ? this->system_.value() : this->base_->system(); }
 
     inline 
     const std::optional<autopilot_data_ref> &
-    autopilot() const { return this->autopilot_; }
+    autopilot() const { return this->autopilot_ or !this->base_ ? this->autopilot_ : this->base_->autopilot(); }
 
     inline
     const std::optional<annunciator_data_ref> &
-    annunciator() const { return this->annunciator_; }
+    annunciator() const { return this->annunciator_ or !this->base_ ? this->annunciator_ : this->base_->annunciator(); }
+
+    inline
+    const refresh_config &
+    refresh() const {
+        static const refresh_config defaults;
+        if(this->refresh_) return this->refresh_.value();
+        return this->base_ ? this->base_->refresh() : defaults;
+    }
+
+    inline
+    const knob_config &
+    knobs() const {
+        static const knob_config defaults;
+        if(this->knobs_) return this->knobs_.value();
+        return this->base_ ? this->base_->knobs() : defaults;
+    }
+
+    // Empty until the profile is resolved
+    inline
+    const predicate_table &
+    leds() const { return this->leds_; }
 };
 
 using profile_ptr = profile::ptr_type;
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/scheduler.h
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include "profile.h"
+
+#include <algorithm>
+
+// Picks the next flight loop interval from the profile refresh configuration.
+//
+// The scheduler runs at the configured interval right after the LEDs change and
+// doubles the interval on every stable tick, up to the configured maximum.
+// All intervals follow the X-Plane convention: negative values are frames.
+class scheduler {
+protected:
+    refresh_config config_;
+    float current_;
+
+public:
+    inline
+    scheduler() noexcept :
+        current_(config_.interval())
+    {}
+
+    inline
+    void
+    reset(const refresh_config & config) noexcept {
+        this->config_ = config;
+        this->current_ = config.interval();
+    }
+
+    // Snaps back to the configured interval, e.g. after a knob command
+    inline
+    float
+    wake() noexcept {
+        this->current_ = this->config_.interval();
+        return this->current_;
+    }
+
+    inline
+    float
+    unpowered() noexcept {
+        this->current_ = this->config_.interval();
+        return this->config_.unpowered() > 0.0f ? this->config_.unpowered() : this->current_;
+    }
+
+    // Elapsed is the time, in seconds, since the previous tick
+    inline
+    float
+    next(bool changed, float elapsed) noexcept {
+        const auto base = this->config_.interval();
+        if(changed or this->config_.max() <= 0.0f) {
+            this->current_ = base;
+            return this->current_;
+        }
+
+        // While running every few frames, the elapsed time tells us how long those frames took
+        float seconds = 2.0f * (this->current_ < 0.0f ? elapsed : this->current_);
+        if(seconds <= 0.0f) return this->current_;
+        seconds = std::min(seconds, this->config_.max());
+        if(base > 0.0f) seconds = std::max(seconds, base);
+        this->current_ = seconds;
+        return this->current_;
+    }
+
+    inline
+    float
+    interval() const noexcept { return this->current_; }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/spsc-queue.h
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#ifndef SPSC_QUEUE_H_
+#define SPSC_QUEUE_H_
+
+#include <array>
+#include <atomic>
+
+#include <cstddef>
+
+// Bounded lock-free queue with a single producer and a single consumer.
+//
+// Each side owns one of the indexes, so pushing and popping never wait on
+// each other. Capacity must be a power of two.
+template<typename T, size_t Capacity>
+class spsc_queue {
+    static_assert(Capacity > 0 and (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+protected:
+    std::array<T, Capacity> items_;
+    // Kept apart so the producer and the consumer do not share a cache line
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+
+public:
+    inline
+    spsc_queue() noexcept :
+        head_(0),
+        tail_(0)
+    {}
+
+    // Producer side. Returns false, dropping the item, if the queue is full
+    inline
+    bool
+    push(const T & item) noexcept {
+        auto tail = this->tail_.load(std::memory_order_relaxed);
+        if(tail - this->head_.load(std::memory_order_acquire) == Capacity) return false;
+        this->items_[tail & (Capacity - 1)] = item;
+        this->tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false if the queue is empty
+    inline
+    bool
+    pop(T & item) noexcept {
+        auto head = this->head_.load(std::memory_order_relaxed);
+        if(head == this->tail_.load(std::memory_order_acquire)) return false;
+        item = this->items_[head & (Capacity - 1)];
+        this->head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    inline
+    bool
+    empty() const noexcept {
+        return this->head_.load(std::memory_order_acquire) == this->tail_.load(std::memory_order_acquire);
+    }
+};
+
+#endif
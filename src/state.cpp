@@ -10,22 +10,26 @@
 #include <XPLM/XPLMProcessing.h>
 #include <XPLM/XPLMUtilities.h>
 
+#include <algorithm>
 #include <expected>
 #include <filesystem>
 #include <memory>
 #include <string>
 #include <tuple>
+#include <vector>
 
 #include <hidapi.h>
 
 #include "led.h"
 #include "logger.h"
+#include "perf.h"
 #include "state.h"
+#include "trace.h"
 
 void
 state::error_handler(const char * msg) noexcept
 {
-    logger() << "Detected Error: " << msg;
+    log_error() << "Detected Error: " << msg;
 }
 
 void
@@ -35,18 +39,26 @@ state::menu_handler(void * _this, void * item) noexcept
     size_t id = reinterpret_cast<size_t>(item);
     switch(id) {
         case 0:
-            self->plane_ = std::nullopt;
             logger() << "Reloading Aircraft Profiles";
             self->reload();
-            logger() << "Setting Active Plane";
-            self->load_plane();
             break;
         case 1:
             logger() << "Reloading All Plugins";
             XPLMReloadPlugins();
             break;
+        case 2:
+            self->watch(self->is_watching() == false);
+            break;
+        case 3:
+            perf::enable(perf::enabled() == false);
+            logger() << (perf::enabled() ? "Enabled" : "Disabled") << " Performance Counters";
+            XPLMCheckMenuItem(self->menu_, self->perf_item_, perf::enabled() ? xplm_Menu_Checked : xplm_Menu_Unchecked);
+            break;
+        case 4:
+            self->dump_trace();
+            break;
         default:
-            logger() << "Unknown Menu ID #" << id;
+            log_warn() << "Unknown Menu ID #" << id;
             break;
     }
 }
@@ -56,59 +68,60 @@ state::flight_iteration(float call, float iter, int counter, void * _this) noexc
 {
     state * self = reinterpret_cast<state *>(_this);
     if(self == nullptr or self->plane_.has_value() == false) {
-        logger() << "No active plane detected. Stopping Flight Loop Refresh";
+        log_warn() << "No active plane detected. Stopping Flight Loop Refresh";
         return 0;
     }
-    const auto plane = self->plane_.value();
+    const auto & plane = self->plane_.value();
+    perf_timer timer(perf_id::flight_loop);
+    trace_scope scope("flight_iteration");
 
     led_mask mask;
-    const auto & system = plane->system();
-    if(system.volts() == false) return -1.0;
-
-    if(plane->autopilot().has_value()) {
-        const auto & ap = plane->autopilot().value().mode();
-        mask.update(LED_AP_HDG, ap.hdg());
-        mask.update(LED_AP_NAV, ap.nav());
-        mask.update(LED_AP_APR, ap.apr());
-        mask.update(LED_AP_REV, ap.rev());
-        mask.update(LED_AP_ALT, ap.alt());
-        mask.update(LED_AP_VS, ap.vs());
-        mask.update(LED_AP_IAS, ap.ias());
-        mask.update(LED_AP, ap.ap());
+    bool powered;
+    {
+        perf_timer timer(perf_id::evaluate);
+        powered = plane->leds().evaluate(mask);
+    }
+    if(powered == false) return self->scheduler_.unpowered();
+    bool changed;
+    {
+        perf_timer timer(perf_id::led_update);
+        changed = self->leds_.update(mask);
     }
 
-    if(system.gear().has_value()) {
-        bool status = system.gear().value();
-        mask.update(LED_LDG_L_GREEN, status);
-        mask.update(LED_LDG_L_RED, !status);
+    return self->scheduler_.next(changed, call);
+}
 
-        mask.update(LED_LDG_N_GREEN, status);
-        mask.update(LED_LDG_N_RED, !status);
-    
-        mask.update(LED_LDG_R_GREEN, status);
-        mask.update(LED_LDG_R_RED, !status);
-    }
+float
+state::input_iteration(float call, float iter, int counter, void * _this) noexcept
+{
+    state * self = reinterpret_cast<state *>(_this);
 
-    if(plane->annunciator().has_value()) {
-        const auto & ann = plane->annunciator().value();
-        mask.update(LED_ANC_MSTR_WARN, ann.master_warn());
-        mask.update(LED_ANC_ENG_FIRE, ann.eng_fire());
-        mask.update(LED_ANC_OIL, ann.oil_low());
-        mask.update(LED_ANC_FUEL, ann.fuel_low());
-        mask.update(LED_ANC_ANTI_ICE, ann.anti_ice());
-        mask.update(LED_ANC_STARTER, ann.starter());
-        mask.update(LED_ANC_APU, ann.apu());
-        mask.update(LED_ANC_MSTR_CTN, ann.master_caution());
-        mask.update(LED_ANC_VACUUM, ann.vacuum_low());
-        mask.update(LED_ANC_HYD, ann.hydro_low());
-        mask.update(LED_ANC_AUX_FUEL, ann.aux_fuel());
-        mask.update(LED_ANC_PRK_BRK, ann.parking_brake());
-        mask.update(LED_ANC_VOLTS, ann.volt_low());
-        mask.update(LED_ANC_DOOR, ann.door_open());
+    input_event event;
+    while(self->input_.pop(event)) {
+        switch(event.kind_) {
+            case input_event::kind::select:
+                self->cmds_->select(static_cast<selector>(event.value_));
+                break;
+            case input_event::kind::inc:
+                self->cmds_->turn(commands::dir::inc);
+                break;
+            case input_event::kind::dec:
+                self->cmds_->turn(commands::dir::dec);
+                break;
+            case input_event::kind::button:
+                // The button itself is bound in X-Plane; its LED follows sooner
+                self->wake();
+                break;
+        }
     }
-    self->leds_.update(mask);
-
-    return -1.0;
+    // Turns read this frame are written right away
+    self->cmds_->flush();
+
+    auto errors = self->input_.errors();
+    if(errors > 0) log_error() << "Failed to read HID input (" << errors << " time(s))";
+    auto dropped = self->input_.dropped();
+    if(dropped > 0) log_warn() << "Dropped " << dropped << " HID input event(s)";
+    return -1.0f;
 }
 
 std::expected<state::ptr_type, int>
@@ -119,20 +132,24 @@ state::init() noexcept
     logger() << "Initializing HID";
     int res = hid_init();
     if(res < 0) {
-        logger() << "Failed to initialize HID";
+        log_error() << "Failed to initialize HID";
         return std::unexpected(0);
     }
     st->hid_ = hid_open(0x294b, 0x1901, nullptr);
     if(st->hid_ == nullptr) {
-        logger() << "Failed to Open HoneyComb Bravo Quadrant";
+        log_error() << "Failed to Open HoneyComb Bravo Quadrant";
         return std::unexpected(0);
     }
     logger() << "HoneyComb Bravo Throttle Detected";
-    st->leds_.hid_ = st->hid_;
+    st->leds_.attach(st->hid_, st->hid_lock_);
+#if defined(HCBRAVO_ASYNC_HID)
+    logger() << "Starting LED Writer Thread";
+    st->leds_.start_writer();
+#endif
 
     auto commands = commands::init(*st);
     if(commands.has_value() == false) {
-        logger() << "Failed to Register HoneyComb Bravo Commands";
+        log_error() << "Failed to Register HoneyComb Bravo Commands";
         return std::unexpected(commands.error());
     }
     st->cmds_ = std::move(commands.value());
@@ -144,13 +161,36 @@ state::init() noexcept
     int item = XPLMAppendMenuItem(XPLMFindPluginsMenu(), "HoneyComb Bravo", nullptr, 1);
     st->menu_ = XPLMCreateMenu("HoneyComb Bravo", XPLMFindPluginsMenu(), item, &state::menu_handler, st.get());
     if(XPLMAppendMenuItem(st->menu_, "Reload Aircraft Profiles", reinterpret_cast<void *>(0), 0) < 0) {
-        logger() << "Failed to Create HoneyComb Bravo Menu (Reload Aircraft Profiles)";
+        log_error() << "Failed to Create HoneyComb Bravo Menu (Reload Aircraft Profiles)";
         return std::unexpected(0);
     }
     if(XPLMAppendMenuItem(st->menu_, "Reload All Plugins", reinterpret_cast<void *>(1), 0) < 0) {
-        logger() << "Failed to Create HoneyComb Bravo Menu (Reload All Plugins)";
+        log_error() << "Failed to Create HoneyComb Bravo Menu (Reload All Plugins)";
         return std::unexpected(0);
     }
+    st->watch_item_ = XPLMAppendMenuItem(st->menu_, "Watch Aircraft Profiles", reinterpret_cast<void *>(2), 0);
+    if(st->watch_item_ < 0) {
+        log_error() << "Failed to Create HoneyComb Bravo Menu (Watch Aircraft Profiles)";
+        return std::unexpected(0);
+    }
+    XPLMCheckMenuItem(st->menu_, st->watch_item_, xplm_Menu_Unchecked);
+
+#if defined(HCBRAVO_PERF)
+    st->perf_item_ = XPLMAppendMenuItem(st->menu_, "Performance Counters", reinterpret_cast<void *>(3), 0);
+    if(st->perf_item_ < 0) {
+        log_error() << "Failed to Create HoneyComb Bravo Menu (Performance Counters)";
+        return std::unexpected(0);
+    }
+    XPLMCheckMenuItem(st->menu_, st->perf_item_, xplm_Menu_Unchecked);
+    perf::publish();
+#endif
+
+#if defined(HCBRAVO_TRACE)
+    if(XPLMAppendMenuItem(st->menu_, "Dump Trace", reinterpret_cast<void *>(4), 0) < 0) {
+        log_error() << "Failed to Create HoneyComb Bravo Menu (Dump Trace)";
+        return std::unexpected(0);
+    }
+#endif
 
     logger() << "Creating Flight Loop Logic";
     XPLMCreateFlightLoop_t fl_params = {
@@ -161,132 +201,337 @@ state::init() noexcept
     };
     st->flight_loop_ = XPLMCreateFlightLoop(&fl_params);
     if(st->flight_loop_ == nullptr) {
-        logger() << "Failed to Create Flight Loop";
+        log_error() << "Failed to Create Flight Loop";
         return std::unexpected(0);
     }
 
+    XPLMCreateFlightLoop_t reload_params = {
+        .structSize = sizeof(XPLMCreateFlightLoop_t),
+        .phase = xplm_FlightLoop_Phase_BeforeFlightModel,
+        .callbackFunc = reload_iteration,
+        .refcon = st.get(),
+    };
+    st->reload_loop_ = XPLMCreateFlightLoop(&reload_params);
+    if(st->reload_loop_ == nullptr) {
+        log_error() << "Failed to Create Reload Flight Loop";
+        return std::unexpected(0);
+    }
+
+#if defined(HCBRAVO_HID_INPUT)
+    logger() << "Starting HID Input Reader Thread";
+    XPLMCreateFlightLoop_t input_params = {
+        .structSize = sizeof(XPLMCreateFlightLoop_t),
+        .phase = xplm_FlightLoop_Phase_BeforeFlightModel,
+        .callbackFunc = input_iteration,
+        .refcon = st.get(),
+    };
+    st->input_loop_ = XPLMCreateFlightLoop(&input_params);
+    if(st->input_loop_ == nullptr) {
+        log_error() << "Failed to Create Input Flight Loop";
+        return std::unexpected(0);
+    }
+    st->input_.start(st->hid_, st->hid_lock_);
+    st->cmds_->set_direct(true);
+    XPLMScheduleFlightLoop(st->input_loop_, -1.0f, 1);
+#endif
+
+    st->reload();
+
     return st;
 }
 
-static const size_t FILES_PATH_SIZE = 64;
-static const size_t FILES_BUFFER_SIZE = 4096;
-static const size_t FILES_INDEX_SIZE = FILES_BUFFER_SIZE / FILES_PATH_SIZE;
-static char files_buffer[FILES_BUFFER_SIZE];
-static char * files_indexes[FILES_INDEX_SIZE];
+// Seconds between checks for profiles changed on disk
+static const float watch_interval = 1.0f;
 
 static const char * plane_icao_label_ = "sim/aircraft/view/acf_ICAO";
 static const char * plane_name_label_ = "sim/aircraft/view/acf_ui_name";
 
 state::state() noexcept :
     hid_(nullptr),
+    input_loop_(nullptr),
     menu_(nullptr),
+    watch_item_(-1),
+    perf_item_(-1),
     cmds_(nullptr),
+    catalog_(std::make_shared<catalog>()),
+    loaded_(nullptr),
+    loader_done_(false),
+    reloading_(false),
+    patching_(false),
+    reload_loop_(nullptr),
+    watcher_(nullptr),
     plane_icao_data_ref_(
         XPLMFindDataRef(plane_icao_label_)
     ),
     plane_name_data_ref_(
         XPLMFindDataRef(plane_name_label_)
     ),
-    plane_(std::nullopt)
+    plane_entry_(std::nullopt),
+    plane_(std::nullopt),
+    flight_loop_(nullptr)
+{}
+
+std::filesystem::path
+state::config_path() noexcept
+{
+    auto id = XPLMGetMyID();
+    static char path[256];
+    XPLMGetPluginInfo(id, nullptr, path, nullptr, nullptr);
+    XPLMExtractFileAndPath(path);
+    return std::filesystem::absolute(std::string(path) + "/../conf");
+}
+
+// Parses the profile of the aircraft on the loader, so binding it on the sim
+// thread only looks up its DataRefs
+static
+void
+preload(const catalog & cat, const std::string & aircraft, const std::string & model) noexcept
 {
-    memset(&this->leds_, 0, sizeof(led_state));
-    this->reload();
+    auto match = cat.match_aircraft(aircraft);
+    if(!match) match = cat.match_model(model);
+    if(match) match->entry_->load();
+}
+
+template<typename F>
+void
+state::start_loader(F && build) noexcept
+{
+    // The previous loader already handed over its profiles
+    if(this->loader_.joinable()) this->loader_.join();
+    this->reloading_ = true;
+    this->loader_done_.store(false, std::memory_order_relaxed);
+    this->loader_ = std::thread([this, build = std::forward<F>(build)]() {
+        perf_timer timer(perf_id::reload);
+        trace::name_thread("Profile Loader");
+        trace_scope scope("catalog load");
+        std::expected<catalog, int> ret = build();
+        if(ret.has_value()) {
+            this->loaded_.store(new catalog(std::move(ret.value())), std::memory_order_release);
+        }
+        else {
+            log_error() << "Failed to load plugin configuration";
+        }
+        this->loader_done_.store(true, std::memory_order_release);
+    });
+    XPLMScheduleFlightLoop(this->reload_loop_, -1.0f, 1);
 }
 
 void
 state::reload() noexcept
 {
-    if(profile_aircraft_map_.empty() == false) { profile_aircraft_map_.clear(); }
-    if(profile_model_map_.empty() == false) { profile_model_map_.clear(); }
+    trace_scope scope("state::reload");
+    if(this->reloading_) {
+        logger() << "Aircraft Profiles are already being reloaded";
+        return;
+    }
 
     logger() << "Reading Plugin Configuration Files";
-    auto id = XPLMGetMyID();
-    static char path[256];
-    XPLMGetPluginInfo(id, nullptr, path, nullptr, nullptr);
-    XPLMExtractFileAndPath(path);
-    auto config_file_path = std::filesystem::absolute(std::string(path) + "/../conf");
-    logger() << "Reading Configurations from " << config_file_path;
-    int index = 0;
-    int total_conf_files = 0;
-    do {
-        int file_count = 0;
-        XPLMGetDirectoryContents(
-            config_file_path.string().c_str(),  index, files_buffer, FILES_BUFFER_SIZE,
-            files_indexes, FILES_INDEX_SIZE, &total_conf_files, &file_count
-        );
-        logger() << "Read " << (index + file_count) << " file(s) from " << total_conf_files << " file(s)";
-        for(auto n = 0; n < file_count; ++n) {
-            auto config_file = config_file_path / std::string(files_indexes[n]);
-            logger() << "Found " << config_file << " in configuration file ( " << config_file.extension() << ")";
-            if(config_file.extension() != ".yaml") continue;
-            logger() << "Reading " << config_file;
-            auto prof = profile::from_yaml(config_file.string());
-            if(prof.has_value()) {
-                for(const auto &aircraft : prof.value()->aircrafts()) {
-                    auto ret = profile_aircraft_map_.emplace(aircraft, prof.value());
-                    if(ret.second == false) {
-                        logger() << "Not using '" << prof.value()->name() << "' for '" << aircraft 
-                                 << "' because another profile already exists";
-                    }
-                    else {
-                        logger() << "Using '" << prof.value()->name() << "' for '" << aircraft << "'";
-                    }
-                }
-                for(const auto &model : prof.value()->models()) {
-                    auto ret = profile_model_map_.emplace(model, prof.value());
-                    if(ret.second == false) {
-                        logger() << "Not using '" << prof.value()->name() << "' for ICAO '" << model 
-                                 << "' because another profile already exists";
-                    }
-                    else {
-                        logger() << "Using '" << prof.value()->name() << "' for ICAO '" << model << "'";
-                    }
-                }
-            }
+    auto directory = config_path();
+    std::shared_ptr<const catalog> previous = this->catalog_;
+    this->patching_ = false;
+    auto [aircraft, model] = this->plane_names();
+    this->start_loader([directory, previous, aircraft, model]() -> std::expected<catalog, int> {
+        // Profiles whose files did not change are carried over as they are,
+        // and the rest are only parsed once an aircraft needs them
+        auto ret = catalog::load(directory, previous.get());
+        if(ret.has_value()) preload(ret.value(), aircraft, model);
+        return ret;
+    });
+}
+
+void
+state::patch(std::vector<std::string> && files) noexcept
+{
+    // Nothing to patch until the directory was loaded once
+    if(this->catalog_->directory() != this->watcher_->directory()) {
+        this->reload();
+        return;
+    }
+
+    logger() << "Reloading " << files.size() << " changed Aircraft Profile(s)";
+    std::shared_ptr<const catalog> previous = this->catalog_;
+    this->patching_ = true;
+    auto [aircraft, model] = this->plane_names();
+    this->start_loader([previous, files = std::move(files), aircraft, model]() -> std::expected<catalog, int> {
+        // The copy shares every entry, so unchanged profiles are not parsed
+        // again. Edited ones are, so their errors show up right away
+        catalog ret(*previous);
+        ret.patch(files);
+        ret.parse(previous.get());
+        preload(ret, aircraft, model);
+        return ret;
+    });
+}
+
+void
+state::watch(bool enable) noexcept
+{
+    if(enable == this->is_watching()) return;
+
+    if(enable) {
+        auto directory = config_path();
+        auto ret = std::make_unique<watcher>(directory);
+        if(ret->start() == false) {
+            log_error() << "Failed to watch " << directory;
+            return;
         }
-        index += file_count;
-    } while(index != total_conf_files);
-    logger() << "Done loading plugin configuration";
+        logger() << "Watching " << directory << (ret->is_notified() ? " for changes" : " by polling for changes");
+        this->watcher_ = std::move(ret);
+        if(this->reloading_ == false) XPLMScheduleFlightLoop(this->reload_loop_, watch_interval, 1);
+    }
+    else {
+        this->watcher_.reset();
+        logger() << "Stopped watching Aircraft Profiles";
+    }
+    XPLMCheckMenuItem(this->menu_, this->watch_item_, this->is_watching() ? xplm_Menu_Checked : xplm_Menu_Unchecked);
+}
+
+float
+state::reload_iteration(float call, float iter, int counter, void * _this) noexcept
+{
+    state * self = reinterpret_cast<state *>(_this);
+
+    if(self->reloading_) {
+        if(self->loader_done_.load(std::memory_order_acquire) == false) return -1.0f;
+
+        self->loader_.join();
+        self->reloading_ = false;
+        std::unique_ptr<catalog> loaded(self->loaded_.exchange(nullptr, std::memory_order_acquire));
+        if(loaded) {
+            self->catalog_ = std::move(loaded);
+            logger() << "Done loading plugin configuration";
+            self->rebind();
+        }
+        else {
+            logger() << "Keeping the current Aircraft Profiles";
+        }
+    }
+
+    if(self->watcher_ == nullptr) return 0;
+    auto changes = self->watcher_->changes();
+    if(changes.empty()) return watch_interval;
+    self->patch(std::move(changes));
+    return -1.0f;
+}
+
+void
+state::rebind() noexcept
+{
+    perf_timer timer(perf_id::rebind);
+    // Only DataRef resolution for the active aircraft happens on the sim thread
+    if(this->patching_ == false) {
+        logger() << "Setting Active Plane";
+        this->plane_ = std::nullopt;
+        this->load_plane();
+        return;
+    }
+
+    // Patched catalogs keep the entries of unchanged files, so the active
+    // profile only changes if its file, or one taking precedence, changed
+    auto entry = this->find_plane();
+    if(entry == this->plane_entry_) return;
+    if(entry) {
+        logger() << "Switching to profile '" << entry.value()->header().name() << "'";
+        this->plane_ = std::nullopt;
+        if(this->enable_plane(entry.value())) return;
+    }
+    this->unload_plane();
 }
 
 bool
-state::load_plane() noexcept
+state::enable_plane(const profile_entry::ptr_type & entry) noexcept
+{
+    // Profiles are only parsed once an aircraft needs them
+    auto profile = entry->load();
+    if(profile.has_value() == false) {
+        log_error() << "Failed to load profile '" << entry->header().name() << "' from " << entry->path();
+        return false;
+    }
+    // DataRefs owned by the aircraft exist once it is loaded, so this is the
+    // first time they can be looked up
+    if(profile.value()->resolve() == false) {
+        log_warn() << "Some DataRefs of '" << entry->header().name() << "' are missing";
+    }
+    plane_entry_.emplace(entry);
+    plane_.emplace(profile.value());
+    scheduler_.reset(profile.value()->refresh());
+    XPLMScheduleFlightLoop(this->flight_loop_, scheduler_.interval(), 1);
+    return true;
+}
+
+std::pair<std::string, std::string>
+state::plane_names() noexcept
+{
+    char icao_name[64];
+    char ui_name[256];
+    int ret = XPLMGetDatab(plane_icao_data_ref_, icao_name, 0, 63);
+    icao_name[std::max(ret, 0)] = '\0';
+    ret = XPLMGetDatab(plane_name_data_ref_, ui_name, 0, 255);
+    ui_name[std::max(ret, 0)] = '\0';
+    return { ui_name, icao_name };
+}
+
+std::optional<profile_entry::ptr_type>
+state::find_plane() noexcept
 {
-    static char icao_name[64];
-    static char ui_name[256];
-    int ret = XPLMGetDatab(plane_icao_data_ref_, icao_name, 0, 64);
-    if(ret < 64) icao_name[ret] = '\0';
-    ret = XPLMGetDatab(plane_name_data_ref_, ui_name, 0, 256);
-    if(ret < 256) ui_name[ret] = '\0';
+    auto [ui_name, icao_name] = this->plane_names();
     logger() << "Aircraft '" << ui_name << "' (" << icao_name << ")";
 
     // First try to get a match for the specific Aircraft
-    auto profile = profile_aircraft_map_.find(ui_name);
-    if(profile != profile_aircraft_map_.end()) {
-        logger() << "Enabling profile '" << profile->first << "' for '" << ui_name << "'";
-        plane_.emplace(profile->second);
-        XPLMScheduleFlightLoop(this->flight_loop_, -1.0, 1);
-        return true;
+    auto match = catalog_->match_aircraft(ui_name);
+    if(match) {
+        logger() << "Using profile '" << match->entry_->header().name() << "' for '" << ui_name << "' ("
+                 << match_index::name(match->rule_.kind_) << " rule '" << match->rule_.text_
+                 << "', priority " << match->rule_.priority_ << ")";
+        return match->entry_;
     }
 
-    logger() << "Cannot find a profile for '" << ui_name 
+    log_warn() << "Cannot find a profile for '" << ui_name 
              << "'. Falling back to profile for ICAO '" << icao_name << "'";
-    profile = profile_model_map_.find(icao_name);
-    if(profile != profile_model_map_.end()) {
-        logger() << "Enabling profile '" << profile->first << "' for ICAO '" << icao_name << "'";
-        plane_.emplace(profile->second);
-        XPLMScheduleFlightLoop(this->flight_loop_, -1.0, 1);
-        return true;
+    match = catalog_->match_model(icao_name);
+    if(match) {
+        logger() << "Using profile '" << match->entry_->header().name() << "' for ICAO '" << icao_name << "' ("
+                 << match_index::name(match->rule_.kind_) << " rule '" << match->rule_.text_
+                 << "', priority " << match->rule_.priority_ << ")";
+        return match->entry_;
     }
 
-    logger() << "Profile not found for aircraft '" << ui_name << "' (" << icao_name << ")";
-    return false;
+    log_warn() << "Profile not found for aircraft '" << ui_name << "' (" << icao_name << ")";
+    return std::nullopt;
 }
 
+bool
+state::load_plane() noexcept
+{
+    trace_scope scope("state::load_plane");
+    auto entry = this->find_plane();
+    if(!entry) return false;
+    return this->enable_plane(entry.value());
+}
+
+
+void
+state::dump_trace() noexcept
+{
+#if defined(HCBRAVO_TRACE)
+    // X-Plane writes Log.txt to its own folder
+    char path[512];
+    XPLMGetSystemPath(path);
+    trace::dump(std::filesystem::path(path) / "HCBravo-Trace.json");
+#endif
+}
+
+void
+state::wake() noexcept
+{
+    if(this->plane_.has_value() == false or this->flight_loop_ == nullptr) return;
+    XPLMScheduleFlightLoop(this->flight_loop_, this->scheduler_.wake(), 1);
+}
 
 void
 state::unload_plane() noexcept
 {
+    this->plane_entry_ = std::nullopt;
     this->plane_ = std::nullopt;
 
     // Turn off all lights
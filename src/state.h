@@ -12,30 +12,58 @@
 #include <XPLM/XPLMMenus.h>
 #include <XPLM/XPLMProcessing.h>
 
+#include <atomic>
 #include <expected>
+#include <filesystem>
+#include <memory>
 #include <optional>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <hidapi.h>
 
+#include "catalog.h"
+#include "hid-lock.h"
+#include "input.h"
 #include "knob.h"
 #include "led.h"
+#include "logger.h"
+#include "perf.h"
 #include "profile.h"
+#include "scheduler.h"
+#include "trace.h"
+#include "watcher.h"
 
 class state {
     hid_device * hid_;
+    hid_lock hid_lock_;
     led_state leds_;
+    input_reader input_;
+    XPLMFlightLoopID input_loop_;
     XPLMMenuID menu_;
+    int watch_item_;
+    int perf_item_;
     commands::ptr_type cmds_;
 
-    using profile_map_type = std::unordered_map<std::string, std::shared_ptr<profile>>;
-    profile_map_type profile_aircraft_map_;
-    profile_map_type profile_model_map_;
+    // Only used from the sim thread. Reloads build a new catalog in the
+    // background and hand it over through loaded_
+    std::shared_ptr<catalog> catalog_;
+    std::atomic<catalog *> loaded_;
+    std::atomic<bool> loader_done_;
+    std::thread loader_;
+    bool reloading_;
+    bool patching_;
+    XPLMFlightLoopID reload_loop_;
+    std::unique_ptr<watcher> watcher_;
     XPLMDataRef plane_icao_data_ref_;
     XPLMDataRef plane_name_data_ref_;
+    std::optional<profile_entry::ptr_type> plane_entry_;
     std::optional<profile::ptr_type> plane_;
 
     XPLMFlightLoopID flight_loop_;
+    scheduler scheduler_;
 
     state() noexcept;
 
@@ -47,10 +75,46 @@ class state {
     void
     menu_handler(void * menu, void * item) noexcept;
 
+    static
+    std::filesystem::path
+    config_path() noexcept;
+
+    // Hands a catalog built by the function to the sim thread, from a
+    // background thread
+    template<typename F>
+    void
+    start_loader(F && build) noexcept;
+
+    // Re-reads only the profiles the watcher reported as changed
+    void
+    patch(std::vector<std::string> && files) noexcept;
+
+    // UI name and ICAO model of the loaded aircraft
+    std::pair<std::string, std::string>
+    plane_names() noexcept;
+
+    std::optional<profile_entry::ptr_type>
+    find_plane() noexcept;
+
+    // Re-enables the active aircraft with the catalog that was just loaded
+    void
+    rebind() noexcept;
+
+    bool
+    enable_plane(const profile_entry::ptr_type & entry) noexcept;
+
     static
     float
     flight_iteration(float last_call, float last_iter, int counter, void * ref) noexcept;
 
+    static
+    float
+    input_iteration(float last_call, float last_iter, int counter, void * ref) noexcept;
+
+    static
+    float
+    reload_iteration(float last_call, float last_iter, int counter, void * ref) noexcept;
+
 public:
     using ptr_type = std::unique_ptr<state>;
 
@@ -58,8 +122,16 @@ public:
 
     inline
     ~state() {
+        perf::unpublish();
+        this->watcher_.reset();
+        if(this->loader_.joinable()) this->loader_.join();
+        delete this->loaded_.exchange(nullptr);
+        if(this->reload_loop_ != nullptr) XPLMDestroyFlightLoop(this->reload_loop_);
         if(this->flight_loop_ != nullptr) XPLMDestroyFlightLoop(this->flight_loop_);
+        if(this->input_loop_ != nullptr) XPLMDestroyFlightLoop(this->input_loop_);
+        this->input_.stop();
         unload_plane();
+        this->leds_.stop_writer();
         if(this->hid_ != nullptr) hid_close(this->hid_);
     }
 
@@ -67,21 +139,56 @@ public:
     std::expected<state::ptr_type, int>
     init() noexcept;
 
+    // Reads the profiles in a background thread. The new profiles are
+    // published, and the active aircraft reloaded, from the sim thread once
+    // they are ready
     void
     reload() noexcept;
 
+    // Watches the configuration directory and reloads the profiles that
+    // change, leaving every other profile untouched
+    void
+    watch(bool enable) noexcept;
+
+    inline
+    bool
+    is_watching() const noexcept { return static_cast<bool>(this->watcher_); }
+
     bool
     load_plane() noexcept;
 
     void
     unload_plane() noexcept;
 
+    // Brings the LED refresh back to the profile interval, e.g. after a knob command
+    void
+    wake() noexcept;
+
+    // Writes the trace ring next to Log.txt
+    void
+    dump_trace() noexcept;
+
     inline
     const std::optional<profile::ptr_type> &
     active_plane() const noexcept {
         return this->plane_;
     }
 
+#if defined(HCBRAVO_KNOB_TESTS)
+    inline
+    commands &
+    knobs() noexcept { return *this->cmds_; }
+#endif
+
+#if defined(HCBRAVO_STATE_TESTS)
+    // Catalog built by a finished loader, until the sim thread takes it over
+    inline
+    const catalog *
+    loaded() const noexcept {
+        if(this->loader_done_.load(std::memory_order_acquire) == false) return nullptr;
+        return this->loaded_.load(std::memory_order_acquire);
+    }
+#endif
 };
 
 
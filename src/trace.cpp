@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/trace.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "logger.h"
+
+#if defined(HCBRAVO_TRACE)
+
+std::vector<trace::event>
+trace::snapshot() noexcept
+{
+    std::vector<event> ret;
+    auto head = head_.load(std::memory_order_acquire);
+    auto first = head > capacity ? head - capacity : 0;
+    ret.reserve(head - first);
+
+    for(auto n = first; n < head; ++n) {
+        auto & slot = ring_[n % capacity];
+        if(slot.seq_.load(std::memory_order_acquire) != n + 1) continue;
+        event e;
+        e.name_ = slot.name_.load(std::memory_order_relaxed);
+        e.time_ = slot.time_.load(std::memory_order_relaxed);
+        e.thread_ = slot.thread_.load(std::memory_order_relaxed);
+        e.phase_ = slot.phase_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // Overwritten while being read
+        if(slot.seq_.load(std::memory_order_relaxed) != n + 1) continue;
+        ret.emplace_back(e);
+    }
+
+    // Threads reserve slots and read the clock in either order
+    std::stable_sort(ret.begin(), ret.end(), [](const event & a, const event & b) { return a.time_ < b.time_; });
+    return ret;
+}
+
+static
+void
+write_string(std::ostream & out, const char * value)
+{
+    out << '"';
+    for(const char * c = value; *c != '\0'; ++c) {
+        if(*c == '"' or *c == '\\') out << '\\' << *c;
+        else if(static_cast<unsigned char>(*c) < 0x20) out << ' ';
+        else out << *c;
+    }
+    out << '"';
+}
+
+bool
+trace::dump(const std::filesystem::path & path) noexcept
+{
+    auto events = snapshot();
+
+    std::ofstream out(path, std::ios::trunc);
+    if(out.is_open() == false) {
+        log_error() << "Failed to open " << path;
+        return false;
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    const char * separator = "\n";
+    auto threads = std::min<uint32_t>(threads_.load(std::memory_order_relaxed), max_threads);
+    for(uint32_t id = 0; id < threads; ++id) {
+        auto name = thread_names_[id].load(std::memory_order_relaxed);
+        if(name == nullptr) continue;
+        out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << id << ",\"args\":{\"name\":";
+        write_string(out, name);
+        out << "}}";
+        separator = ",\n";
+    }
+
+    // The oldest events may have lost their begin event to the ring wrapping
+    std::vector<size_t> open(threads_.load(std::memory_order_relaxed), 0);
+    char time[32];
+    size_t written = 0;
+    for(const auto & e : events) {
+        if(e.thread_ >= open.size()) open.resize(e.thread_ + 1, 0);
+        if(e.phase_ == 'B') ++open[e.thread_];
+        else if(open[e.thread_] == 0) continue;
+        else --open[e.thread_];
+
+        std::snprintf(time, sizeof(time), "%.3f", static_cast<double>(e.time_) / 1e3);
+        out << separator << "{\"name\":";
+        write_string(out, e.name_);
+        out << ",\"ph\":\"" << e.phase_ << "\",\"ts\":" << time << ",\"pid\":1,\"tid\":" << e.thread_ << "}";
+        separator = ",\n";
+        ++written;
+    }
+    out << "\n]}\n";
+    out.close();
+
+    if(out.fail()) {
+        log_error() << "Failed to write " << path;
+        return false;
+    }
+    logger() << "Wrote " << written << " trace event(s) to " << path;
+    return true;
+}
+
+#endif
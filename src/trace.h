@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/trace.h
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+// Timeline of begin/end events, dumped as a Chrome trace that Perfetto and
+// chrome://tracing open.
+//
+// Events go into a fixed ring that any thread appends to without locking, so
+// the latest events are always kept. Built only with HCBRAVO_TRACE; otherwise
+// every probe compiles to nothing.
+class trace {
+public:
+    static constexpr size_t capacity = 32768;
+    static constexpr size_t max_threads = 64;
+
+    struct event {
+        const char * name_;
+        int64_t time_;      // Nanoseconds since the plugin started
+        uint32_t thread_;
+        char phase_;        // 'B'egin or 'E'nd
+    };
+
+#if defined(HCBRAVO_TRACE)
+protected:
+    // A slot holds the number of the event written to it plus one, and zero
+    // while it is being written, so readers skip slots that change under them
+    struct slot {
+        std::atomic<uint64_t> seq_;
+        std::atomic<const char *> name_;
+        std::atomic<int64_t> time_;
+        std::atomic<uint32_t> thread_;
+        std::atomic<char> phase_;
+    };
+
+    static inline slot ring_[capacity];
+    static inline std::atomic<uint64_t> head_ = 0;
+    static inline std::atomic<uint32_t> threads_ = 0;
+    static inline std::atomic<const char *> thread_names_[max_threads];
+    static inline const std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+
+    static inline
+    uint32_t
+    thread_id() noexcept {
+        static thread_local const uint32_t id = threads_.fetch_add(1, std::memory_order_relaxed);
+        return id;
+    }
+
+public:
+    static inline
+    void
+    record(const char * name, char phase) noexcept {
+        auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+        auto n = head_.fetch_add(1, std::memory_order_relaxed);
+        auto & slot = ring_[n % capacity];
+        slot.seq_.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name_.store(name, std::memory_order_relaxed);
+        slot.time_.store(time.count(), std::memory_order_relaxed);
+        slot.thread_.store(thread_id(), std::memory_order_relaxed);
+        slot.phase_.store(phase, std::memory_order_relaxed);
+        slot.seq_.store(n + 1, std::memory_order_release);
+    }
+
+    // Names the calling thread in the dumps; the name must outlive the plugin
+    static inline
+    void
+    name_thread(const char * name) noexcept {
+        auto id = thread_id();
+        if(id < max_threads) thread_names_[id].store(name, std::memory_order_relaxed);
+    }
+
+    // Events in the ring, oldest first, without those being overwritten
+    static
+    std::vector<event>
+    snapshot() noexcept;
+
+    // Writes the ring as Chrome trace JSON
+    static
+    bool
+    dump(const std::filesystem::path & path) noexcept;
+#else
+public:
+    static inline void record(const char *, char) noexcept {}
+    static inline void name_thread(const char *) noexcept {}
+#endif
+};
+
+// Records a begin event, and the matching end event when it goes out of scope.
+// Names must be string literals
+class trace_scope {
+#if defined(HCBRAVO_TRACE)
+protected:
+    const char * name_;
+
+public:
+    inline
+    explicit trace_scope(const char * name) noexcept :
+        name_(name)
+    {
+        trace::record(this->name_, 'B');
+    }
+
+    inline
+    ~trace_scope() noexcept { trace::record(this->name_, 'E'); }
+#else
+public:
+    inline
+    explicit trace_scope(const char *) noexcept {}
+#endif
+
+    trace_scope(const trace_scope &) = delete;
+    trace_scope & operator=(const trace_scope &) = delete;
+};
+
+#endif
@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/watcher.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#include "watcher.h"
+
+#include <system_error>
+
+#if defined(LIN)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// How long the inotify thread waits for events before checking whether it
+// has to stop
+static const int notify_timeout_ms = 100;
+
+watcher::watcher(const std::filesystem::path & directory, std::chrono::milliseconds interval) noexcept :
+    directory_(directory),
+    interval_(interval),
+    fd_(-1),
+    stop_(false)
+{}
+
+watcher::~watcher() noexcept
+{
+    this->stop();
+}
+
+bool
+watcher::is_profile(const std::filesystem::path & file) noexcept
+{
+    return file.extension() == ".yaml";
+}
+
+bool
+watcher::start() noexcept
+{
+    if(this->thread_.joinable()) return true;
+
+    std::error_code err;
+    if(std::filesystem::is_directory(this->directory_, err) == false) return false;
+
+#if defined(LIN)
+    this->fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(this->fd_ >= 0 and inotify_add_watch(this->fd_, this->directory_.c_str(),
+            IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0) {
+        ::close(this->fd_);
+        this->fd_ = -1;
+    }
+#endif
+    // Without inotify, changes are found by comparing against this snapshot
+    if(this->is_notified() == false) this->scan();
+    this->changed_.clear();
+
+    this->stop_ = false;
+    this->thread_ = std::thread(&watcher::run, this);
+    return true;
+}
+
+void
+watcher::stop() noexcept
+{
+    if(this->thread_.joinable() == false) return;
+    {
+        std::lock_guard lock(this->mutex_);
+        this->stop_ = true;
+    }
+    this->cond_.notify_one();
+    this->thread_.join();
+
+#if defined(LIN)
+    if(this->fd_ >= 0) ::close(this->fd_);
+#endif
+    this->fd_ = -1;
+}
+
+void
+watcher::notify(std::string && file) noexcept
+{
+    std::lock_guard lock(this->mutex_);
+    this->changed_.emplace(std::move(file));
+}
+
+bool
+watcher::scan() noexcept
+{
+    snapshot_type snapshot;
+    std::error_code err;
+    for(const auto & file : std::filesystem::directory_iterator(this->directory_, err)) {
+        if(is_profile(file.path()) == false) continue;
+        auto mtime = static_cast<int64_t>(file.last_write_time(err).time_since_epoch().count());
+        if(err) continue;
+        auto size = file.file_size(err);
+        if(err) continue;
+        snapshot.emplace(file.path().filename().string(), std::make_pair(mtime, size));
+    }
+    // A directory we fail to read is not the same as every profile removed
+    if(err) return false;
+
+    bool changed = false;
+    for(const auto & [file, stat] : snapshot) {
+        auto it = this->snapshot_.find(file);
+        if(it != this->snapshot_.end() and it->second == stat) continue;
+        this->notify(std::string(file));
+        changed = true;
+    }
+    for(const auto & [file, stat] : this->snapshot_) {
+        if(snapshot.contains(file)) continue;
+        this->notify(std::string(file));
+        changed = true;
+    }
+    this->snapshot_ = std::move(snapshot);
+    return changed;
+}
+
+void
+watcher::run(watcher * self) noexcept
+{
+#if defined(LIN)
+    if(self->is_notified()) {
+        alignas(struct inotify_event) char buffer[4096];
+        struct pollfd fds = { .fd = self->fd_, .events = POLLIN, .revents = 0 };
+        for(;;) {
+            {
+                std::lock_guard lock(self->mutex_);
+                if(self->stop_) return;
+            }
+            if(::poll(&fds, 1, notify_timeout_ms) <= 0) continue;
+
+            ssize_t len;
+            while((len = ::read(self->fd_, buffer, sizeof(buffer))) > 0) {
+                for(char * ptr = buffer; ptr < buffer + len;) {
+                    auto event = reinterpret_cast<const struct inotify_event *>(ptr);
+                    ptr += sizeof(struct inotify_event) + event->len;
+                    if(event->len == 0) continue;
+                    std::filesystem::path file(event->name);
+                    if(is_profile(file)) self->notify(file.string());
+                }
+            }
+        }
+    }
+#endif
+
+    std::unique_lock lock(self->mutex_);
+    while(self->cond_.wait_for(lock, self->interval_, [self]() { return self->stop_; }) == false) {
+        lock.unlock();
+        self->scan();
+        lock.lock();
+    }
+}
+
+std::vector<std::string>
+watcher::changes() noexcept
+{
+    std::lock_guard lock(this->mutex_);
+    std::vector<std::string> ret(this->changed_.begin(), this->changed_.end());
+    this->changed_.clear();
+    return ret;
+}
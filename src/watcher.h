@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// src/watcher.h
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#ifndef WATCHER_H_
+#define WATCHER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <cstdint>
+
+// Watches the configuration directory for profiles that are added, modified
+// or removed.
+//
+// Changes are collected by a background thread, using inotify on Linux and
+// periodically comparing the modification time and size of every profile
+// elsewhere, or when inotify is not available. The thread never calls into
+// X-Plane; changes are picked up from the sim thread with changes().
+class watcher {
+protected:
+    using snapshot_type = std::unordered_map<std::string, std::pair<int64_t, uintmax_t>>;
+
+    std::filesystem::path directory_;
+    std::chrono::milliseconds interval_;
+    int fd_;
+    snapshot_type snapshot_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::set<std::string> changed_;
+    bool stop_;
+    std::thread thread_;
+
+    static
+    bool
+    is_profile(const std::filesystem::path & file) noexcept;
+
+    // Compares the directory against the last snapshot and returns whether
+    // any profile changed
+    bool
+    scan() noexcept;
+
+    void
+    notify(std::string && file) noexcept;
+
+    static
+    void
+    run(watcher * self) noexcept;
+
+public:
+    watcher(const std::filesystem::path & directory,
+            std::chrono::milliseconds interval = std::chrono::milliseconds(1000)) noexcept;
+
+    ~watcher() noexcept;
+
+    bool
+    start() noexcept;
+
+    void
+    stop() noexcept;
+
+    // Whether changes are reported by inotify instead of polling
+    inline
+    bool
+    is_notified() const noexcept { return this->fd_ >= 0; }
+
+    inline
+    const std::filesystem::path &
+    directory() const noexcept { return this->directory_; }
+
+    // Returns the names of the profiles that changed since the last call
+    std::vector<std::string>
+    changes() noexcept;
+};
+
+#endif
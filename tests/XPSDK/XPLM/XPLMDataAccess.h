@@ -11,6 +11,7 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <iostream>
 
@@ -26,6 +27,19 @@ enum XPLMDataTypeID {
 
 
 
+typedef int (*XPLMGetDatai_f)(void * inRefcon);
+typedef void (*XPLMSetDatai_f)(void * inRefcon, int inValue);
+typedef float (*XPLMGetDataf_f)(void * inRefcon);
+typedef void (*XPLMSetDataf_f)(void * inRefcon, float inValue);
+typedef double (*XPLMGetDatad_f)(void * inRefcon);
+typedef void (*XPLMSetDatad_f)(void * inRefcon, double inValue);
+typedef int (*XPLMGetDatavi_f)(void * inRefcon, int * outValues, int inOffset, int inMax);
+typedef void (*XPLMSetDatavi_f)(void * inRefcon, int * inValues, int inOffset, int inCount);
+typedef int (*XPLMGetDatavf_f)(void * inRefcon, float * outValues, int inOffset, int inMax);
+typedef void (*XPLMSetDatavf_f)(void * inRefcon, float * inValues, int inOffset, int inCount);
+typedef int (*XPLMGetDatab_f)(void * inRefcon, void * outValue, int inOffset, int inMaxLength);
+typedef void (*XPLMSetDatab_f)(void * inRefcon, void * inValue, int inOffset, int inLength);
+
 struct xplm_data_ref {
     std::string name;
     union {
@@ -35,6 +49,23 @@ struct xplm_data_ref {
 
     XPLMDataTypeID type;
 
+    // Per-element values for array DataRefs; missing elements read as value
+    std::vector<int> ints;
+    std::vector<float> floats;
+
+    // Contents of byte array DataRefs, e.g. aircraft names
+    std::string bytes;
+
+    // Number of times X-Plane has been asked for this DataRef, and to change it
+    size_t reads = 0;
+    size_t writes = 0;
+
+    // Read accessors of DataRefs owned by a plugin
+    XPLMGetDatai_f read_int = nullptr;
+    XPLMGetDataf_f read_float = nullptr;
+    XPLMGetDatavi_f read_ints = nullptr;
+    void * refcon = nullptr;
+
     inline
     xplm_data_ref(std::string && name, int value) noexcept :
         name(std::move(name)),
@@ -52,7 +83,8 @@ struct xplm_data_ref {
 };
 
 
-using XPLMDataRef = std::unique_ptr<xplm_data_ref>;
+// Like in X-Plane, DataRefs are opaque handles that live until the process exits
+using XPLMDataRef = xplm_data_ref *;
 
 typedef struct XPLMDataRefInfo {
     size_t structSize;
@@ -67,42 +99,112 @@ void XPLMGetDataRefInfo(const XPLMDataRef & data_ref, XPLMDataRefInfo * info) no
     info->type = data_ref->type;
 }
 
+// Shared by every translation unit, like the handles of X-Plane
+inline
+std::vector<std::unique_ptr<xplm_data_ref>> &
+xplm_data_refs() noexcept {
+    static std::vector<std::unique_ptr<xplm_data_ref>> data_refs;
+    return data_refs;
+}
+
 static inline
 XPLMDataRef XPLMFindDataRef(const char * key) noexcept {
-    return std::make_unique<xplm_data_ref>(std::string(key), 0);
+    return xplm_data_refs().emplace_back(std::make_unique<xplm_data_ref>(std::string(key), 0)).get();
+}
+
+// Every handle handed out for the key so far, since each lookup returns a new one
+static inline
+std::vector<XPLMDataRef>
+xplm_find_all(const std::string & key) noexcept {
+    std::vector<XPLMDataRef> ret;
+    for(const auto & data_ref : xplm_data_refs()) {
+        if(data_ref->name == key) ret.emplace_back(data_ref.get());
+    }
+    return ret;
 }
 
 static inline
 int XPLMGetDatai(const XPLMDataRef & data_ref) noexcept {
+    ++data_ref->reads;
+    if(data_ref->read_int != nullptr) return data_ref->read_int(data_ref->refcon);
     return data_ref->value.i;
 }
 
 static inline
 int XPLMGetDatavi(const XPLMDataRef & data_ref, int * out, int off, int size) noexcept {
-    if(out != nullptr) *out = data_ref->value.i;
-    return 1;
+    ++data_ref->reads;
+    if(data_ref->read_ints != nullptr) return data_ref->read_ints(data_ref->refcon, out, off, size);
+    if(out == nullptr) return 0;
+    for(int n = 0; n < size; ++n) {
+        size_t index = off + n;
+        out[n] = index < data_ref->ints.size() ? data_ref->ints[index] : data_ref->value.i;
+    }
+    return size;
 }
 
 static inline
 float XPLMGetDataf(const XPLMDataRef & data_ref) noexcept {
+    ++data_ref->reads;
+    if(data_ref->read_float != nullptr) return data_ref->read_float(data_ref->refcon);
     return data_ref->value.f;
 }
 
 static inline
 int XPLMGetDatavf(const XPLMDataRef & data_ref, float * out, int off, int size) noexcept {
-    if(out != nullptr) *out = data_ref->value.f;
-    return 1;
+    ++data_ref->reads;
+    if(out == nullptr) return 0;
+    for(int n = 0; n < size; ++n) {
+        size_t index = off + n;
+        out[n] = index < data_ref->floats.size() ? data_ref->floats[index] : data_ref->value.f;
+    }
+    return size;
+}
+
+static inline
+int XPLMGetDatab(const XPLMDataRef & data_ref, void * out, int off, int size) noexcept {
+    ++data_ref->reads;
+    int available = static_cast<int>(data_ref->bytes.size()) - off;
+    if(out == nullptr) return available > 0 ? available : 0;
+    int count = available < size ? available : size;
+    if(count <= 0) return 0;
+    data_ref->bytes.copy(static_cast<char *>(out), count, off);
+    return count;
 }
 
 static inline
 void XPLMSetDataf(const XPLMDataRef & data_ref, float value) noexcept {
+    ++data_ref->writes;
     data_ref->value.f = value;
 }
 
 static inline
 int XPLMSetDatavf(const XPLMDataRef & data_ref, float * value, int off, int size) noexcept {
+    ++data_ref->writes;
     if(value != nullptr) data_ref->value.f = *value;
     return 1;
 }
 
+// Only the read accessors are kept; plugin DataRefs are read-only here
+static inline
+XPLMDataRef XPLMRegisterDataAccessor(const char * inDataName, XPLMDataTypeID inDataType, int inIsWritable,
+        XPLMGetDatai_f inReadInt, XPLMSetDatai_f inWriteInt, XPLMGetDataf_f inReadFloat, XPLMSetDataf_f inWriteFloat,
+        XPLMGetDatad_f inReadDouble, XPLMSetDatad_f inWriteDouble, XPLMGetDatavi_f inReadIntArray,
+        XPLMSetDatavi_f inWriteIntArray, XPLMGetDatavf_f inReadFloatArray, XPLMSetDatavf_f inWriteFloatArray,
+        XPLMGetDatab_f inReadData, XPLMSetDatab_f inWriteData, void * inReadRefcon, void * inWriteRefcon) noexcept {
+    auto data_ref = xplm_data_refs().emplace_back(std::make_unique<xplm_data_ref>(std::string(inDataName), 0)).get();
+    data_ref->type = inDataType;
+    data_ref->read_int = inReadInt;
+    data_ref->read_float = inReadFloat;
+    data_ref->read_ints = inReadIntArray;
+    data_ref->refcon = inReadRefcon;
+    return data_ref;
+}
+
+static inline
+void XPLMUnregisterDataAccessor(XPLMDataRef inDataRef) noexcept {
+    inDataRef->read_int = nullptr;
+    inDataRef->read_float = nullptr;
+    inDataRef->read_ints = nullptr;
+}
+
 #endif
\ No newline at end of file
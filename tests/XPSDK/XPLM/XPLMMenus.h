@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// tests/XPSDK/XPLM/XPLMMenus.h
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#ifndef XPLMMENUS_H_
+#define XPLMMENUS_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+typedef void * XPLMMenuID;
+
+typedef int XPLMMenuCheck;
+
+enum {
+    xplm_Menu_NoCheck = 0,
+    xplm_Menu_Unchecked = 1,
+    xplm_Menu_Checked = 2
+};
+
+typedef void (*XPLMMenuHandler_f)(void * inMenuRef, void * inItemRef);
+
+struct xplm_menu {
+    struct item {
+        std::string name;
+        void * ref;
+        XPLMMenuCheck check;
+    };
+
+    std::string name;
+    XPLMMenuHandler_f handler = nullptr;
+    void * ref = nullptr;
+    std::vector<item> items;
+
+    // Does what X-Plane does when the user picks the item
+    inline
+    void
+    click(int index) const noexcept {
+        if(this->handler != nullptr) this->handler(this->ref, this->items[index].ref);
+    }
+};
+
+inline
+XPLMMenuID XPLMFindPluginsMenu() noexcept {
+    static xplm_menu plugins{ "Plugins" };
+    return &plugins;
+}
+
+static inline
+XPLMMenuID XPLMCreateMenu(const char * inName, XPLMMenuID inParentMenu, int inParentItem,
+        XPLMMenuHandler_f inHandler, void * inMenuRef) noexcept {
+    static std::vector<std::unique_ptr<xplm_menu>> menus;
+    return menus.emplace_back(new xplm_menu{ inName, inHandler, inMenuRef }).get();
+}
+
+static inline
+int XPLMAppendMenuItem(XPLMMenuID inMenu, const char * inItemName, void * inItemRef, int inDeprecated) noexcept {
+    auto * menu = static_cast<xplm_menu *>(inMenu);
+    menu->items.emplace_back(xplm_menu::item{ inItemName, inItemRef, xplm_Menu_NoCheck });
+    return static_cast<int>(menu->items.size() - 1);
+}
+
+static inline
+void XPLMCheckMenuItem(XPLMMenuID inMenu, int index, XPLMMenuCheck inCheck) noexcept {
+    static_cast<xplm_menu *>(inMenu)->items[index].check = inCheck;
+}
+
+#endif
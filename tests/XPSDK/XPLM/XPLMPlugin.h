@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// tests/XPSDK/XPLM/XPLMPlugin.h
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#ifndef XPLMPLUGIN_H_
+#define XPLMPLUGIN_H_
+
+#include <string>
+
+#include <cstring>
+
+typedef int XPLMPluginID;
+
+// Where X-Plane loaded the plugin binary from; the plugin finds its files next to it
+inline
+std::string &
+xplm_plugin_path() noexcept {
+    static std::string path;
+    return path;
+}
+
+static inline
+XPLMPluginID XPLMGetMyID() noexcept { return 0; }
+
+static inline
+void XPLMGetPluginInfo(XPLMPluginID inPlugin, char * outName, char * outFilePath, char * outSignature,
+        char * outDescription) noexcept {
+    if(outFilePath != nullptr) ::strcpy(outFilePath, xplm_plugin_path().c_str());
+}
+
+static inline
+void XPLMReloadPlugins() noexcept {}
+
+#endif
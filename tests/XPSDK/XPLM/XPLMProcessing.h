@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// tests/XPSDK/XPLM/XPLMProcessing.h
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#ifndef XPLMPROCESSING_H_
+#define XPLMPROCESSING_H_
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+typedef void * XPLMFlightLoopID;
+
+typedef float (*XPLMFlightLoop_f)(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop,
+    int inCounter, void * inRefcon);
+
+typedef int XPLMFlightLoopPhaseType;
+
+enum {
+    xplm_FlightLoop_Phase_BeforeFlightModel = 0,
+    xplm_FlightLoop_Phase_AfterFlightModel = 1
+};
+
+typedef struct {
+    int structSize;
+    XPLMFlightLoopPhaseType phase;
+    XPLMFlightLoop_f callbackFunc;
+    void * refcon;
+} XPLMCreateFlightLoop_t;
+
+// Simulated X-Plane frame loop. Time only moves when the caller runs a frame,
+// and flight loops follow the X-Plane scheduling rules: negative intervals
+// are frames, positive ones seconds, and zero stops the loop
+class xplm_sim {
+public:
+    struct flight_loop {
+        XPLMFlightLoop_f callback;
+        void * refcon;
+        bool scheduled = false;
+        int frames = 0;
+        double due = 0.0;
+        double last_call = 0.0;
+        int counter = 0;
+    };
+
+protected:
+    double now_ = 0.0;
+    int frame_ = 0;
+    std::vector<std::unique_ptr<flight_loop>> loops_;
+
+public:
+    static inline
+    xplm_sim &
+    instance() noexcept {
+        static xplm_sim sim;
+        return sim;
+    }
+
+    inline
+    double
+    now() const noexcept { return this->now_; }
+
+    inline
+    XPLMFlightLoopID
+    create(const XPLMCreateFlightLoop_t & params) {
+        auto & loop = this->loops_.emplace_back(new flight_loop{ params.callbackFunc, params.refcon });
+        loop->last_call = this->now_;
+        return loop.get();
+    }
+
+    inline
+    void
+    destroy(XPLMFlightLoopID id) noexcept {
+        auto * loop = static_cast<flight_loop *>(id);
+        loop->callback = nullptr;
+        loop->scheduled = false;
+    }
+
+    inline
+    void
+    schedule(XPLMFlightLoopID id, float interval) noexcept {
+        auto * loop = static_cast<flight_loop *>(id);
+        loop->scheduled = interval != 0.0f and loop->callback != nullptr;
+        loop->frames = interval < 0.0f ? static_cast<int>(std::lround(-interval)) : 0;
+        loop->due = this->now_ + (interval > 0.0f ? interval : 0.0f);
+    }
+
+    // Advances the sim clock by one frame and calls every loop that is due
+    inline
+    void
+    run_frame(double seconds) {
+        this->now_ += seconds;
+        ++this->frame_;
+        // Loops created by a callback wait for the next frame
+        for(size_t n = 0, size = this->loops_.size(); n < size; ++n) {
+            auto * loop = this->loops_[n].get();
+            if(loop->scheduled == false) continue;
+            if(loop->frames > 0 and --loop->frames > 0) continue;
+            if(loop->frames == 0 and loop->due > this->now_) continue;
+
+            float elapsed = static_cast<float>(this->now_ - loop->last_call);
+            loop->last_call = this->now_;
+            this->schedule(loop, loop->callback(elapsed, elapsed, this->frame_, loop->refcon));
+        }
+    }
+};
+
+static inline
+XPLMFlightLoopID XPLMCreateFlightLoop(XPLMCreateFlightLoop_t * params) noexcept {
+    if(params == nullptr or params->callbackFunc == nullptr) return nullptr;
+    return xplm_sim::instance().create(*params);
+}
+
+static inline
+void XPLMDestroyFlightLoop(XPLMFlightLoopID id) noexcept {
+    if(id != nullptr) xplm_sim::instance().destroy(id);
+}
+
+static inline
+void XPLMScheduleFlightLoop(XPLMFlightLoopID id, float interval, int relative_to_now) noexcept {
+    if(id != nullptr) xplm_sim::instance().schedule(id, interval);
+}
+
+static inline
+float XPLMGetElapsedTime() noexcept {
+    return static_cast<float>(xplm_sim::instance().now());
+}
+
+#endif
@@ -8,7 +8,98 @@
 #ifndef XPLMUTILITIES_H_
 #define XPLMUTILITIES_H_
 
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <cstring>
+
+// Everything written to Log.txt
+inline
+std::string &
+xplm_debug_output() noexcept {
+    static std::string output;
+    return output;
+}
+
+inline
+std::mutex &
+xplm_debug_mutex() noexcept {
+    static std::mutex mutex;
+    return mutex;
+}
+
+static inline
+void XPLMDebugString(const char * inString) noexcept {
+    std::lock_guard lock(xplm_debug_mutex());
+    xplm_debug_output() += inString;
+}
+
+// Folder X-Plane runs from, where it writes Log.txt
+inline
+std::string &
+xplm_system_path() noexcept {
+    static std::string path;
+    return path;
+}
+
+static inline
+void XPLMGetSystemPath(char * outSystemPath) noexcept {
+    ::strcpy(outSystemPath, xplm_system_path().c_str());
+}
+
+typedef void (*XPLMError_f)(const char * inMessage);
+
+static inline
+void XPLMSetErrorCallback(XPLMError_f) noexcept {}
+
+static inline
+char * XPLMExtractFileAndPath(char * inFullPath) noexcept {
+    char * separator = ::strrchr(inFullPath, '/');
+    if(separator == nullptr) return inFullPath;
+    *separator = '\0';
+    return separator + 1;
+}
+
+typedef void * XPLMCommandRef;
+
+typedef int XPLMCommandPhase;
+
+enum {
+    xplm_CommandBegin = 0,
+    xplm_CommandContinue = 1,
+    xplm_CommandEnd = 2
+};
+
+typedef int (*XPLMCommandCallback_f)(XPLMCommandRef inCommand, XPLMCommandPhase inPhase, void * inRefcon);
+
+// Commands are never freed, and keep their last handler so it can be invoked
+struct xplm_command {
+    std::string name;
+    XPLMCommandCallback_f handler = nullptr;
+    void * refcon = nullptr;
+};
+
+static inline
+XPLMCommandRef XPLMCreateCommand(const char * inName, const char * inDescription) noexcept {
+    static std::vector<std::unique_ptr<xplm_command>> commands;
+    return commands.emplace_back(new xplm_command{ inName }).get();
+}
+
+static inline
+void XPLMRegisterCommandHandler(XPLMCommandRef inCommand, XPLMCommandCallback_f inHandler, int inBefore,
+        void * inRefcon) noexcept {
+    auto * command = static_cast<xplm_command *>(inCommand);
+    command->handler = inHandler;
+    command->refcon = inRefcon;
+}
+
 static inline
-void XPLMDebugString(const char *) noexcept {}
+void XPLMUnregisterCommandHandler(XPLMCommandRef inCommand, XPLMCommandCallback_f inHandler, int inBefore,
+        void * inRefcon) noexcept {
+    auto * command = static_cast<xplm_command *>(inCommand);
+    if(command->handler == inHandler) command->handler = nullptr;
+}
 
-#endif
\ No newline at end of file
+#endif
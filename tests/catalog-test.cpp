@@ -0,0 +1,292 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// tests/catalog-test.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+
+#include <gtest/gtest.h>
+
+#include <catalog.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+class catalog_test : public ::testing::Test {
+protected:
+    std::filesystem::path directory_;
+
+    void
+    SetUp() override {
+        directory_ = std::filesystem::temp_directory_path() /
+            ("hcbravo-catalog-" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()) +
+             "-" + ::testing::UnitTest::GetInstance()->current_test_info()->name());
+        std::filesystem::remove_all(directory_);
+        std::filesystem::create_directories(directory_);
+        std::filesystem::copy_file(std::filesystem::path(HCBRAVO_CONF_DIR) / "c172.yaml", directory_ / "c172.yaml");
+    }
+
+    void
+    TearDown() override {
+        std::filesystem::remove_all(directory_);
+    }
+
+    std::string
+    read(const std::filesystem::path & path) {
+        std::ifstream input(path);
+        std::stringstream buffer;
+        buffer << input.rdbuf();
+        return buffer.str();
+    }
+
+    void
+    write(const std::filesystem::path & path, const std::string & content) {
+        std::ofstream output(path, std::ios::trunc);
+        output << content;
+    }
+};
+
+TEST_F(catalog_test, scan) {
+    auto ret = catalog::load(directory_);
+    ASSERT_TRUE(ret.has_value());
+    const auto & cat = ret.value();
+    ASSERT_EQ(cat.entries().size(), 1);
+
+    auto entry = cat.find_model("C172");
+    ASSERT_TRUE(entry);
+    ASSERT_EQ(entry.value()->header().name(), "Cessna 172S");
+    ASSERT_TRUE(cat.find_aircraft("Cessna Skyhawk (G1000)"));
+    ASSERT_FALSE(cat.find_model("B738"));
+
+    ASSERT_TRUE(std::filesystem::exists(directory_ / catalog::index_name));
+}
+
+TEST_F(catalog_test, lazy_load) {
+    auto ret = catalog::load(directory_);
+    ASSERT_TRUE(ret.has_value());
+    auto entry = ret.value().find_model("C172").value();
+
+    auto first = entry->load();
+    ASSERT_TRUE(first.has_value());
+    ASSERT_EQ(first.value()->name(), "Cessna 172S");
+
+    // The profile is only parsed once
+    auto second = entry->load();
+    ASSERT_TRUE(second.has_value());
+    ASSERT_EQ(first.value().get(), second.value().get());
+}
+
+TEST_F(catalog_test, index) {
+    ASSERT_TRUE(catalog::load(directory_).has_value());
+
+    // Rewrite the profile without changing its size or modification time, so
+    // the name can only come from the index
+    auto path = directory_ / "c172.yaml";
+    auto mtime = std::filesystem::last_write_time(path);
+    auto content = read(path);
+    auto pos = content.find("Cessna 172S");
+    ASSERT_NE(pos, std::string::npos);
+    content.replace(pos, 11, "Cessna 172X");
+    write(path, content);
+    std::filesystem::last_write_time(path, mtime);
+
+    auto ret = catalog::load(directory_);
+    ASSERT_TRUE(ret.has_value());
+    ASSERT_EQ(ret.value().find_model("C172").value()->header().name(), "Cessna 172S");
+
+    // A changed modification time invalidates the entry
+    std::filesystem::last_write_time(path, mtime + std::chrono::seconds(1));
+    ret = catalog::load(directory_);
+    ASSERT_TRUE(ret.has_value());
+    ASSERT_EQ(ret.value().find_model("C172").value()->header().name(), "Cessna 172X");
+}
+
+TEST_F(catalog_test, reuse) {
+    auto first = catalog::load(directory_);
+    ASSERT_TRUE(first.has_value());
+    auto entry = first.value().find_model("C172").value();
+    ASSERT_TRUE(entry->load().has_value());
+
+    // Unchanged files keep their entry, and with it the parsed profile
+    auto second = catalog::load(directory_, &first.value());
+    ASSERT_TRUE(second.has_value());
+    ASSERT_EQ(second.value().find_model("C172").value().get(), entry.get());
+}
+
+TEST_F(catalog_test, precedence) {
+    write(directory_ / "a.yaml", "name: First\nmodels:\n - C172\n");
+    write(directory_ / "broken.yaml", "name: [\n");
+
+    auto ret = catalog::load(directory_);
+    ASSERT_TRUE(ret.has_value());
+    ASSERT_EQ(ret.value().entries().size(), 2);
+    ASSERT_EQ(ret.value().find_model("C172").value()->header().name(), "First");
+}
+
+TEST_F(catalog_test, parse) {
+    write(directory_ / "broken.yaml", "name: Broken\nmodels:\n - B738\n");
+
+    auto ret = catalog::load(directory_);
+    ASSERT_TRUE(ret.has_value());
+    const auto & cat = ret.value();
+
+    // Profiles can be parsed ahead of time, e.g. from a background thread
+    auto parser = std::thread([&cat]() { ASSERT_EQ(cat.parse(), 1); });
+    parser.join();
+
+    auto entry = cat.find_model("C172").value();
+    auto first = entry->load();
+    ASSERT_TRUE(first.has_value());
+    ASSERT_EQ(cat.parse(), 1);
+    ASSERT_EQ(entry->load().value().get(), first.value().get());
+
+    // The broken profile has no system section, and is not parsed again
+    ASSERT_FALSE(cat.find_model("B738").value()->load().has_value());
+}
+
+TEST_F(catalog_test, lazy) {
+    write(directory_ / "d.yaml", "name: Second\nmodels:\n - B738\nextends: c172.yaml\n");
+
+    // Loading only reads headers, and profiles are parsed once needed
+    auto ret = catalog::load(directory_);
+    ASSERT_TRUE(ret.has_value());
+    auto & cat = ret.value();
+    for(const auto & entry : cat.entries()) ASSERT_FALSE(entry->is_parsed());
+    auto c172 = cat.find_model("C172").value();
+    ASSERT_TRUE(c172->load().has_value());
+    ASSERT_TRUE(c172->is_parsed());
+    ASSERT_FALSE(cat.find_model("B738").value()->is_parsed());
+
+    // Patches only parse the entries they replaced
+    catalog previous(cat);
+    write(directory_ / "d.yaml", "name: Third\nmodels:\n - B738\nextends: c172.yaml\n");
+    write(directory_ / "e.yaml", "name: Fourth\nmodels:\n - A320\n");
+    ASSERT_EQ(cat.patch({ "d.yaml", "e.yaml" }), 2);
+    ASSERT_EQ(cat.parse(&previous), 1);
+    ASSERT_TRUE(cat.find_model("B738").value()->is_parsed());
+    ASSERT_TRUE(cat.find_model("A320").value()->is_parsed());
+    ASSERT_EQ(cat.find_model("C172").value().get(), c172.get());
+}
+
+TEST_F(catalog_test, patch) {
+    write(directory_ / "d.yaml", "name: Second\nmodels:\n - C172\n - B738\n");
+
+    auto ret = catalog::load(directory_);
+    ASSERT_TRUE(ret.has_value());
+    auto & cat = ret.value();
+    auto c172 = cat.find_model("C172").value();
+    ASSERT_EQ(cat.find_model("B738").value()->header().name(), "Second");
+
+    // Unchanged files are left alone
+    ASSERT_EQ(cat.patch({ "c172.yaml", "d.yaml" }), 0);
+    ASSERT_EQ(cat.find_model("C172").value().get(), c172.get());
+
+    // New files take precedence by name
+    write(directory_ / "a.yaml", "name: First\nmodels:\n - C172\n");
+    ASSERT_EQ(cat.patch({ "a.yaml" }), 1);
+    ASSERT_EQ(cat.entries().size(), 3);
+    ASSERT_EQ(cat.find_model("C172").value()->header().name(), "First");
+    ASSERT_EQ(cat.find_aircraft("Cessna Skyhawk (G1000)").value().get(), c172.get());
+
+    // Removing a profile hands its keys to the next one claiming them
+    std::filesystem::remove(directory_ / "a.yaml");
+    write(directory_ / "d.yaml", "name: Third\nmodels:\n - B738\n");
+    ASSERT_EQ(cat.patch({ "a.yaml", "d.yaml" }), 2);
+    ASSERT_EQ(cat.entries().size(), 2);
+    ASSERT_EQ(cat.find_model("C172").value().get(), c172.get());
+    ASSERT_EQ(cat.find_model("B738").value()->header().name(), "Third");
+
+    // The index follows the patched catalog
+    auto reloaded = catalog::load(directory_);
+    ASSERT_TRUE(reloaded.has_value());
+    ASSERT_EQ(reloaded.value().find_model("B738").value()->header().name(), "Third");
+}
+
+TEST_F(catalog_test, extends) {
+    write(directory_ / "variant.yaml", "name: Variant\nmodels:\n - C72R\nextends: c172.yaml\n");
+    auto ret = catalog::load(directory_);
+    ASSERT_TRUE(ret.has_value());
+    auto & cat = ret.value();
+    auto variant = cat.find_model("C72R").value();
+    auto profile = variant->load();
+    ASSERT_TRUE(profile.has_value());
+    ASSERT_TRUE(profile.value()->autopilot().has_value());
+
+    // Editing a base reloads the profiles extending it
+    auto base = directory_ / "c172.yaml";
+    std::filesystem::last_write_time(base, std::filesystem::last_write_time(base) + std::chrono::seconds(1));
+    ASSERT_EQ(cat.patch({ "c172.yaml" }), 1);
+    auto patched = cat.find_model("C72R").value();
+    ASSERT_NE(patched.get(), variant.get());
+    ASSERT_EQ(patched->header().name(), "Variant");
+    ASSERT_NE(patched->load().value()->base().get(), profile.value()->base().get());
+
+    // And so does scanning the directory again
+    std::filesystem::last_write_time(base, std::filesystem::last_write_time(base) + std::chrono::seconds(1));
+    auto reloaded = catalog::load(directory_, &cat);
+    ASSERT_TRUE(reloaded.has_value());
+    ASSERT_NE(reloaded.value().find_model("C72R").value().get(), patched.get());
+    ASSERT_EQ(reloaded.value().find_model("C172").value()->header().name(), "Cessna 172S");
+}
+
+TEST_F(catalog_test, rules) {
+    write(directory_ / "b.yaml", "name: Skyhawks\npriority: 1\naircrafts:\n - 'Cessna Skyhawk*'\nmodels:\n - /C1[5-8]2/\n");
+    write(directory_ / "d.yaml", "name: Liveries\naircrafts:\n - 'Cessna * (Livery ?)'\nmodels:\n - C17*\n");
+
+    auto ret = catalog::load(directory_);
+    ASSERT_TRUE(ret.has_value());
+    auto & cat = ret.value();
+
+    // The higher priority wins over the exact name of c172.yaml
+    auto match = cat.match_aircraft("Cessna Skyhawk (G1000)");
+    ASSERT_TRUE(match);
+    ASSERT_EQ(match->entry_->header().name(), "Skyhawks");
+    ASSERT_EQ(match->rule_.kind_, match_index::kind::prefix);
+    ASSERT_EQ(match->rule_.text_, "Cessna Skyhawk*");
+    ASSERT_EQ(match->rule_.priority_, 1);
+    ASSERT_EQ(cat.find_aircraft("Cessna Skylane (Livery 2)").value()->header().name(), "Liveries");
+    ASSERT_FALSE(cat.find_aircraft("Cessna Skylane"));
+
+    match = cat.match_model("C172");
+    ASSERT_EQ(match->entry_->header().name(), "Skyhawks");
+    ASSERT_EQ(match->rule_.kind_, match_index::kind::regex);
+    ASSERT_EQ(cat.find_model("C177").value()->header().name(), "Liveries");
+
+    // Priorities survive the index, and patches recompile the rules
+    auto reloaded = catalog::load(directory_);
+    ASSERT_TRUE(reloaded.has_value());
+    ASSERT_EQ(reloaded.value().find_model("C172").value()->header().name(), "Skyhawks");
+    write(directory_ / "b.yaml", "name: Skyhawks\naircrafts:\n - 'Cessna Skyhawk*'\nmodels:\n - /C1[5-8]2/\n");
+    ASSERT_EQ(cat.patch({ "b.yaml" }), 1);
+    ASSERT_EQ(cat.find_model("C172").value()->header().name(), "Cessna 172S");
+    ASSERT_EQ(cat.find_model("C182").value()->header().name(), "Skyhawks");
+}
+
+TEST_F(catalog_test, parallel_parse) {
+    // Enough profiles to keep every parser thread busy, all sharing one base
+    for(int n = 0; n < 64; ++n) {
+        auto id = std::to_string(n);
+        write(directory_ / ("variant-" + id + ".yaml"),
+            "name: Variant " + id + "\nmodels:\n - V" + id + "\nextends: c172.yaml\n");
+    }
+    write(directory_ / "z-broken.yaml", "name: Broken\nmodels:\n - B738\n");
+
+    auto ret = catalog::load(directory_);
+    ASSERT_TRUE(ret.has_value());
+    const auto & cat = ret.value();
+    ASSERT_EQ(cat.entries().size(), 66);
+    ASSERT_EQ(cat.entries().front()->header().name(), "Cessna 172S");
+    ASSERT_EQ(cat.entries().back()->header().name(), "Broken");
+
+    ASSERT_EQ(cat.parse(), 1);
+    const auto & base = cat.find_model("V0").value()->load().value()->base();
+    ASSERT_NE(base, nullptr);
+    for(int n = 0; n < 64; ++n) {
+        auto profile = cat.find_model("V" + std::to_string(n)).value()->load();
+        ASSERT_TRUE(profile.has_value());
+        ASSERT_EQ(profile.value()->base().get(), base.get());
+    }
+}
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// tests/hidapi/hidapi.h
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#ifndef HIDAPI_H__
+#define HIDAPI_H__
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+#include <cstddef>
+#include <cstring>
+
+// Stands in for the quadrant. Feature reports are counted and the last one
+// is kept, so callers can check what would have been sent. on_feature_report,
+// if set, sees every report from the thread that sends it. reading is set while
+// a read waits, so tests can tell whether a report overlapped one
+struct hid_device_ {
+    std::atomic<size_t> feature_reports{0};
+    std::atomic<size_t> reads{0};
+    std::atomic<bool> reading{false};
+    unsigned char last_report[64] = {};
+    std::function<void(const unsigned char *, size_t)> on_feature_report;
+};
+
+typedef struct hid_device_ hid_device;
+
+static inline
+int hid_init(void) noexcept { return 0; }
+
+static inline
+int hid_exit(void) noexcept { return 0; }
+
+// The quadrant hid_open finds
+inline
+hid_device &
+hid_stub_device() noexcept {
+    static hid_device device;
+    return device;
+}
+
+static inline
+hid_device * hid_open(unsigned short vendor_id, unsigned short product_id, const wchar_t * serial_number) noexcept {
+    return &hid_stub_device();
+}
+
+static inline
+void hid_close(hid_device * dev) noexcept {}
+
+static inline
+int hid_send_feature_report(hid_device * dev, const unsigned char * data, size_t length) noexcept {
+    if(dev == nullptr or data == nullptr) return -1;
+    if(dev->on_feature_report) dev->on_feature_report(data, length);
+    ::memcpy(dev->last_report, data, length < sizeof(dev->last_report) ? length : sizeof(dev->last_report));
+    dev->feature_reports.fetch_add(1, std::memory_order_relaxed);
+    return static_cast<int>(length);
+}
+
+// Nobody touches the quadrant, so reads always time out
+static inline
+int hid_read_timeout(hid_device * dev, unsigned char * data, size_t length, int milliseconds) noexcept {
+    dev->reading.store(true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+    dev->reading.store(false);
+    dev->reads.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+}
+
+#endif
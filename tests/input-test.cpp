@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// tests/input-test.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+
+#include <gtest/gtest.h>
+
+#include <input.h>
+
+#include <hidapi.h>
+
+#include <thread>
+#include <vector>
+
+class input_test : public ::testing::Test {
+protected:
+    input_decoder decoder_;
+
+    std::vector<input_event>
+    decode(std::initializer_list<unsigned> buttons) {
+        uint8_t report[input_decoder::report_size] = { 0 };
+        for(auto button : buttons) {
+            report[input_decoder::axes_size + button / 8] |= uint8_t(1) << (button % 8);
+        }
+        std::vector<input_event> ret;
+        decoder_.decode(report, sizeof(report), [&ret](const input_event & event) { ret.push_back(event); });
+        return ret;
+    }
+};
+
+TEST_F(input_test, selector) {
+    // The initial position is reported even though nothing was pressed
+    auto events = decode({ 18 });
+    ASSERT_EQ(events.size(), 1);
+    ASSERT_EQ(events[0].kind_, input_event::kind::select);
+    ASSERT_EQ(static_cast<selector>(events[0].value_), selector::hdg);
+
+    ASSERT_TRUE(decode({ 18 }).empty());
+
+    events = decode({ 20 });
+    ASSERT_EQ(events.size(), 1);
+    ASSERT_EQ(static_cast<selector>(events[0].value_), selector::alt);
+}
+
+TEST_F(input_test, encoder) {
+    decode({ 16 });
+
+    // Every detent is a press followed by a release
+    ASSERT_EQ(decode({ 16, 12 }).size(), 1);
+    ASSERT_TRUE(decode({ 16, 12 }).empty());
+    ASSERT_TRUE(decode({ 16 }).empty());
+    auto events = decode({ 16, 13 });
+    ASSERT_EQ(events.size(), 1);
+    ASSERT_EQ(events[0].kind_, input_event::kind::dec);
+
+    events = decode({ 16, 0, 7 });
+    ASSERT_EQ(events.size(), 2);
+    ASSERT_EQ(events[0].kind_, input_event::kind::button);
+    ASSERT_EQ(events[0].value_, 0);
+    ASSERT_EQ(events[1].value_, 7);
+
+    // Short reads are ignored
+    uint8_t report[4] = { 0xff, 0xff, 0xff, 0xff };
+    decoder_.decode(report, sizeof(report), [](const input_event &) { FAIL(); });
+}
+
+TEST(spsc_queue_test, order) {
+    spsc_queue<int, 4> queue;
+    int value;
+    ASSERT_FALSE(queue.pop(value));
+    for(int n = 0; n < 4; ++n) ASSERT_TRUE(queue.push(n));
+    ASSERT_FALSE(queue.push(4));
+    for(int n = 0; n < 4; ++n) {
+        ASSERT_TRUE(queue.pop(value));
+        ASSERT_EQ(value, n);
+    }
+    ASSERT_TRUE(queue.empty());
+
+    // One thread producing while another consumes keeps every item in order
+    spsc_queue<int, 64> shared;
+    const int count = 100000;
+    std::thread producer([&shared]() {
+        for(int n = 0; n < count; ++n) {
+            while(shared.push(n) == false) std::this_thread::yield();
+        }
+    });
+    for(int n = 0; n < count; ++n) {
+        while(shared.pop(value) == false) std::this_thread::yield();
+        ASSERT_EQ(value, n);
+    }
+    producer.join();
+}
+
+TEST(input_reader_test, exclusive) {
+    hid_device hid;
+    hid_lock lock;
+    input_reader reader;
+    reader.start(&hid, lock);
+
+    // Reports sent while the reader runs never overlap one of its reads
+    unsigned char report[65] = { 0 };
+    size_t overlaps = 0;
+    for(int n = 0; n < 20; ++n) {
+        lock.lock_write();
+        if(hid.reading.load()) ++overlaps;
+        hid_send_feature_report(&hid, report, sizeof(report));
+        lock.unlock_write();
+        std::this_thread::sleep_for(std::chrono::milliseconds(3));
+    }
+    reader.stop();
+    ASSERT_EQ(overlaps, 0);
+    ASSERT_EQ(hid.feature_reports.load(), 20);
+    ASSERT_GT(hid.reads.load(), 0);
+}
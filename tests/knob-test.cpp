@@ -0,0 +1,205 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// tests/knob-test.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+#define HCBRAVO_KNOB_TESTS
+
+#include <gtest/gtest.h>
+
+#include <knob.h>
+#include <state.h>
+
+#include <XPLM/XPLMDataAccess.h>
+#include <XPLM/XPLMPlugin.h>
+#include <XPLM/XPLMProcessing.h>
+
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+static const char * alt_key = "sim/cockpit2/autopilot/altitude_dial_ft";
+static const char * vs_key = "sim/cockpit2/autopilot/vvi_dial_fpm";
+static const char * hdg_key = "sim/cockpit2/autopilot/heading_dial_deg_mag_pilot";
+
+// Runs the plugin against the simulated X-Plane with the C172 profile active
+class commands_test : public ::testing::Test {
+protected:
+    std::filesystem::path root_;
+    state::ptr_type plugin_;
+
+    void
+    SetUp() override {
+        root_ = std::filesystem::temp_directory_path() /
+            ("hcbravo-knob-" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()) +
+             "-" + ::testing::UnitTest::GetInstance()->current_test_info()->name());
+        std::filesystem::remove_all(root_);
+        std::filesystem::create_directories(root_ / "hcbravo" / "lin_x64");
+        std::filesystem::create_directories(root_ / "hcbravo" / "conf");
+        std::filesystem::copy_file(std::filesystem::path(HCBRAVO_CONF_DIR) / "c172.yaml",
+            root_ / "hcbravo" / "conf" / "c172.yaml");
+        xplm_plugin_path() = (root_ / "hcbravo" / "lin_x64" / "hcbravo.xpl").string();
+
+        auto ret = state::init();
+        ASSERT_TRUE(ret.has_value());
+        plugin_ = std::move(ret.value());
+        for(auto data_ref : xplm_find_all("sim/aircraft/view/acf_ICAO")) data_ref->bytes = "C172";
+
+        // Profiles load in the background
+        for(int n = 0; n < 1000 and plugin_->active_plane().has_value() == false; ++n) {
+            run_frame();
+            std::this_thread::sleep_for(1ms);
+        }
+        ASSERT_TRUE(plugin_->active_plane().has_value());
+    }
+
+    void
+    TearDown() override {
+        plugin_.reset();
+        std::filesystem::remove_all(root_);
+    }
+
+    void
+    run_frame(double seconds = 1.0 / 60.0) {
+        xplm_sim::instance().run_frame(seconds);
+    }
+
+    // The handle the profiles share, with fresh counters
+    XPLMDataRef
+    dial(const char * key, float value) {
+        auto handles = xplm_find_all(key);
+        EXPECT_EQ(handles.size(), 1);
+        auto handle = handles.front();
+        handle->value.f = value;
+        handle->reads = 0;
+        handle->writes = 0;
+        return handle;
+    }
+};
+
+TEST(knob_test, detent_rate) {
+    detent_rate rate;
+    auto now = detent_rate::clock::now();
+    const std::chrono::duration<float> window = 250ms;
+
+    // A single detent has no rate
+    ASSERT_EQ(rate.add(now, window), 0.0f);
+
+    // A detent every 20ms
+    float ret = 0.0f;
+    for(int n = 1; n <= 5; ++n) ret = rate.add(now + n * 20ms, window);
+    ASSERT_NEAR(ret, 50.0f, 0.5f);
+
+    // Detents older than the window do not count
+    ASSERT_EQ(rate.add(now + 1s, window), 0.0f);
+    ASSERT_NEAR(rate.add(now + 1s + 100ms, window), 10.0f, 0.1f);
+
+    rate.reset();
+    ASSERT_EQ(rate.add(now + 1s + 110ms, window), 0.0f);
+
+    // The history is bounded, so long spins keep estimating the latest detents
+    for(int n = 0; n < 100; ++n) ret = rate.add(now + 2s + n * 10ms, window);
+    ASSERT_NEAR(ret, 100.0f, 1.0f);
+}
+
+TEST_F(commands_test, coalesce) {
+    auto & knobs = plugin_->knobs();
+    auto alt = dial(alt_key, 0.0f);
+    auto hdg = dial(hdg_key, 358.0f);
+
+    // Detents within a frame end up in one read and one write of each dial
+    knobs.select(selector::alt);
+    for(int n = 0; n < 3; ++n) knobs.turn(commands::dir::dec);
+    ASSERT_LT(knobs.pending(selector::alt), 0.0f);
+    knobs.select(selector::hdg);
+    for(int n = 0; n < 3; ++n) knobs.turn(commands::dir::inc);
+    auto delta = knobs.pending(selector::hdg);
+    ASSERT_GE(delta, 3.0f);
+    ASSERT_EQ(alt->writes, 0);
+    ASSERT_EQ(hdg->writes, 0);
+
+    run_frame();
+    ASSERT_EQ(alt->reads, 1);
+    ASSERT_EQ(alt->writes, 1);
+    ASSERT_EQ(hdg->reads, 1);
+    ASSERT_EQ(hdg->writes, 1);
+    ASSERT_EQ(knobs.pending(selector::alt), 0.0f);
+    ASSERT_EQ(knobs.pending(selector::hdg), 0.0f);
+
+    // The altitude does not go below zero, and the heading wraps around
+    ASSERT_EQ(alt->value.f, 0.0f);
+    ASSERT_EQ(hdg->value.f, std::round(std::fmod(358.0f + delta, 360.0f)));
+    ASSERT_LT(hdg->value.f, 358.0f);
+
+    // Frames without detents leave the dials alone
+    run_frame();
+    ASSERT_EQ(alt->writes, 1);
+    ASSERT_EQ(hdg->writes, 1);
+}
+
+TEST_F(commands_test, hold) {
+    auto & knobs = plugin_->knobs();
+    auto vs = dial(vs_key, 0.0f);
+    knobs.select(selector::vs);
+
+    // A short press is a single detent
+    ASSERT_EQ(knobs.press(commands::dir::inc, xplm_CommandBegin), 0);
+    knobs.press(commands::dir::inc, xplm_CommandContinue);
+    ASSERT_FALSE(knobs.is_slewing());
+    knobs.press(commands::dir::inc, xplm_CommandEnd);
+    ASSERT_EQ(knobs.pending(selector::vs), 100.0f);
+    run_frame();
+    ASSERT_EQ(vs->value.f, 100.0f);
+    ASSERT_EQ(vs->writes, 1);
+
+    // Holding it past the delay slews the dial instead
+    knobs.press(commands::dir::dec, xplm_CommandBegin);
+    std::this_thread::sleep_for(450ms);
+    knobs.press(commands::dir::dec, xplm_CommandContinue);
+    ASSERT_TRUE(knobs.is_slewing());
+
+    // Long ticks count as 0.1s, i.e. 0.44 steps at 4.4 detents per second
+    knobs.advance(10.0f);
+    ASSERT_EQ(knobs.pending(selector::vs), 0.0f);
+
+    // Only whole steps move the dial, and the rest carries over
+    knobs.advance(0.05f);
+    knobs.advance(0.05f);
+    ASSERT_EQ(knobs.pending(selector::vs), 0.0f);
+    knobs.advance(0.05f);
+    ASSERT_EQ(knobs.pending(selector::vs), -100.0f);
+
+    // Releasing a held command adds no detent
+    knobs.press(commands::dir::dec, xplm_CommandEnd);
+    ASSERT_FALSE(knobs.is_slewing());
+    ASSERT_EQ(knobs.pending(selector::vs), -100.0f);
+    run_frame();
+    ASSERT_EQ(vs->value.f, 0.0f);
+}
+
+TEST_F(commands_test, slew) {
+    auto & knobs = plugin_->knobs();
+    knobs.select(selector::vs);
+    knobs.press(commands::dir::inc, xplm_CommandBegin);
+    std::this_thread::sleep_for(450ms);
+    knobs.press(commands::dir::inc, xplm_CommandContinue);
+    ASSERT_TRUE(knobs.is_slewing());
+
+    // At 120 frames per second the dial is still written every 50ms at most
+    auto vs = dial(vs_key, 0.0f);
+    for(int n = 0; n < 120; ++n) run_frame(1.0 / 120.0);
+    ASSERT_GT(vs->writes, 0);
+    ASSERT_LE(vs->writes, 21);
+    ASSERT_GT(vs->value.f, 0.0f);
+    ASSERT_EQ(std::fmod(vs->value.f, 100.0f), 0.0f);
+
+    knobs.press(commands::dir::inc, xplm_CommandEnd);
+    auto writes = vs->writes;
+    for(int n = 0; n < 10; ++n) run_frame();
+    ASSERT_EQ(vs->writes, writes);
+}
@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// tests/logger-test.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+
+#include <gtest/gtest.h>
+
+#include <logger.h>
+
+#include <XPLM/XPLMProcessing.h>
+#include <XPLM/XPLMUtilities.h>
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+static
+std::string
+take_output() {
+    std::lock_guard lock(xplm_debug_mutex());
+    std::string ret;
+    ret.swap(xplm_debug_output());
+    return ret;
+}
+
+static
+size_t
+count(const std::string & text, const std::string & pattern) {
+    size_t ret = 0;
+    for(auto pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) ++ret;
+    return ret;
+}
+
+TEST(logger_test, format) {
+    take_output();
+    log_warn() << "Value " << 42 << ' ' << -7L << " is " << 2.5f << " in " << std::filesystem::path("conf/c172.yaml")
+               << " (" << std::string("text") << ", " << true << ")";
+    logger() << "Info";
+    log_error() << "Error";
+    ASSERT_EQ(take_output(),
+        "[HCBravo] WARN: Value 42 -7 is 2.5 in \"conf/c172.yaml\" (text, 1)\n"
+        "[HCBravo] : Info\n"
+        "[HCBravo] ERROR: Error\n");
+}
+
+TEST(logger_test, level) {
+    // The default threshold compiles out trace and debug messages
+    static_assert(log_trace::enabled == false);
+    static_assert(log_debug::enabled == false);
+    static_assert(logger::enabled);
+    static_assert(sizeof(log_debug) < sizeof(logger));
+
+    take_output();
+    log_trace() << "Trace";
+    log_debug() << "Debug";
+    ASSERT_TRUE(take_output().empty());
+}
+
+TEST(logger_test, truncate) {
+    take_output();
+    logger() << std::string(4 * log_sink::max_size, 'x') << "end";
+    auto output = take_output();
+    ASSERT_LT(output.size(), log_sink::max_size);
+    ASSERT_EQ(output.find("end"), std::string::npos);
+    ASSERT_EQ(output.back(), '\n');
+}
+
+TEST(logger_test, rate) {
+    take_output();
+    for(uint32_t n = 0; n < 3 * log_sink::rate_burst; ++n) log_warn() << "Repeated";
+    logger() << "Other";
+    auto output = take_output();
+    ASSERT_EQ(count(output, "Repeated"), log_sink::rate_burst);
+    ASSERT_EQ(count(output, "Other"), 1);
+
+    // Once the window passes, the message gets through again along with how
+    // many copies were dropped
+    std::this_thread::sleep_for(log_sink::rate_window + std::chrono::milliseconds(10));
+    log_warn() << "Repeated";
+    ASSERT_EQ(take_output(), "[HCBravo] WARN: Repeated (and 10 more time(s))\n");
+}
+
+TEST(logger_test, drain) {
+    take_output();
+    logger::start();
+
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t) {
+        threads.emplace_back([t]() {
+            for(int n = 0; n < 16; ++n) logger() << "Thread " << t << " message " << n;
+        });
+    }
+    for(auto & thread : threads) thread.join();
+    logger() << "Sim thread";
+
+    // Messages wait for the drain flight loop
+    ASSERT_TRUE(take_output().empty());
+    xplm_sim::instance().run_frame(log_sink::drain_interval);
+    auto output = take_output();
+    ASSERT_EQ(count(output, "[HCBravo] : "), 4 * 16 + 1);
+    ASSERT_EQ(count(output, "Thread 3 message 15\n"), 1);
+
+    // Messages past the queue capacity are dropped and counted
+    for(size_t n = 0; n < log_sink::capacity + 10; ++n) logger() << "Burst " << n;
+    logger::stop();
+    output = take_output();
+    ASSERT_EQ(count(output, "Burst "), log_sink::capacity);
+    ASSERT_EQ(count(output, "[HCBravo] WARN: Dropped 10 log message(s)\n"), 1);
+
+    // Once stopped, messages are written right away
+    logger() << "Stopped";
+    ASSERT_EQ(take_output(), "[HCBravo] : Stopped\n");
+}
@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// tests/match-index-test.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+
+#include <gtest/gtest.h>
+
+#include <match-index.h>
+
+#include <string>
+#include <vector>
+
+static
+match_index
+build(const std::vector<std::pair<std::string, int32_t>> & rules)
+{
+    std::vector<match_index::rule> ret;
+    for(uint32_t owner = 0; owner < rules.size(); ++owner) {
+        ret.emplace_back(match_index::parse(rules[owner].first, rules[owner].second, owner));
+    }
+    return match_index::build(std::move(ret));
+}
+
+TEST(match_index_test, parse) {
+    ASSERT_EQ(match_index::parse("Cessna 172SP", 0, 0).kind_, match_index::kind::exact);
+    ASSERT_EQ(match_index::parse("Cessna 172*", 0, 0).kind_, match_index::kind::prefix);
+    ASSERT_EQ(match_index::parse("*", 0, 0).kind_, match_index::kind::prefix);
+    ASSERT_EQ(match_index::parse("Cessna * (G1000)", 0, 0).kind_, match_index::kind::glob);
+    ASSERT_EQ(match_index::parse("C1?2*", 0, 0).kind_, match_index::kind::glob);
+    ASSERT_EQ(match_index::parse("/C1[5-8]\\d/", 0, 0).kind_, match_index::kind::regex);
+    ASSERT_EQ(match_index::parse("/", 0, 0).kind_, match_index::kind::exact);
+}
+
+TEST(match_index_test, exact) {
+    std::vector<std::pair<std::string, int32_t>> rules;
+    for(int n = 0; n < 5000; ++n) rules.emplace_back("Aircraft " + std::to_string(n), 0);
+    auto index = build(rules);
+
+    // Every name lands on its own rule, and unknown names on none
+    for(uint32_t n = 0; n < rules.size(); ++n) {
+        const auto * rule = index.find(rules[n].first);
+        ASSERT_NE(rule, nullptr);
+        ASSERT_EQ(rule->owner_, n);
+    }
+    ASSERT_EQ(index.find("Aircraft 5000"), nullptr);
+    ASSERT_EQ(index.find(""), nullptr);
+    ASSERT_EQ(build({}).find("Aircraft 0"), nullptr);
+}
+
+TEST(match_index_test, prefix) {
+    auto index = build({ { "Cessna*", 0 }, { "Cessna 172*", 0 }, { "Cessna 172SP", 0 }, { "B*", 0 } });
+
+    // Exact names beat prefixes, and longer prefixes beat shorter ones
+    ASSERT_EQ(index.find("Cessna 172SP")->owner_, 2);
+    ASSERT_EQ(index.find("Cessna 172SP Floats")->owner_, 1);
+    ASSERT_EQ(index.find("Cessna 172")->owner_, 1);
+    ASSERT_EQ(index.find("Cessna 152")->owner_, 0);
+    ASSERT_EQ(index.find("Cessna")->owner_, 0);
+    ASSERT_EQ(index.find("B738")->owner_, 3);
+    ASSERT_EQ(index.find("Cess"), nullptr);
+    ASSERT_EQ(index.find("Airbus"), nullptr);
+}
+
+TEST(match_index_test, patterns) {
+    auto index = build({
+        { "Cessna Skyhawk (G1000)", 0 },
+        { "Cessna * (G1000)", 0 },
+        { "/C1[5-8]\\d/", 0 },
+        { "[!A]3[0-9]?", 0 },
+        { "/[/", 0 },
+    });
+
+    ASSERT_EQ(index.find("Cessna Skyhawk (G1000)")->owner_, 0);
+    ASSERT_EQ(index.find("Cessna Skyhawk (G1000) + REP"), nullptr);
+    ASSERT_EQ(index.find("Cessna Skylane (G1000)")->owner_, 1);
+    ASSERT_EQ(index.find("C172")->owner_, 2);
+    ASSERT_EQ(index.find("C192"), nullptr);
+    // Regular expressions match the whole name
+    ASSERT_EQ(index.find("C1725"), nullptr);
+    ASSERT_EQ(index.find("B320")->owner_, 3);
+    ASSERT_EQ(index.find("A320"), nullptr);
+    // Invalid regular expressions are dropped
+    ASSERT_EQ(index.find("["), nullptr);
+    ASSERT_EQ(index.size(), 5);
+}
+
+TEST(match_index_test, priority) {
+    auto index = build({
+        { "C172", 0 },
+        { "C172", 0 },
+        { "C1*", 1 },
+        { "/C17\\d/", 2 },
+        { "B738", 0 },
+        { "B738", 1 },
+    });
+
+    // Higher priorities win over more specific rules
+    const auto * rule = index.find("C172");
+    ASSERT_NE(rule, nullptr);
+    ASSERT_EQ(rule->owner_, 3);
+    ASSERT_EQ(rule->kind_, match_index::kind::regex);
+    ASSERT_EQ(index.find("C152")->owner_, 2);
+    ASSERT_EQ(index.find("B738")->owner_, 5);
+
+    // On ties, the first owner wins
+    index = build({ { "C172", 0 }, { "C172", 0 }, { "C*", 0 }, { "C*", 0 }, { "*72", 0 }, { "C?72", 0 } });
+    ASSERT_EQ(index.find("C172")->owner_, 0);
+    ASSERT_EQ(index.find("C182")->owner_, 2);
+    ASSERT_EQ(index.find("B772")->owner_, 4);
+
+    ASSERT_TRUE(match_index::precedes(index.rules()[0], index.rules()[2]));
+    ASSERT_TRUE(match_index::precedes(index.rules()[2], index.rules()[4]));
+    ASSERT_FALSE(match_index::precedes(index.rules()[1], index.rules()[0]));
+}
@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// tests/perf-test.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+
+#include <gtest/gtest.h>
+
+#include <perf.h>
+
+#include <XPLM/XPLMDataAccess.h>
+
+#include <string>
+
+static
+XPLMDataRef
+published(const std::string & key)
+{
+    for(auto data_ref : xplm_find_all(key)) {
+        if(data_ref->read_int != nullptr or data_ref->read_float != nullptr or data_ref->read_ints != nullptr) {
+            return data_ref;
+        }
+    }
+    return nullptr;
+}
+
+TEST(perf_test, bucket) {
+    ASSERT_EQ(perf_counter::bucket(0.0f), 0);
+    ASSERT_EQ(perf_counter::bucket(0.5f), 0);
+    ASSERT_EQ(perf_counter::bucket(1.0f), 1);
+    ASSERT_EQ(perf_counter::bucket(3.0f), 2);
+    ASSERT_EQ(perf_counter::bucket(1000.0f), 10);
+    ASSERT_EQ(perf_counter::bucket(1e9f), perf_counter::buckets - 1);
+}
+
+TEST(perf_test, counter) {
+    perf_counter counter;
+    auto stats = counter.read();
+    ASSERT_EQ(stats.max_, 0.0f);
+
+    counter.add(2.0f);
+    counter.add(4.0f);
+    counter.add(12.0f);
+    ASSERT_EQ(counter.count(), 3);
+    stats = counter.read();
+    ASSERT_EQ(stats.min_, 2.0f);
+    ASSERT_EQ(stats.avg_, 6.0f);
+    ASSERT_EQ(stats.max_, 12.0f);
+    ASSERT_EQ(stats.histogram_[2], 1);
+    ASSERT_EQ(stats.histogram_[3], 1);
+    ASSERT_EQ(stats.histogram_[4], 1);
+
+    // Only the latest window of samples counts
+    for(size_t n = 0; n < perf_counter::window; ++n) counter.add(1.0f);
+    stats = counter.read();
+    ASSERT_EQ(stats.min_, 1.0f);
+    ASSERT_EQ(stats.max_, 1.0f);
+    ASSERT_EQ(stats.histogram_[1], perf_counter::window);
+
+    counter.reset();
+    ASSERT_EQ(counter.count(), 0);
+    ASSERT_EQ(counter.read().avg_, 0.0f);
+}
+
+TEST(perf_test, timer) {
+    perf::enable(false);
+    { perf_timer timer(perf_id::evaluate); }
+    perf::sent();
+    ASSERT_EQ(perf::counter(perf_id::evaluate).count(), 0);
+    ASSERT_EQ(perf::sent_count(), 0);
+
+    perf::enable(true);
+    { perf_timer timer(perf_id::evaluate); }
+    perf::sent();
+    perf::skipped();
+    perf::skipped();
+    ASSERT_EQ(perf::counter(perf_id::evaluate).count(), 1);
+    ASSERT_EQ(perf::sent_count(), 1);
+    ASSERT_EQ(perf::skipped_count(), 2);
+
+    // Enabling again starts over
+    perf::enable(true);
+    ASSERT_EQ(perf::counter(perf_id::evaluate).count(), 0);
+    ASSERT_EQ(perf::skipped_count(), 0);
+    perf::enable(false);
+}
+
+TEST(perf_test, publish) {
+    perf::publish();
+    auto enabled = published("hcbravo/perf/enabled");
+    auto skipped = published("hcbravo/perf/led/skipped");
+    auto max = published("hcbravo/perf/hid_write/max");
+    auto count = published("hcbravo/perf/hid_write/count");
+    auto histogram = published("hcbravo/perf/hid_write/histogram");
+    ASSERT_NE(enabled, nullptr);
+    ASSERT_NE(skipped, nullptr);
+    ASSERT_NE(max, nullptr);
+    ASSERT_NE(count, nullptr);
+    ASSERT_NE(histogram, nullptr);
+    ASSERT_EQ(XPLMGetDatai(enabled), 0);
+
+    perf::enable(true);
+    perf::skipped();
+    perf::counter(perf_id::hid_write).add(100.0f);
+    perf::counter(perf_id::hid_write).add(300.0f);
+    ASSERT_EQ(XPLMGetDatai(enabled), 1);
+    ASSERT_EQ(XPLMGetDatai(skipped), 1);
+    ASSERT_EQ(XPLMGetDataf(max), 300.0f);
+    ASSERT_EQ(XPLMGetDatai(count), 2);
+
+    int values[perf_counter::buckets];
+    ASSERT_EQ(XPLMGetDatavi(histogram, nullptr, 0, 0), perf_counter::buckets);
+    ASSERT_EQ(XPLMGetDatavi(histogram, values, 7, 4), 4);
+    ASSERT_EQ(values[0], 1);
+    ASSERT_EQ(values[1], 0);
+    ASSERT_EQ(values[2], 1);
+    ASSERT_EQ(XPLMGetDatavi(histogram, values, perf_counter::buckets, 4), 0);
+
+    perf::enable(false);
+    perf::unpublish();
+    ASSERT_EQ(published("hcbravo/perf/enabled"), nullptr);
+}
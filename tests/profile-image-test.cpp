@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// tests/profile-image-test.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+
+#include <gtest/gtest.h>
+
+#define HCBRAVO_PROFILE_TESTS
+#include <profile.h>
+#include <profile-image.h>
+
+#include <filesystem>
+#include <fstream>
+
+class profile_image_test : public ::testing::Test {
+protected:
+    std::filesystem::path directory_;
+
+    void
+    SetUp() override {
+        directory_ = std::filesystem::temp_directory_path() /
+            (std::string("hcbravo-image-") + ::testing::UnitTest::GetInstance()->current_test_info()->name());
+        std::filesystem::remove_all(directory_);
+        std::filesystem::create_directories(directory_);
+    }
+
+    void
+    TearDown() override {
+        std::filesystem::remove_all(directory_);
+    }
+
+    std::filesystem::path
+    compile() {
+        auto yaml = profile::from_yaml(HCBRAVO_CONF_DIR "/c172.yaml");
+        EXPECT_TRUE(yaml.has_value());
+        auto path = directory_ / "c172.hcbp";
+        EXPECT_TRUE(profile_image::write(*yaml.value(), path).has_value());
+        return path;
+    }
+};
+
+TEST_F(profile_image_test, round_trip) {
+    auto image = profile_image::load(compile());
+    ASSERT_TRUE(image.has_value());
+    const auto & plane = image.value();
+
+    ASSERT_EQ(plane->name(), "Cessna 172S");
+    ASSERT_EQ(plane->models(), std::vector<std::string>{ "C172" });
+    ASSERT_EQ(plane->aircrafts().size(), 2);
+    ASSERT_TRUE(plane->autopilot().has_value());
+    ASSERT_TRUE(plane->autopilot().value().dials().has_value());
+    ASSERT_TRUE(plane->autopilot().value().dials().value().ias().has_value());
+    ASSERT_TRUE(plane->annunciator().has_value());
+    ASSERT_FALSE(plane->system().gear().has_value());
+
+    // Images resolve and compile to the same predicates as the YAML profile
+    auto yaml = profile::from_yaml(HCBRAVO_CONF_DIR "/c172.yaml");
+    ASSERT_TRUE(yaml.has_value());
+    ASSERT_TRUE(yaml.value()->resolve());
+    ASSERT_TRUE(plane->resolve());
+    ASSERT_EQ(plane->leds().size(), yaml.value()->leds().size());
+    ASSERT_EQ(plane->leds().groups(), yaml.value()->leds().groups());
+
+    const auto & hdg = plane->autopilot().value().mode().hdg_data_ref();
+    ASSERT_TRUE(hdg.has_value());
+    ASSERT_EQ(hdg.value().data().front().data_ref()->name, "sim/cockpit2/autopilot/heading_mode");
+
+    led_mask mask;
+    ASSERT_FALSE(plane->leds().evaluate(mask));
+    plane->system().volts_data_ref().data().front().data_ref()->value.f = 24.0f;
+    // HDG is on for modes 1 and 14 only
+    hdg.value().data().front().data_ref()->value.i = 14;
+    ASSERT_TRUE(plane->leds().evaluate(mask));
+    ASSERT_TRUE(mask.get(LED_AP_HDG));
+    ASSERT_TRUE(mask.get(LED_ANC_ANTI_ICE));
+}
+
+TEST_F(profile_image_test, knobs) {
+    auto yaml = directory_ / "knobs.yaml";
+    {
+        std::ofstream output(yaml);
+        output << "name: Knobs\nmodels:\n - TEST\nsystem:\n  volts: sim/volts\n"
+               << "knobs:\n  window: 0.5\n  hdg:\n   - { rate: 0, step: 1 }\n   - { rate: 20, step: 10 }\n";
+    }
+    auto profile = profile::from_yaml(yaml.string());
+    ASSERT_TRUE(profile.has_value());
+    auto path = directory_ / "knobs.hcbp";
+    ASSERT_TRUE(profile_image::write(*profile.value(), path).has_value());
+
+    auto image = profile_image::load(path);
+    ASSERT_TRUE(image.has_value());
+    const auto & knobs = image.value()->knobs();
+    ASSERT_EQ(knobs.window(), 0.5f);
+    ASSERT_FALSE(knobs.curve(0).has_value());
+    ASSERT_TRUE(knobs.curve(2).has_value());
+    ASSERT_EQ(knobs.curve(2).value().stages().size(), 2);
+    ASSERT_EQ(knobs.curve(2).value().step(25.0f), 10.0f);
+}
+
+TEST_F(profile_image_test, corrupted) {
+    auto path = compile();
+    auto size = std::filesystem::file_size(path);
+
+    // Truncated images are rejected
+    std::filesystem::resize_file(path, size - 4);
+    ASSERT_FALSE(profile_image::load(path).has_value());
+
+    // And so are images with a bad magic number
+    path = compile();
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.write("YAML", 4);
+    }
+    ASSERT_FALSE(profile_image::load(path).has_value());
+
+    ASSERT_FALSE(profile_image::load(directory_ / "missing.hcbp").has_value());
+}
+
+TEST_F(profile_image_test, freshness) {
+    auto yaml = directory_ / "c172.yaml";
+    std::filesystem::copy_file(HCBRAVO_CONF_DIR "/c172.yaml", yaml);
+    ASSERT_EQ(profile_image::path_for(yaml), directory_ / "c172.hcbp");
+    ASSERT_FALSE(profile_image::is_fresh(yaml));
+
+    auto image = compile();
+    auto now = std::filesystem::last_write_time(yaml);
+    std::filesystem::last_write_time(image, now);
+    ASSERT_TRUE(profile_image::is_fresh(yaml));
+
+    // Editing the YAML profile makes the image stale
+    std::filesystem::last_write_time(yaml, now + std::chrono::seconds(1));
+    ASSERT_FALSE(profile_image::is_fresh(yaml));
+}
+
+TEST_F(profile_image_test, extends) {
+    std::filesystem::copy_file(HCBRAVO_CONF_DIR "/c172.yaml", directory_ / "c172.yaml");
+    auto yaml = directory_ / "variant.yaml";
+    {
+        std::ofstream output(yaml);
+        output << "name: Variant\nmodels:\n - C72R\nextends: c172.yaml\nrefresh:\n  frames: 2\n";
+    }
+    auto profile = profile::from_yaml(yaml.string());
+    ASSERT_TRUE(profile.has_value());
+    auto path = directory_ / "variant.hcbp";
+    ASSERT_TRUE(profile_image::write(*profile.value(), path).has_value());
+
+    // Images only hold the sections of their own profile
+    auto full = profile::from_yaml((directory_ / "c172.yaml").string());
+    ASSERT_TRUE(profile_image::write(*full.value(), directory_ / "c172.hcbp").has_value());
+    ASSERT_LT(std::filesystem::file_size(path), std::filesystem::file_size(directory_ / "c172.hcbp"));
+
+    auto image = profile_image::load(path);
+    ASSERT_TRUE(image.has_value());
+    const auto & plane = image.value();
+    ASSERT_EQ(plane->name(), "Variant");
+    ASSERT_EQ(plane->base().get(), profile.value()->base().get());
+    ASSERT_EQ(plane->refresh().interval(), -2.0f);
+    ASSERT_TRUE(plane->annunciator().has_value());
+    ASSERT_TRUE(plane->resolve());
+    ASSERT_TRUE(full.value()->resolve());
+    ASSERT_EQ(plane->leds().size(), full.value()->leds().size());
+}
@@ -10,66 +10,116 @@
 
 #define HCBRAVO_PROFILE_TESTS
 #include <profile.h>
-
-
-TEST(profile_test, bool_data_ref) {
+#include <scheduler.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+// DataRefs are shared by every profile, so each test starts from fresh ones
+class profile_test : public ::testing::Test {
+protected:
+    void
+    SetUp() override {
+        data_ref_registry::instance().reset();
+    }
+};
+
+TEST_F(profile_test, bool_data_ref) {
+    data_ref_table keys;
     auto node = YAML::Load(R"(
 tag:
   - key: 'sim/test/bool'
     )");
-    auto data_ref = value_data_ref(node["tag"]);
+    auto data_ref = value_data_ref(node["tag"], keys);
+    keys.resolve();
     ASSERT_FALSE(data_ref.data().empty());
 
-    ASSERT_EQ(data_ref.data().front()->data_ref()->name, "sim/test/bool");
+    ASSERT_EQ(data_ref.data().front().data_ref()->name, "sim/test/bool");
 }
 
-TEST(profile_test, bool_data_ref_unset) {
+TEST_F(profile_test, bool_data_ref_unset) {
+    data_ref_table keys;
     auto node = YAML::Load(R"(
 tag:
   - key: 'sim/test/bool'
     )");
-    auto data_ref = value_data_ref(node["tag"]);
+    auto data_ref = value_data_ref(node["tag"], keys);
+    keys.resolve();
     ASSERT_FALSE(data_ref.data().empty());
     ASSERT_FALSE(data_ref.is_set());
 }
 
 
-TEST(profile_test, bool_data_ref_set) {
+TEST_F(profile_test, bool_data_ref_set) {
+    data_ref_table keys;
     auto node = YAML::Load(R"(
 tag:
   - key: 'sim/test/bool'
     )");
-    auto data_ref = value_data_ref(node["tag"]);
+    auto data_ref = value_data_ref(node["tag"], keys);
+    keys.resolve();
     ASSERT_FALSE(data_ref.data().empty());
-    data_ref.data().front()->data_ref()->value.i = 1;
+    data_ref.data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.is_set());
 }
 
 
 
-TEST(profile_test, invalid_data_ref) {
+TEST_F(profile_test, invalid_data_ref) {
+    data_ref_table keys;
     auto node = YAML::Load(R"(
 tag:
   - no_key: 'something/else'
     )");
-    auto data_ref = value_data_ref(node["tag"]);
+    auto data_ref = value_data_ref(node["tag"], keys);
+    keys.resolve();
     ASSERT_TRUE(data_ref.data().empty());
 }
 
-TEST(profile_test, multiple_bool_data_ref) {
+TEST_F(profile_test, malformed_data_ref) {
+    data_ref_table keys;
+    auto node = YAML::Load(R"(
+tag:
+  - key: 'sim/test/invert'
+    invert: maybe
+  - key: 'sim/test/index'
+    index: first
+  - key: 'sim/test/values'
+    type: int
+    values: [abc]
+  - key: [ 'sim/test/key' ]
+  - key: 'sim/test/type'
+    type: [ int ]
+  - key: 'sim/test/good'
+    )");
+    // Malformed values are rejected rather than thrown
+    auto values = value_data_ref(node["tag"], keys);
+    keys.resolve();
+    ASSERT_EQ(values.data().size(), 1);
+    ASSERT_EQ(values.data().front().data_ref()->name, "sim/test/good");
+
+    ASSERT_FALSE(data_ref<float>::build(YAML::Load("{key: 'sim/test/dial', values: [fast]}"), keys).has_value());
+    ASSERT_FALSE(profile_header::build(YAML::Load("{name: [a], models: [C172]}")).has_value());
+}
+
+TEST_F(profile_test, multiple_bool_data_ref) {
+    data_ref_table keys;
     auto node = YAML::Load(R"(
 tag:
   - key: 'sim/test/first'
   - key: 'sim/test/second'
     )");
-    auto data_ref = value_data_ref(node["tag"]);
+    auto data_ref = value_data_ref(node["tag"], keys);
+    keys.resolve();
     ASSERT_EQ(data_ref.data().size(), 2);
     
-    ASSERT_EQ(data_ref.data()[0]->data_ref()->name, "sim/test/first");
-    ASSERT_EQ(data_ref.data()[1]->data_ref()->name, "sim/test/second");
+    ASSERT_EQ(data_ref.data()[0].data_ref()->name, "sim/test/first");
+    ASSERT_EQ(data_ref.data()[1].data_ref()->name, "sim/test/second");
 }
 
-TEST(profile_test, int_data_ref) {
+TEST_F(profile_test, int_data_ref) {
+    data_ref_table keys;
     auto node = YAML::Load(R"(
 tag:
   - key: 'sim/test/unsigned'
@@ -79,12 +129,14 @@ tag:
       - 2
       - 5
     )");
-    auto data_ref = value_data_ref(node["tag"]);
+    auto data_ref = value_data_ref(node["tag"], keys);
+    keys.resolve();
     ASSERT_FALSE(data_ref.data().empty());
-    ASSERT_EQ(data_ref.data().front()->data_ref()->name, "sim/test/unsigned");
+    ASSERT_EQ(data_ref.data().front().data_ref()->name, "sim/test/unsigned");
 }
 
-TEST(profile_test, int_data_ref_set) {
+TEST_F(profile_test, int_data_ref_set) {
+    data_ref_table keys;
     auto node = YAML::Load(R"(
 tag:
   - key: 'sim/test/unsigned'
@@ -94,20 +146,22 @@ tag:
       - 2
       - 5
     )");
-    auto data_ref = value_data_ref(node["tag"]);
+    auto data_ref = value_data_ref(node["tag"], keys);
+    keys.resolve();
     ASSERT_FALSE(data_ref.data().empty());
 
-    data_ref.data().front()->data_ref()->value.i = 1;
+    data_ref.data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.is_set());
 
-    data_ref.data().front()->data_ref()->value.i = 2;
+    data_ref.data().front().data_ref()->value.i = 2;
     ASSERT_TRUE(data_ref.is_set());
 
-    data_ref.data().front()->data_ref()->value.i = 5;
+    data_ref.data().front().data_ref()->value.i = 5;
     ASSERT_TRUE(data_ref.is_set());
 }
 
-TEST(profile_test, int_data_ref_unset) {
+TEST_F(profile_test, int_data_ref_unset) {
+    data_ref_table keys;
     auto node = YAML::Load(R"(
 tag:
   - key: 'sim/test/unsigned'
@@ -117,15 +171,48 @@ tag:
       - 2
       - 5
     )");
-    auto data_ref = value_data_ref(node["tag"]);
+    auto data_ref = value_data_ref(node["tag"], keys);
+    keys.resolve();
     ASSERT_FALSE(data_ref.data().empty());
     ASSERT_FALSE(data_ref.is_set());
 
-    data_ref.data().front()->data_ref()->value.i = 4;
+    data_ref.data().front().data_ref()->value.i = 4;
+    ASSERT_FALSE(data_ref.is_set());
+}
+
+TEST_F(profile_test, mixed_data_ref) {
+    data_ref_table keys;
+    auto node = YAML::Load(R"(
+tag:
+  - key: 'sim/test/bool'
+    invert: true
+  - key: 'sim/test/unsigned'
+    type: int
+    values:
+      - 3
+  - key: 'sim/test/float'
+    type: float
+    values:
+      - 0.5
+    )");
+    auto data_ref = value_data_ref(node["tag"], keys);
+    keys.resolve();
+    ASSERT_EQ(data_ref.data().size(), 3);
+    ASSERT_TRUE(data_ref.is_set());
+
+    data_ref.data()[0].data_ref()->value.i = 1;
     ASSERT_FALSE(data_ref.is_set());
+
+    data_ref.data()[1].data_ref()->value.i = 3;
+    ASSERT_TRUE(data_ref.is_set());
+
+    data_ref.data()[1].data_ref()->value.i = 0;
+    data_ref.data()[2].data_ref()->value.f = 0.5f;
+    ASSERT_TRUE(data_ref.is_set());
 }
 
-TEST(profile_test, autopilot_mode) {
+TEST_F(profile_test, autopilot_mode) {
+    data_ref_table keys;
     auto node = YAML::Load(R"(
 modes:
  hdg:
@@ -152,7 +239,8 @@ modes:
   - key: 'sim/cockpit2/autopilot/servos_on'
     )");
 
-    auto data_ref_opt = autopilot_mode_data_ref::build(node["modes"]);
+    auto data_ref_opt = autopilot_mode_data_ref::build(node["modes"], keys);
+    keys.resolve();
     ASSERT_TRUE(data_ref_opt.has_value());
 
     auto data_ref = std::move(data_ref_opt.value());
@@ -180,47 +268,49 @@ modes:
     ASSERT_FALSE(data_ref.ap());
 
     ASSERT_TRUE(data_ref.hdg_data_ref().has_value());
-    data_ref.hdg_data_ref().value().data().front()->data_ref()->value.i = 13;
+    data_ref.hdg_data_ref().value().data().front().data_ref()->value.i = 13;
     ASSERT_TRUE(data_ref.hdg().value());
 
     ASSERT_TRUE(data_ref.nav_data_ref().has_value());
-    data_ref.nav_data_ref().value().data()[0]->data_ref()->value.i = 1;
+    data_ref.nav_data_ref().value().data()[0].data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.nav().value());
-    data_ref.nav_data_ref().value().data()[0]->data_ref()->value.i = 0;
-    data_ref.nav_data_ref().value().data()[0]->data_ref()->value.i = 1;
+    data_ref.nav_data_ref().value().data()[0].data_ref()->value.i = 0;
+    data_ref.nav_data_ref().value().data()[0].data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.nav().value());
 
     ASSERT_TRUE(data_ref.apr_data_ref().has_value());
-    data_ref.apr_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.apr_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.apr().value());
 
     ASSERT_TRUE(data_ref.rev_data_ref().has_value());
-    data_ref.rev_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.rev_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.rev().value());
 
     ASSERT_TRUE(data_ref.alt_data_ref().has_value());
-    data_ref.alt_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.alt_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.alt().value());
 
     ASSERT_TRUE(data_ref.vs_data_ref().has_value());
-    data_ref.vs_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.vs_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.vs().value());
 
     ASSERT_TRUE(data_ref.ias_data_ref().has_value());
-    data_ref.ias_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.ias_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.ias().value());
 
-    data_ref.ap_data_ref().data().front()->data_ref()->value.i = 1;
+    data_ref.ap_data_ref().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.ap());
 }
 
-TEST(profile_test, autopilot_mode_minimal) {
+TEST_F(profile_test, autopilot_mode_minimal) {
+    data_ref_table keys;
     auto node = YAML::Load(R"(
 modes:
  ap:
   - key: 'sim/cockpit2/autopilot/servos_on'
     )");
-    auto data_ref_opt = autopilot_mode_data_ref::build(node["modes"]);
+    auto data_ref_opt = autopilot_mode_data_ref::build(node["modes"], keys);
+    keys.resolve();
     ASSERT_TRUE(data_ref_opt.has_value());
 
     auto data_ref = std::move(data_ref_opt.value());
@@ -233,11 +323,12 @@ modes:
     ASSERT_FALSE(data_ref.ias().has_value());
     ASSERT_FALSE(data_ref.ap());
 
-    data_ref.ap_data_ref().data().front()->data_ref()->value.i = 1;
+    data_ref.ap_data_ref().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.ap());
 }
 
-TEST(profile_test, autopilot_mode_kap140) {
+TEST_F(profile_test, autopilot_mode_kap140) {
+    data_ref_table keys;
     auto node = YAML::Load(R"(
 modes:
  hdg:
@@ -260,7 +351,8 @@ modes:
   - key: 'sim/cockpit2/autopilot/servos_on'
     )");
 
-    auto data_ref_opt = autopilot_mode_data_ref::build(node["modes"]);
+    auto data_ref_opt = autopilot_mode_data_ref::build(node["modes"], keys);
+    keys.resolve();
     ASSERT_TRUE(data_ref_opt.has_value());
 
     auto data_ref = std::move(data_ref_opt.value());
@@ -286,33 +378,34 @@ modes:
     ASSERT_FALSE(data_ref.ap());
 
     ASSERT_TRUE(data_ref.hdg_data_ref().has_value());
-    data_ref.hdg_data_ref().value().data().front()->data_ref()->value.i = 13;
+    data_ref.hdg_data_ref().value().data().front().data_ref()->value.i = 13;
     ASSERT_TRUE(data_ref.hdg().value());
 
     ASSERT_TRUE(data_ref.nav_data_ref().has_value());
-    data_ref.nav_data_ref().value().data()[0]->data_ref()->value.i = 1;
+    data_ref.nav_data_ref().value().data()[0].data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.nav().value());
-    data_ref.nav_data_ref().value().data()[0]->data_ref()->value.i = 0;
-    data_ref.nav_data_ref().value().data()[0]->data_ref()->value.i = 1;
+    data_ref.nav_data_ref().value().data()[0].data_ref()->value.i = 0;
+    data_ref.nav_data_ref().value().data()[0].data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.nav().value());
 
     ASSERT_TRUE(data_ref.apr_data_ref().has_value());
-    data_ref.apr_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.apr_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.apr().value());
 
     ASSERT_TRUE(data_ref.alt_data_ref().has_value());
-    data_ref.alt_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.alt_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.alt().value());
 
     ASSERT_TRUE(data_ref.vs_data_ref().has_value());
-    data_ref.vs_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.vs_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.vs().value());
 
-    data_ref.ap_data_ref().data().front()->data_ref()->value.i = 1;
+    data_ref.ap_data_ref().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.ap());
 }
 
-TEST(profile_test, autopilot_dial) {
+TEST_F(profile_test, autopilot_dial) {
+  data_ref_table keys;
   auto node = YAML::Load(R"(
 dials:
   ias:
@@ -324,7 +417,8 @@ dials:
   alt: 'sim/cockpit/autopilot/current_altitude'
   )");
 
-  auto data_ref_opt = autopilot_dial_data_ref::build(node["dials"]);
+  auto data_ref_opt = autopilot_dial_data_ref::build(node["dials"], keys);
+  keys.resolve();
   ASSERT_TRUE(data_ref_opt.has_value());
 
   auto data_ref = std::move(data_ref_opt.value());
@@ -357,7 +451,8 @@ dials:
   ASSERT_EQ(data_ref.alt().value().get(), -1.5f);
 }
 
-TEST(profile_test, autopilot_dial_kap140) {
+TEST_F(profile_test, autopilot_dial_kap140) {
+  data_ref_table keys;
    auto node = YAML::Load(R"(
 dials:
   course: 'sim/cockpit2/radios/actuators/nav1_obs_deg_mag_pilot'
@@ -366,7 +461,8 @@ dials:
   alt: 'sim/cockpit/autopilot/current_altitude'
   )");
 
-  auto data_ref_opt = autopilot_dial_data_ref::build(node["dials"]);
+  auto data_ref_opt = autopilot_dial_data_ref::build(node["dials"], keys);
+  keys.resolve();
   ASSERT_TRUE(data_ref_opt.has_value());
 
   auto data_ref = std::move(data_ref_opt.value());
@@ -374,7 +470,8 @@ dials:
  
 }
 
-TEST(profile_test, system) {
+TEST_F(profile_test, system) {
+    data_ref_table keys;
     auto node = YAML::Load(R"(
 system:
  volts:
@@ -384,7 +481,8 @@ system:
 
     )");
 
-    auto data_ref_opt = system_data_ref::build(node["system"]);
+    auto data_ref_opt = system_data_ref::build(node["system"], keys);
+    keys.resolve();
     ASSERT_TRUE(data_ref_opt.has_value());
 
     auto data_ref = std::move(data_ref_opt.value());
@@ -392,32 +490,35 @@ system:
     ASSERT_TRUE(data_ref.gear().has_value());
     ASSERT_FALSE(data_ref.gear().value());
 
-    data_ref.volts_data_ref().data().front()->data_ref()->value.f = 1.0f;
+    data_ref.volts_data_ref().data().front().data_ref()->value.f = 1.0f;
     ASSERT_TRUE(data_ref.volts());
 
-    data_ref.gear_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.gear_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.gear());
 }
 
-TEST(profile_test, system_no_gear) {
+TEST_F(profile_test, system_no_gear) {
+    data_ref_table keys;
     auto node = YAML::Load(R"(
 system:
  volts:
   - key: 'sim/cockpit2/electrical/bus_volts'
     )");
 
-    auto data_ref_opt = system_data_ref::build(node["system"]);
+    auto data_ref_opt = system_data_ref::build(node["system"], keys);
+    keys.resolve();
     ASSERT_TRUE(data_ref_opt.has_value());
 
     auto data_ref = std::move(data_ref_opt.value());
     ASSERT_FALSE(data_ref.volts());
     ASSERT_FALSE(data_ref.gear().has_value());
 
-    data_ref.volts_data_ref().data().front()->data_ref()->value.f = 1.0f;
+    data_ref.volts_data_ref().data().front().data_ref()->value.f = 1.0f;
     ASSERT_TRUE(data_ref.volts());
 }
 
-TEST(profile_test, annunciator) {
+TEST_F(profile_test, annunciator) {
+    data_ref_table keys;
   auto node = YAML::Load(R"(
 annunciator:
  master_warn:
@@ -455,98 +556,100 @@ annunciator:
     )");
 
 
-    auto data_ref_opt = annunciator_data_ref::build(node["annunciator"]);
+    auto data_ref_opt = annunciator_data_ref::build(node["annunciator"], keys);
+    keys.resolve();
     ASSERT_TRUE(data_ref_opt.has_value());
     auto data_ref = std::move(data_ref_opt.value());
 
     ASSERT_TRUE(data_ref.master_warn().has_value());
     ASSERT_FALSE(data_ref.master_warn().value());
-    data_ref.master_warn_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.master_warn_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.master_warn().value());
 
     ASSERT_TRUE(data_ref.eng_fire().has_value());
     ASSERT_FALSE(data_ref.eng_fire().value());
-    data_ref.eng_fire_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.eng_fire_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.eng_fire().value());
 
     ASSERT_TRUE(data_ref.oil_low().has_value());
     ASSERT_FALSE(data_ref.oil_low().value());
-    data_ref.oil_low_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.oil_low_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.oil_low().value());
 
     ASSERT_TRUE(data_ref.fuel_low().has_value());
     ASSERT_FALSE(data_ref.fuel_low().value());
-    data_ref.fuel_low_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.fuel_low_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.fuel_low().value());
 
     ASSERT_TRUE(data_ref.anti_ice().has_value());
     ASSERT_FALSE(data_ref.anti_ice().value());
-    data_ref.anti_ice_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.anti_ice_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.anti_ice().value());
 
     ASSERT_TRUE(data_ref.starter().has_value());
     ASSERT_FALSE(data_ref.starter().value());
-    data_ref.starter_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.starter_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.starter().value());
 
     ASSERT_TRUE(data_ref.apu().has_value());
     ASSERT_FALSE(data_ref.apu().value());
-    data_ref.apu_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.apu_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.apu().value());
 
     ASSERT_TRUE(data_ref.master_caution().has_value());
     ASSERT_FALSE(data_ref.master_caution().value());
-    data_ref.master_caution_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.master_caution_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.master_caution().value());
 
     ASSERT_TRUE(data_ref.vacuum_low().has_value());
     ASSERT_FALSE(data_ref.vacuum_low().value());
-    data_ref.vacuum_low_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.vacuum_low_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.vacuum_low().value());
 
     ASSERT_TRUE(data_ref.hydro_low().has_value());
     ASSERT_FALSE(data_ref.hydro_low().value());
-    data_ref.hydro_low_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.hydro_low_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.hydro_low().value());
 
     ASSERT_TRUE(data_ref.parking_brake().has_value());
     ASSERT_FALSE(data_ref.parking_brake().value());
-    data_ref.parking_brake_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.parking_brake_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.parking_brake().value());
 
     ASSERT_TRUE(data_ref.volt_low().has_value());
     ASSERT_FALSE(data_ref.volt_low().value());
-    data_ref.volt_low_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.volt_low_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.volt_low().value());
 
     ASSERT_TRUE(data_ref.aux_fuel().has_value());
     ASSERT_FALSE(data_ref.aux_fuel().value());
-    data_ref.aux_fuel_data_ref().value().data()[0]->data_ref()->value.i = 1;
+    data_ref.aux_fuel_data_ref().value().data()[0].data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.aux_fuel().value());
-    data_ref.aux_fuel_data_ref().value().data()[0]->data_ref()->value.i = 0;
+    data_ref.aux_fuel_data_ref().value().data()[0].data_ref()->value.i = 0;
     ASSERT_FALSE(data_ref.aux_fuel().value());
-    data_ref.aux_fuel_data_ref().value().data()[1]->data_ref()->value.i = 1;
+    data_ref.aux_fuel_data_ref().value().data()[1].data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.aux_fuel().value());
-    data_ref.aux_fuel_data_ref().value().data()[1]->data_ref()->value.i = 0;
+    data_ref.aux_fuel_data_ref().value().data()[1].data_ref()->value.i = 0;
     ASSERT_FALSE(data_ref.aux_fuel().value());
  
     ASSERT_TRUE(data_ref.door_open().has_value());
     ASSERT_FALSE(data_ref.door_open().value());
-    data_ref.door_open_data_ref().value().data()[0]->data_ref()->value.i = 1;
+    data_ref.door_open_data_ref().value().data()[0].data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.door_open().value());
-    data_ref.door_open_data_ref().value().data()[0]->data_ref()->value.i = 0;
+    data_ref.door_open_data_ref().value().data()[0].data_ref()->value.i = 0;
     ASSERT_FALSE(data_ref.door_open().value());
-    data_ref.door_open_data_ref().value().data()[1]->data_ref()->value.i = 1;
+    data_ref.door_open_data_ref().value().data()[1].data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.door_open().value());
-    data_ref.door_open_data_ref().value().data()[1]->data_ref()->value.i = 0;
+    data_ref.door_open_data_ref().value().data()[1].data_ref()->value.i = 0;
     ASSERT_FALSE(data_ref.door_open().value());
-     data_ref.door_open_data_ref().value().data()[2]->data_ref()->value.i = 1;
+     data_ref.door_open_data_ref().value().data()[2].data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.door_open().value());
-    data_ref.door_open_data_ref().value().data()[2]->data_ref()->value.i = 0;
+    data_ref.door_open_data_ref().value().data()[2].data_ref()->value.i = 0;
     ASSERT_FALSE(data_ref.door_open().value());
 }
 
-TEST(profile_test, annunciator_min) {
+TEST_F(profile_test, annunciator_min) {
+    data_ref_table keys;
   auto node = YAML::Load(R"(
 annunciator:
  master_warn:
@@ -566,43 +669,44 @@ annunciator:
     )");
 
 
-    auto data_ref_opt = annunciator_data_ref::build(node["annunciator"]);
+    auto data_ref_opt = annunciator_data_ref::build(node["annunciator"], keys);
+    keys.resolve();
     ASSERT_TRUE(data_ref_opt.has_value());
     auto data_ref = std::move(data_ref_opt.value());
 
     ASSERT_TRUE(data_ref.master_warn().has_value());
     ASSERT_FALSE(data_ref.master_warn().value());
-    data_ref.master_warn_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.master_warn_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.master_warn().value());
 
     ASSERT_TRUE(data_ref.oil_low().has_value());
     ASSERT_FALSE(data_ref.oil_low().value());
-    data_ref.oil_low_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.oil_low_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.oil_low().value());
 
     ASSERT_TRUE(data_ref.fuel_low().has_value());
     ASSERT_FALSE(data_ref.fuel_low().value());
-    data_ref.fuel_low_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.fuel_low_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.fuel_low().value());
 
     ASSERT_TRUE(data_ref.starter().has_value());
     ASSERT_FALSE(data_ref.starter().value());
-    data_ref.starter_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.starter_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.starter().value());
 
     ASSERT_TRUE(data_ref.master_caution().has_value());
     ASSERT_FALSE(data_ref.master_caution().value());
-    data_ref.master_caution_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.master_caution_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.master_caution().value());
 
     ASSERT_TRUE(data_ref.vacuum_low().has_value());
     ASSERT_FALSE(data_ref.vacuum_low().value());
-    data_ref.vacuum_low_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.vacuum_low_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.vacuum_low().value());
 
     ASSERT_TRUE(data_ref.volt_low().has_value());
     ASSERT_FALSE(data_ref.volt_low().value());
-    data_ref.volt_low_data_ref().value().data().front()->data_ref()->value.i = 1;
+    data_ref.volt_low_data_ref().value().data().front().data_ref()->value.i = 1;
     ASSERT_TRUE(data_ref.volt_low().value());
 
     ASSERT_FALSE(data_ref.eng_fire().has_value());
@@ -612,4 +716,382 @@ annunciator:
     ASSERT_FALSE(data_ref.parking_brake().has_value());
     ASSERT_FALSE(data_ref.aux_fuel().has_value());
     ASSERT_FALSE(data_ref.door_open().has_value());
-}
\ No newline at end of file
+}
+
+TEST_F(profile_test, lazy_resolution) {
+    data_ref_table keys;
+    auto node = YAML::Load(R"(
+tag:
+  - key: 'sim/test/lazy'
+  - key: 'sim/test/lazy'
+    invert: true
+  - key: 'sim/test/other'
+    )");
+    auto data_ref = value_data_ref(node["tag"], keys);
+    ASSERT_EQ(data_ref.data().size(), 3);
+    // Repeated keys are interned, and nothing is looked up while parsing
+    ASSERT_EQ(keys.size(), 2);
+    ASSERT_FALSE(keys.complete());
+    ASSERT_EQ(data_ref.data()[0].data_ref(), nullptr);
+    ASSERT_FALSE(data_ref.is_set());
+
+    ASSERT_EQ(keys.resolve(), 2);
+    ASSERT_TRUE(keys.complete());
+    ASSERT_NE(data_ref.data()[0].data_ref(), nullptr);
+    ASSERT_EQ(data_ref.data()[0].data_ref(), data_ref.data()[1].data_ref());
+    ASSERT_TRUE(data_ref.is_set());
+
+    // Resolved handles are kept
+    ASSERT_EQ(keys.resolve(), 0);
+}
+
+TEST_F(profile_test, shared_resolution) {
+    data_ref_registry registry;
+    data_ref_table first(registry);
+    data_ref_table second(registry);
+    auto a = first.intern("sim/test/shared", false);
+    auto b = second.intern("sim/test/other", false);
+    auto c = second.intern("sim/test/shared", true);
+    // Keys are numbered per table, but stored once
+    ASSERT_EQ(a, 0);
+    ASSERT_EQ(c, 1);
+    ASSERT_EQ(registry.size(), 2);
+    ASSERT_EQ(second.key(c), "sim/test/shared");
+
+    ASSERT_EQ(first.resolve(), 1);
+    ASSERT_EQ(second.resolve(), 2);
+    ASSERT_EQ(registry.lookups(), 2);
+    ASSERT_EQ(first.handle(a), second.handle(c));
+    ASSERT_NE(second.handle(b), second.handle(c));
+}
+
+TEST_F(profile_test, predicate_table) {
+    data_ref_table keys;
+    auto node = YAML::Load(R"(
+volts:
+  - key: 'sim/test/volts'
+    type: float
+gear:
+  - key: 'sim/test/gear'
+    type: int
+    values:
+      - 1
+      - 2
+    )");
+    auto volts = value_data_ref(node["volts"], keys);
+    auto gear = value_data_ref(node["gear"], keys);
+    keys.resolve();
+
+    predicate_table table;
+    volts.compile(table, predicate_table::power_group);
+    auto group = table.add_group();
+    gear.compile(table, group);
+    table.add_output(group, LED_LDG_L_GREEN);
+    table.add_output(group, LED_LDG_L_RED, true);
+    ASSERT_EQ(table.size(), 2);
+
+    led_mask mask;
+    ASSERT_FALSE(table.evaluate(mask));
+    ASSERT_FALSE(mask.get(LED_LDG_L_RED));
+
+    volts.data().front().data_ref()->value.f = 28.0f;
+    ASSERT_TRUE(table.evaluate(mask));
+    ASSERT_FALSE(mask.get(LED_LDG_L_GREEN));
+    ASSERT_TRUE(mask.get(LED_LDG_L_RED));
+
+    gear.data().front().data_ref()->value.i = 2;
+    mask = led_mask();
+    ASSERT_TRUE(table.evaluate(mask));
+    ASSERT_TRUE(mask.get(LED_LDG_L_GREEN));
+    ASSERT_FALSE(mask.get(LED_LDG_L_RED));
+
+    gear.data().front().data_ref()->value.i = 3;
+    mask = led_mask();
+    ASSERT_TRUE(table.evaluate(mask));
+    ASSERT_FALSE(mask.get(LED_LDG_L_GREEN));
+    ASSERT_TRUE(mask.get(LED_LDG_L_RED));
+}
+
+TEST_F(profile_test, compiled_profile) {
+    auto profile_opt = profile::from_yaml(HCBRAVO_CONF_DIR "/c172.yaml");
+    ASSERT_TRUE(profile_opt.has_value());
+    const auto & plane = profile_opt.value();
+    // Predicates are only compiled once the DataRefs are resolved
+    ASSERT_EQ(plane->leds().size(), 0);
+    ASSERT_TRUE(plane->resolve());
+    ASSERT_GT(plane->leds().size(), 0);
+
+    led_mask mask;
+    ASSERT_FALSE(plane->leds().evaluate(mask));
+
+    plane->system().volts_data_ref().data().front().data_ref()->value.f = 24.0f;
+    ASSERT_TRUE(plane->leds().evaluate(mask));
+    // Pitot heat is inverted, so the anti-ice LED is on while the heat is off
+    ASSERT_TRUE(mask.get(LED_ANC_ANTI_ICE));
+    ASSERT_FALSE(mask.get(LED_AP));
+    ASSERT_FALSE(mask.get(LED_LDG_N_RED));
+
+    plane->autopilot().value().mode().ap_data_ref().data().front().data_ref()->value.i = 1;
+    mask = led_mask();
+    ASSERT_TRUE(plane->leds().evaluate(mask));
+    ASSERT_TRUE(mask.get(LED_AP));
+}
+
+TEST_F(profile_test, extends) {
+    auto directory = std::filesystem::temp_directory_path() / "hcbravo-profile-extends";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory / "base");
+    auto write = [](const std::filesystem::path & path, const char * content) {
+        std::ofstream output(path, std::ios::trunc);
+        output << content;
+    };
+    // Fragments hold no models and are only used as bases
+    write(directory / "base" / "common.yaml", R"(
+autopilot:
+ modes:
+  ap:
+   - key: 'sim/test/servos'
+system:
+ volts:
+  - key: 'sim/test/volts'
+    type: float
+refresh:
+ frames: 2
+    )");
+    write(directory / "a.yaml", "name: A\nmodels:\n - A\nextends: base/common.yaml\n");
+    write(directory / "b.yaml", R"(
+name: B
+models:
+ - B
+extends: base/common.yaml
+system:
+ volts:
+  - key: 'sim/test/other_volts'
+    type: float
+    )");
+    write(directory / "c.yaml", "name: C\nmodels:\n - C\nextends: b.yaml\nrefresh:\n frames: 1\n");
+
+    auto a = profile::from_yaml((directory / "a.yaml").string());
+    auto b = profile::from_yaml((directory / "b.yaml").string());
+    auto c = profile::from_yaml((directory / "c.yaml").string());
+    ASSERT_TRUE(a.has_value());
+    ASSERT_TRUE(b.has_value());
+    ASSERT_TRUE(c.has_value());
+    ASSERT_FALSE(profile::from_yaml((directory / "base" / "common.yaml").string()).has_value());
+
+    // Every profile extending the same file shares a single copy of it
+    const auto & common = a.value()->base();
+    ASSERT_NE(common, nullptr);
+    ASSERT_EQ(common->name(), "common");
+    ASSERT_EQ(b.value()->base().get(), common.get());
+    ASSERT_EQ(c.value()->base()->base().get(), common.get());
+
+    // Sections a profile does not override come from its base
+    ASSERT_TRUE(a.value()->autopilot().has_value());
+    ASSERT_EQ(&a.value()->autopilot().value(), &c.value()->autopilot().value());
+    ASSERT_FALSE(a.value()->annunciator().has_value());
+    ASSERT_EQ(&a.value()->system(), &common->system());
+    ASSERT_EQ(&c.value()->system(), &c.value()->base()->system());
+    ASSERT_EQ(a.value()->refresh().interval(), -2.0f);
+    ASSERT_EQ(c.value()->refresh().interval(), -1.0f);
+    ASSERT_EQ(c.value()->knobs().window(), 0.25f);
+
+    // Bases are resolved once, and later profiles compile against them
+    ASSERT_TRUE(a.value()->resolve());
+    ASSERT_GT(a.value()->leds().size(), 0);
+    ASSERT_EQ(c.value()->leds().size(), 0);
+    ASSERT_TRUE(c.value()->resolve());
+    ASSERT_EQ(c.value()->leds().size(), a.value()->leds().size());
+    ASSERT_EQ(c.value()->system().volts_data_ref().data().front().data_ref()->name, "sim/test/other_volts");
+
+    led_mask mask;
+    a.value()->system().volts_data_ref().data().front().data_ref()->value.f = 24.0f;
+    common->autopilot().value().mode().ap_data_ref().data().front().data_ref()->value.i = 1;
+    ASSERT_TRUE(a.value()->leds().evaluate(mask));
+    ASSERT_TRUE(mask.get(LED_AP));
+
+    // Editing a base makes every profile extending it stale
+    ASSERT_TRUE(c.value()->is_current());
+    auto path = directory / "base" / "common.yaml";
+    std::filesystem::last_write_time(path, std::filesystem::last_write_time(path) + std::chrono::seconds(1));
+    ASSERT_FALSE(a.value()->is_current());
+    ASSERT_FALSE(c.value()->is_current());
+    auto reloaded = profile::from_yaml((directory / "a.yaml").string());
+    ASSERT_TRUE(reloaded.has_value());
+    ASSERT_TRUE(reloaded.value()->is_current());
+    ASSERT_NE(reloaded.value()->base().get(), common.get());
+
+    // Profiles cannot extend themselves, and must end up with a system
+    write(directory / "loop.yaml", "name: Loop\nmodels:\n - L\nextends: loop.yaml\n");
+    ASSERT_FALSE(profile::from_yaml((directory / "loop.yaml").string()).has_value());
+    write(directory / "empty.yaml", "name: Empty\nmodels:\n - E\nextends: loop.yaml\n");
+    ASSERT_FALSE(profile::from_yaml((directory / "empty.yaml").string()).has_value());
+    write(directory / "d.yaml", "name: D\nmodels:\n - D\nextends: base/missing.yaml\n");
+    ASSERT_FALSE(profile::from_yaml((directory / "d.yaml").string()).has_value());
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(profile_test, predicate_table_array_reads) {
+    auto volts = XPLMFindDataRef("sim/test/bus_volts");
+    volts->value.i = 1;
+    auto fires = XPLMFindDataRef("sim/test/engine_fires");
+    fires->ints = { 0, 0, 0, 0 };
+
+    predicate_table table;
+    table.add(predicate_table::power_group, volts, std::nullopt, false);
+    const led_id leds[] = { LED_ANC_ENG_FIRE, LED_ANC_OIL, LED_ANC_FUEL, LED_ANC_STARTER };
+    for(size_t n = 0; n < 4; ++n) {
+        auto group = table.add_group();
+        table.add(group, fires, n, false);
+        table.add_output(group, leds[n]);
+    }
+    // The power gate plus a single ranged read covering all four engines
+    ASSERT_EQ(table.reads(), 2);
+
+    led_mask mask;
+    ASSERT_TRUE(table.evaluate(mask));
+    ASSERT_EQ(fires->reads, 1);
+    for(const auto & led : leds) ASSERT_FALSE(mask.get(led));
+
+    fires->ints[2] = 1;
+    mask = led_mask();
+    ASSERT_TRUE(table.evaluate(mask));
+    ASSERT_EQ(fires->reads, 2);
+    ASSERT_FALSE(mask.get(LED_ANC_ENG_FIRE));
+    ASSERT_FALSE(mask.get(LED_ANC_OIL));
+    ASSERT_TRUE(mask.get(LED_ANC_FUEL));
+    ASSERT_FALSE(mask.get(LED_ANC_STARTER));
+}
+
+TEST_F(profile_test, predicate_table_shared_reads) {
+    auto volts = XPLMFindDataRef("sim/test/bus_volts");
+    volts->value.i = 1;
+    auto gear = XPLMFindDataRef("sim/test/gear_handle");
+
+    predicate_table table;
+    table.add(predicate_table::power_group, volts, std::nullopt, false);
+    auto down = table.add_group();
+    table.add(down, gear, std::nullopt, false);
+    table.add_output(down, LED_LDG_N_GREEN);
+    auto up = table.add_group();
+    table.add(up, gear, std::nullopt, true);
+    table.add_output(up, LED_LDG_N_RED);
+    ASSERT_EQ(table.reads(), 2);
+
+    led_mask mask;
+    ASSERT_TRUE(table.evaluate(mask));
+    ASSERT_EQ(volts->reads, 1);
+    ASSERT_EQ(gear->reads, 1);
+    ASSERT_FALSE(mask.get(LED_LDG_N_GREEN));
+    ASSERT_TRUE(mask.get(LED_LDG_N_RED));
+}
+
+TEST_F(profile_test, refresh) {
+    auto node = YAML::Load(R"(
+refresh:
+  frames: 2
+  max: 0.25
+  unpowered: 2.0
+    )");
+    auto refresh_opt = refresh_config::build(node["refresh"]);
+    ASSERT_TRUE(refresh_opt.has_value());
+    const auto & refresh = refresh_opt.value();
+    ASSERT_EQ(refresh.interval(), -2.0f);
+    ASSERT_EQ(refresh.max(), 0.25f);
+    ASSERT_EQ(refresh.unpowered(), 2.0f);
+
+    // Intervals are given either in frames or in seconds
+    node = YAML::Load(R"(
+refresh:
+  frames: 2
+  seconds: 0.1
+    )");
+    ASSERT_FALSE(refresh_config::build(node["refresh"]).has_value());
+
+    // Malformed values are rejected rather than thrown
+    for(auto text : { "{frames: x}", "{seconds: fast}", "{max: [1]}", "{unpowered: never}" }) {
+        ASSERT_FALSE(refresh_config::build(YAML::Load(text)).has_value());
+    }
+}
+
+TEST_F(profile_test, refresh_scheduler) {
+    auto node = YAML::Load(R"(
+refresh:
+  frames: 1
+  max: 0.1
+  unpowered: 1.0
+    )");
+    scheduler sched;
+    sched.reset(refresh_config::build(node["refresh"]).value());
+    ASSERT_EQ(sched.interval(), -1.0f);
+
+    // Stable LEDs back off exponentially up to the maximum
+    ASSERT_FLOAT_EQ(sched.next(false, 0.02f), 0.04f);
+    ASSERT_FLOAT_EQ(sched.next(false, 0.04f), 0.08f);
+    ASSERT_FLOAT_EQ(sched.next(false, 0.08f), 0.1f);
+    ASSERT_FLOAT_EQ(sched.next(false, 0.1f), 0.1f);
+
+    // Any change snaps back to every frame
+    ASSERT_EQ(sched.next(true, 0.1f), -1.0f);
+    ASSERT_FLOAT_EQ(sched.next(false, 0.02f), 0.04f);
+    ASSERT_EQ(sched.wake(), -1.0f);
+
+    ASSERT_EQ(sched.unpowered(), 1.0f);
+}
+
+TEST_F(profile_test, knobs) {
+    auto node = YAML::Load(R"(
+knobs:
+  window: 0.5
+  alt:
+    - rate: 15
+      step: 1000
+    - rate: 0
+      step: 100
+    - rate: 6
+      step: 500
+    )");
+    auto knobs_opt = knob_config::build(node["knobs"]);
+    ASSERT_TRUE(knobs_opt.has_value());
+    const auto & knobs = knobs_opt.value();
+    ASSERT_EQ(knobs.window(), 0.5f);
+    ASSERT_FALSE(knobs.curve(1).has_value());
+    ASSERT_TRUE(knobs.curve(0).has_value());
+
+    // Stages are sorted by rate, and the fastest one reached applies
+    const auto & alt = knobs.curve(0).value();
+    ASSERT_EQ(alt.stages().size(), 3);
+    ASSERT_EQ(alt.step(0.0f), 100.0f);
+    ASSERT_EQ(alt.step(5.9f), 100.0f);
+    ASSERT_EQ(alt.step(6.0f), 500.0f);
+    ASSERT_EQ(alt.step(40.0f), 1000.0f);
+
+    // Rates below the first stage still move the dial by its step
+    node = YAML::Load(R"(
+knobs:
+  alt:
+    - rate: 5
+      step: 500
+    - rate: 15
+      step: 1000
+    )");
+    knobs_opt = knob_config::build(node["knobs"]);
+    ASSERT_TRUE(knobs_opt.has_value());
+    ASSERT_EQ(knobs_opt.value().curve(0).value().step(0.0f), 500.0f);
+    ASSERT_EQ(knobs_opt.value().curve(0).value().step(4.9f), 500.0f);
+    ASSERT_EQ(knobs_opt.value().curve(0).value().step(15.0f), 1000.0f);
+
+    // Malformed values are rejected rather than thrown
+    for(auto text : { "{window: slow}", "{alt: [{rate: 0, step: fast}]}", "{hdg: [{rate: [1], step: 5}]}" }) {
+        ASSERT_FALSE(knob_config::build(YAML::Load(text)).has_value());
+    }
+
+    node = YAML::Load(R"(
+knobs:
+  hdg:
+    - rate: 0
+      step: 0
+    )");
+    ASSERT_FALSE(knob_config::build(node["knobs"]).has_value());
+}
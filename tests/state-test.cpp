@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// tests/state-test.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+
+#define HCBRAVO_STATE_TESTS
+
+#include <gtest/gtest.h>
+
+#include <state.h>
+
+#include <XPLM/XPLMDataAccess.h>
+#include <XPLM/XPLMPlugin.h>
+#include <XPLM/XPLMProcessing.h>
+
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+// Runs the plugin against the simulated X-Plane with the C172 profile active
+class state_test : public ::testing::Test {
+protected:
+    std::filesystem::path root_;
+    std::filesystem::path profile_;
+    state::ptr_type plugin_;
+
+    void
+    SetUp() override {
+        root_ = std::filesystem::temp_directory_path() /
+            ("hcbravo-state-" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()) +
+             "-" + ::testing::UnitTest::GetInstance()->current_test_info()->name());
+        std::filesystem::remove_all(root_);
+        std::filesystem::create_directories(root_ / "hcbravo" / "lin_x64");
+        std::filesystem::create_directories(root_ / "hcbravo" / "conf");
+        profile_ = root_ / "hcbravo" / "conf" / "c172.yaml";
+        std::filesystem::copy_file(std::filesystem::path(HCBRAVO_CONF_DIR) / "c172.yaml", profile_);
+        xplm_plugin_path() = (root_ / "hcbravo" / "lin_x64" / "hcbravo.xpl").string();
+
+        auto ret = state::init();
+        ASSERT_TRUE(ret.has_value());
+        plugin_ = std::move(ret.value());
+        for(auto data_ref : xplm_find_all("sim/aircraft/view/acf_ICAO")) data_ref->bytes = "C172";
+        ASSERT_TRUE(wait_plane());
+    }
+
+    void
+    TearDown() override {
+        plugin_.reset();
+        std::filesystem::remove_all(root_);
+    }
+
+    // Profiles load in the background, and are taken over by the next frames
+    bool
+    wait_plane() {
+        for(int n = 0; n < 1000 and plugin_->active_plane().has_value() == false; ++n) {
+            xplm_sim::instance().run_frame(1.0 / 60.0);
+            std::this_thread::sleep_for(1ms);
+        }
+        return plugin_->active_plane().has_value();
+    }
+};
+
+TEST_F(state_test, reload) {
+    const auto & active = plugin_->active_plane().value();
+
+    // A changed file gets a new entry, which the loader parses for the aircraft
+    std::filesystem::last_write_time(profile_, std::filesystem::last_write_time(profile_) + 1s);
+    plugin_->reload();
+    const catalog * loaded = nullptr;
+    for(int n = 0; n < 10000 and loaded == nullptr; ++n) {
+        std::this_thread::sleep_for(1ms);
+        loaded = plugin_->loaded();
+    }
+    ASSERT_NE(loaded, nullptr);
+    auto entry = loaded->find_model("C172");
+    ASSERT_TRUE(entry);
+    ASSERT_TRUE(entry.value()->is_parsed());
+
+    // Binding it on the sim thread swaps in the profile the loader parsed
+    auto profile = entry.value()->load().value();
+    ASSERT_NE(profile.get(), active.get());
+    xplm_sim::instance().run_frame(1.0 / 60.0);
+    ASSERT_TRUE(plugin_->active_plane().has_value());
+    ASSERT_EQ(plugin_->active_plane().value().get(), profile.get());
+}
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// tests/trace-test.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+
+#include <gtest/gtest.h>
+
+#include <trace.h>
+
+#include <yaml.h>
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(trace_test, scope) {
+    {
+        trace_scope outer("outer");
+        trace_scope inner("inner");
+    }
+    auto events = trace::snapshot();
+    ASSERT_GE(events.size(), 4);
+    auto it = events.end() - 4;
+    ASSERT_STREQ(it[0].name_, "outer");
+    ASSERT_EQ(it[0].phase_, 'B');
+    ASSERT_STREQ(it[1].name_, "inner");
+    ASSERT_EQ(it[1].phase_, 'B');
+    ASSERT_STREQ(it[2].name_, "inner");
+    ASSERT_EQ(it[2].phase_, 'E');
+    ASSERT_STREQ(it[3].name_, "outer");
+    ASSERT_EQ(it[3].phase_, 'E');
+    ASSERT_LE(it[0].time_, it[3].time_);
+    for(int n = 1; n < 4; ++n) ASSERT_EQ(it[n].thread_, it[0].thread_);
+}
+
+TEST(trace_test, wrap) {
+    for(size_t n = 0; n < trace::capacity + 10; ++n) trace::record(n % 2 == 0 ? "even" : "odd", n % 2 == 0 ? 'B' : 'E');
+    trace_scope last("last");
+
+    // Only the latest events are kept
+    auto events = trace::snapshot();
+    ASSERT_EQ(events.size(), trace::capacity);
+    ASSERT_STREQ(events.back().name_, "last");
+    for(size_t n = 1; n < events.size(); ++n) ASSERT_LE(events[n - 1].time_, events[n].time_);
+}
+
+TEST(trace_test, dump) {
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t) {
+        threads.emplace_back([t]() {
+            trace::name_thread(t == 0 ? "worker" : "other");
+            for(size_t n = 0; n < trace::capacity / 4; ++n) trace_scope scope("work");
+        });
+    }
+    for(auto & thread : threads) thread.join();
+
+    auto path = std::filesystem::temp_directory_path() / "hcbravo-trace-test.json";
+    ASSERT_TRUE(trace::dump(path));
+    auto node = YAML::LoadFile(path.string());
+    std::filesystem::remove(path);
+
+    // The ring wrapped, so events whose begin was overwritten are left out
+    std::map<int, int> open;
+    bool named = false;
+    auto events = node["traceEvents"];
+    ASSERT_TRUE(events.IsSequence());
+    ASSERT_GT(events.size(), trace::capacity / 2);
+    for(const auto & event : events) {
+        auto phase = event["ph"].as<std::string>();
+        auto thread = event["tid"].as<int>();
+        if(phase == "M") {
+            named = named or event["args"]["name"].as<std::string>() == "worker";
+            continue;
+        }
+        ASSERT_GE(event["ts"].as<double>(), 0.0);
+        if(phase == "B") ++open[thread];
+        else {
+            ASSERT_EQ(phase, "E");
+            ASSERT_GT(open[thread], 0);
+            --open[thread];
+        }
+    }
+    ASSERT_TRUE(named);
+}
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+//
+// tests/watcher-test.cpp
+// XPlane Plugin for HoneyComb Bravo Throttle Controller
+//
+// Copyright (C) 2005 Isaac Gelado
+
+
+#include <gtest/gtest.h>
+
+#include <watcher.h>
+
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <thread>
+
+class watcher_test : public ::testing::Test {
+protected:
+    std::filesystem::path directory_;
+
+    void
+    SetUp() override {
+        directory_ = std::filesystem::temp_directory_path() /
+            (std::string("hcbravo-watcher-") + ::testing::UnitTest::GetInstance()->current_test_info()->name());
+        std::filesystem::remove_all(directory_);
+        std::filesystem::create_directories(directory_);
+        write(directory_ / "c172.yaml", "name: Cessna\n");
+    }
+
+    void
+    TearDown() override {
+        std::filesystem::remove_all(directory_);
+    }
+
+    void
+    write(const std::filesystem::path & path, const std::string & content) {
+        std::ofstream output(path, std::ios::trunc);
+        output << content;
+    }
+
+    // Collects changes until the expected files show up or we give up
+    std::set<std::string>
+    wait(watcher & w, size_t count) {
+        std::set<std::string> ret;
+        for(int n = 0; n < 100 and ret.size() < count; ++n) {
+            auto changes = w.changes();
+            ret.insert(changes.begin(), changes.end());
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return ret;
+    }
+};
+
+TEST_F(watcher_test, changes) {
+    watcher w(directory_, std::chrono::milliseconds(20));
+    ASSERT_TRUE(w.start());
+    ASSERT_TRUE(w.changes().empty());
+
+    // Modification times may have a coarse resolution, so the polling
+    // fallback relies on the size changing as well
+    write(directory_ / "c172.yaml", "name: Cessna 172\n");
+    write(directory_ / "b738.yaml", "name: Boeing\n");
+    write(directory_ / "notes.txt", "Not a profile\n");
+    ASSERT_EQ(wait(w, 2), (std::set<std::string>{ "b738.yaml", "c172.yaml" }));
+
+    std::filesystem::remove(directory_ / "b738.yaml");
+    ASSERT_EQ(wait(w, 1), std::set<std::string>{ "b738.yaml" });
+
+    w.stop();
+    write(directory_ / "a.yaml", "name: Airbus\n");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(w.changes().empty());
+}
+
+TEST_F(watcher_test, missing) {
+    watcher w(directory_ / "missing");
+    ASSERT_FALSE(w.start());
+}